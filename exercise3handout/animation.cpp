@@ -0,0 +1,118 @@
+#include "animation.h"
+#include "node.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+
+namespace {
+
+	// fraction of the way from key k to key k + 1, 0 on a track's last key
+	float key_blend(const std::vector<float>& times, size_t k, float time) {
+		if (k + 1 >= times.size()) {
+			return 0.f;
+		}
+		float span = times[k + 1] - times[k];
+		if (span <= 0.f) {
+			return 0.f;
+		}
+		float t = (time - times[k]) / span;
+		return t < 0.f ? 0.f : (t > 1.f ? 1.f : t);
+	}
+
+	vec3 sample_track(const std::vector<float>& times, const std::vector<vec3>& keys, float time, size_t& cursor) {
+		size_t k = AnimationSampler::find_key(times, time, cursor);
+		float t = key_blend(times, k, time);
+		if (t == 0.f) {
+			return keys[k];
+		}
+		return keys[k] + (keys[k + 1] - keys[k]) * t;
+	}
+
+	versor sample_track(const std::vector<float>& times, const std::vector<versor>& keys, float time, size_t& cursor) {
+		size_t k = AnimationSampler::find_key(times, time, cursor);
+		float t = key_blend(times, k, time);
+		if (t == 0.f) {
+			return keys[k];
+		}
+		// slerp flips its first argument for the short way round, work on copies
+		versor from = keys[k];
+		versor to = keys[k + 1];
+		return slerp(from, to, t);
+	}
+}
+
+AnimationSampler::AnimationSampler() : clip(nullptr), time(0.f), speed(1.f), loop(true) {
+}
+
+void AnimationSampler::play(const AnimationClip* new_clip, float start) {
+	clip = new_clip;
+	time = start;
+	cursors.assign(clip ? clip->channels.size() * 3 : 0, 0);
+}
+
+void AnimationSampler::advance(float seconds, std::vector<Node>& nodes) {
+	if (!clip) {
+		return;
+	}
+	time += seconds * speed;
+	float duration = clip->duration;
+	if (duration <= 0.f) {
+		time = 0.f;
+	}
+	else if (loop) {
+		time = fmodf(time, duration);
+		if (time < 0.f) {
+			time += duration;
+		}
+	}
+	else {
+		time = time < 0.f ? 0.f : (time > duration ? duration : time);
+	}
+	sample(time, nodes);
+}
+
+void AnimationSampler::sample(float sample_time, std::vector<Node>& nodes) {
+	if (!clip) {
+		return;
+	}
+	assert(cursors.size() == clip->channels.size() * 3);
+	for (size_t c = 0; c < clip->channels.size(); ++c) {
+		const AnimationClip::Channel& channel = clip->channels[c];
+		assert(channel.node >= 0 && (size_t)channel.node < nodes.size());
+		Node& node = nodes[channel.node];
+		size_t* cursor = &cursors[c * 3];
+		if (!channel.positions.empty()) {
+			node.setPosition(sample_track(channel.position_times, channel.positions, sample_time, cursor[0]));
+		}
+		if (!channel.rotations.empty()) {
+			node.setRotation(sample_track(channel.rotation_times, channel.rotations, sample_time, cursor[1]));
+		}
+		if (!channel.scales.empty()) {
+			node.setScale(sample_track(channel.scale_times, channel.scales, sample_time, cursor[2]));
+		}
+	}
+}
+
+size_t AnimationSampler::find_key(const std::vector<float>& times, float time, size_t& cursor) {
+	size_t count = times.size();
+	if (count < 2 || time <= times[0]) {
+		cursor = 0;
+		return cursor;
+	}
+	if (time >= times[count - 1]) {
+		cursor = count - 1;
+		return cursor;
+	}
+	// same key as last time, or the next one
+	if (cursor + 1 < count && times[cursor] <= time) {
+		if (time < times[cursor + 1]) {
+			return cursor;
+		}
+		if (cursor + 2 < count && time < times[cursor + 2]) {
+			return ++cursor;
+		}
+	}
+	cursor = (size_t)(std::upper_bound(times.begin(), times.end(), time) - times.begin()) - 1;
+	return cursor;
+}
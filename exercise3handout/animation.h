@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "maths_funcs.h"
+
+struct Node;
+
+// Keyframes of one imported animation. Every channel drives the position,
+// rotation and scale of one node, each track with its own key times.
+// Times are in seconds, converted from the file's ticks at import.
+struct AnimationClip {
+
+	struct Channel {
+		int node; // index into Meshgroup::nodes
+		std::vector<float> position_times;
+		std::vector<vec3> positions;
+		std::vector<float> rotation_times;
+		std::vector<versor> rotations;
+		std::vector<float> scale_times;
+		std::vector<vec3> scales;
+	};
+
+	std::string name;
+	float duration;
+	std::vector<Channel> channels;
+};
+
+// Plays one clip into the TRS of the nodes it animates, nodes without a
+// channel and tracks without keys are left alone. Every track remembers the
+// key it used last: played forward the next sample is nearly always on that
+// key or the one after, and only a jump falls back to a binary search.
+struct AnimationSampler {
+
+	const AnimationClip* clip;
+	float time;  // seconds into the clip
+	float speed;
+	bool loop;   // otherwise the last pose holds
+
+	AnimationSampler();
+
+	// nullptr stops playback
+	void play(const AnimationClip* clip, float start = 0.f);
+	// moves time by seconds * speed and samples there
+	void advance(float seconds, std::vector<Node>& nodes);
+	void sample(float time, std::vector<Node>& nodes);
+
+	// key k with times[k] <= time < times[k + 1], clamped to the first and
+	// last key. cursor is the first guess and receives the key found
+	static size_t find_key(const std::vector<float>& times, float time, size_t& cursor);
+
+private:
+	// last key of every track, position, rotation and scale per channel
+	std::vector<size_t> cursors;
+};
@@ -0,0 +1,187 @@
+// Picks among N spheres with DynamicBVH::raycast() and with the linear scan
+// Exercise3::onMouseClicked used to do, checks both pick the same sphere, and
+// times building, refitting and the frustum and overlap queries.
+//
+//   bvh_bench [objects] [rays]
+
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "bounds.h"
+#include "bvh.h"
+
+namespace {
+
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double ms_since(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	struct Sphere {
+		vec3 center;
+		float radius;
+	};
+
+	AABB box_of(const Sphere& sphere) {
+		AABB box;
+		box.min = vec3(sphere.center.x - sphere.radius, sphere.center.y - sphere.radius, sphere.center.z - sphere.radius);
+		box.max = vec3(sphere.center.x + sphere.radius, sphere.center.y + sphere.radius, sphere.center.z + sphere.radius);
+		return box;
+	}
+
+	// distance to the first hit in front of the origin, negative for a miss.
+	// direction is unit length
+	float ray_sphere(const vec3& origin, const vec3& direction, const Sphere& sphere) {
+		float ox = origin.x - sphere.center.x;
+		float oy = origin.y - sphere.center.y;
+		float oz = origin.z - sphere.center.z;
+		float b = ox * direction.x + oy * direction.y + oz * direction.z;
+		float c = ox * ox + oy * oy + oz * oz - sphere.radius * sphere.radius;
+		float discriminant = b * b - c;
+		if (discriminant < 0.f) {
+			return -1.f;
+		}
+		float root = sqrtf(discriminant);
+		float t = -b - root;
+		if (t < 0.f) {
+			t = -b + root; // origin inside
+		}
+		return t;
+	}
+
+	int linear_pick(const std::vector<Sphere>& spheres, const vec3& origin, const vec3& direction, float* distance) {
+		int closest = -1;
+		float best = 1e30f;
+		for (size_t i = 0; i < spheres.size(); ++i) {
+			float t = ray_sphere(origin, direction, spheres[i]);
+			if (t >= 0.f && t < best) {
+				best = t;
+				closest = (int)i;
+			}
+		}
+		*distance = best;
+		return closest;
+	}
+}
+
+int main(int argc, char** argv) {
+	size_t count = argc > 1 ? (size_t)atoi(argv[1]) : 100000;
+	int rays = argc > 2 ? atoi(argv[2]) : 1000;
+	const float world = 500.f;
+
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> position(-world, world);
+	std::uniform_real_distribution<float> size(0.5f, 2.f);
+	std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+	std::vector<Sphere> spheres(count);
+	for (size_t i = 0; i < count; ++i) {
+		spheres[i].center = vec3(position(rng), position(rng), position(rng));
+		spheres[i].radius = size(rng);
+	}
+
+	// build
+	DynamicBVH bvh(0.2f);
+	std::vector<int> proxies(count);
+	Clock::time_point start = Clock::now();
+	for (size_t i = 0; i < count; ++i) {
+		proxies[i] = bvh.insert(box_of(spheres[i]), (uint32_t)i);
+	}
+	double build_ms = ms_since(start);
+	printf("%zu objects  build %8.2f ms  height %d  %s\n", count, build_ms, bvh.height(), bvh.validate() ? "valid" : "INVALID");
+
+	// picking, rays from around the edge of the world into it
+	std::vector<vec3> origins(rays);
+	std::vector<vec3> directions(rays);
+	for (int r = 0; r < rays; ++r) {
+		origins[r] = vec3(unit(rng) * world, unit(rng) * world, world * 1.5f);
+		directions[r] = normalise(vec3(unit(rng) * 0.3f, unit(rng) * 0.3f, -1.f));
+	}
+
+	int mismatches = 0;
+	int hits = 0;
+	std::vector<int> linear_result(rays);
+	start = Clock::now();
+	for (int r = 0; r < rays; ++r) {
+		float distance;
+		linear_result[r] = linear_pick(spheres, origins[r], directions[r], &distance);
+	}
+	double linear_us = ms_since(start) * 1000.0 / rays;
+
+	start = Clock::now();
+	for (int r = 0; r < rays; ++r) {
+		const vec3& origin = origins[r];
+		const vec3& direction = directions[r];
+		uint32_t user = 0;
+		float distance = 0.f;
+		bool hit = bvh.raycast(origin, direction, 1e30f,
+			[&](uint32_t i) { return ray_sphere(origin, direction, spheres[i]); }, &user, &distance);
+		int picked = hit ? (int)user : -1;
+		hits += hit ? 1 : 0;
+		mismatches += picked != linear_result[r] ? 1 : 0;
+	}
+	double bvh_us = ms_since(start) * 1000.0 / rays;
+	printf("pick      linear %9.2f us  bvh %7.2f us  x%.0f  %d/%d hit%s\n", linear_us, bvh_us, linear_us / bvh_us,
+		hits, rays, mismatches ? "  MISMATCH" : "");
+
+	// refit: everything drifts a little every frame, some objects jump
+	const int frames = 20;
+	size_t reinserted = 0;
+	start = Clock::now();
+	for (int frame = 0; frame < frames; ++frame) {
+		for (size_t i = 0; i < count; ++i) {
+			Sphere& sphere = spheres[i];
+			if (i % 100 == (size_t)frame) {
+				sphere.center = vec3(position(rng), position(rng), position(rng));
+			}
+			else {
+				sphere.center.x += 0.01f;
+			}
+			reinserted += bvh.update(proxies[i], box_of(sphere)) ? 1 : 0;
+		}
+	}
+	double refit_ms = ms_since(start) / frames;
+	printf("refit     %8.2f ms/frame  %zu reinserted per frame  %s\n", refit_ms, reinserted / frames,
+		bvh.validate() ? "valid" : "INVALID");
+
+	// frustum, a camera at the edge looking in
+	mat4 view = look_at(vec3(0.f, 0.f, world * 1.5f), vec3(0.f, 0.f, 0.f), vec3(0.f, 1.f, 0.f));
+	Frustum frustum = Frustum::from_matrix(perspective(67.f, 1.33f, 0.1f, world * 2.f) * view);
+
+	CullBatch batch;
+	std::vector<uint8_t> visible(count);
+	std::vector<uint32_t> users;
+	start = Clock::now();
+	batch.clear();
+	for (size_t i = 0; i < count; ++i) {
+		BoundingSphere bounds = { spheres[i].center, spheres[i].radius };
+		batch.add(box_of(spheres[i]), bounds);
+	}
+	CullStats stats = cull(frustum, batch, visible.data());
+	double cull_ms = ms_since(start);
+
+	start = Clock::now();
+	bvh.query(frustum, users);
+	double query_ms = ms_since(start);
+	printf("frustum   linear cull %6.2f ms (%zu visible)  bvh %6.2f ms (%zu fat boxes)\n", cull_ms, stats.visible,
+		query_ms, users.size());
+
+	// overlap, small boxes around random points
+	const int boxes = 10000;
+	size_t found = 0;
+	start = Clock::now();
+	for (int q = 0; q < boxes; ++q) {
+		Sphere probe = { vec3(position(rng), position(rng), position(rng)), 5.f };
+		users.clear();
+		bvh.query(box_of(probe), users);
+		found += users.size();
+	}
+	printf("overlap   %6.2f us per query  %.2f found on average\n", ms_since(start) * 1000.0 / boxes, (double)found / boxes);
+
+	return mismatches == 0 ? 0 : 1;
+}
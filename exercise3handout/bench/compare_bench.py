@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+# Compares two maths_bench --json runs case by case: the medians (or the
+# minimums), the change and whether it is past the threshold. Exits 1 when
+# a case got slower by more than the threshold, so it can gate a commit.
+#
+#   maths_bench --json before.json        (on the old commit, or maths_bench_scalar)
+#   maths_bench --json after.json
+#   python3 compare_bench.py before.json after.json [--threshold 10] [--stat min]
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        run = json.load(f)
+    return run.get("context", {}), {b["name"]: b for b in run["benchmarks"]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="compare two maths_bench --json runs")
+    parser.add_argument("before")
+    parser.add_argument("after")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="percent a case may grow before it counts as a regression")
+    parser.add_argument("--stat", choices=("median", "min"), default="median",
+                        help="min is steadier on a busy machine")
+    args = parser.parse_args()
+
+    before_context, before = load(args.before)
+    after_context, after = load(args.after)
+    for key in sorted(set(before_context) | set(after_context)):
+        a = before_context.get(key)
+        b = after_context.get(key)
+        if a != b:
+            print("note: %s differs, %s -> %s" % (key, a, b))
+
+    print("%-24s %12s %12s %9s" % ("case", "before ns", "after ns", "change"))
+    regressions = 0
+    for name in before:
+        if name not in after:
+            print("%-24s %12.2f %12s" % (name, before[name][args.stat], "missing"))
+            continue
+        old = before[name][args.stat]
+        new = after[name][args.stat]
+        change = (new - old) / old * 100.0 if old > 0 else 0.0
+        mark = ""
+        if change > args.threshold:
+            mark = "  slower"
+            regressions += 1
+        elif change < -args.threshold:
+            mark = "  faster x%.2f" % (old / new)
+        print("%-24s %12.2f %12.2f %+8.1f%%%s" % (name, old, new, change, mark))
+    for name in after:
+        if name not in before:
+            print("%-24s %12s %12.2f" % (name, "new", after[name][args.stat]))
+
+    if regressions:
+        print("%d case(s) slower by more than %g%%" % (regressions, args.threshold))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,101 @@
+// Times TransformHierarchy::update() on synthetic hierarchies, serial and on
+// a work-stealing pool of 1..N threads, and checks every threaded run gives
+// the same world matrices as the serial one.
+//
+//   hierarchy_bench [frames] [max threads]
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "node.h"
+#include "thread_pool.h"
+#include "transform_hierarchy.h"
+
+namespace {
+
+	struct Scene {
+		TransformHierarchy hierarchy;
+		std::vector<Node> nodes;
+	};
+
+	// fanout^1 + ... + fanout^depth nodes below a single root
+	void build(Scene& scene, int fanout, int depth) {
+		size_t count = 1;
+		size_t level = 1;
+		for (int d = 0; d < depth; ++d) {
+			level *= fanout;
+			count += level;
+		}
+		scene.nodes.resize(count);
+		for (size_t i = 0; i < count; ++i) {
+			scene.nodes[i].init(scene.hierarchy);
+		}
+		// breadth first: the children of i are fanout*i+1 .. fanout*i+fanout
+		for (size_t i = 1; i < count; ++i) {
+			scene.nodes[(i - 1) / fanout].addChild(scene.nodes[i]);
+			scene.nodes[i].setPosition(vec3(1.f, 0.f, 0.f));
+		}
+	}
+
+	void animate(Scene& scene, int frame) {
+		for (size_t i = 0; i < scene.nodes.size(); ++i) {
+			float angle = static_cast<float>(frame + i % 360);
+			scene.nodes[i].setRotation(quat_from_axis_deg(angle, 0.f, 1.f, 0.f));
+		}
+	}
+
+	// average milliseconds per update() over frames
+	double run(Scene& scene, ThreadPool* pool, int frames) {
+		double total = 0.0;
+		for (int frame = 0; frame < frames; ++frame) {
+			animate(scene, frame);
+			auto start = std::chrono::high_resolution_clock::now();
+			scene.hierarchy.update(pool);
+			auto end = std::chrono::high_resolution_clock::now();
+			total += std::chrono::duration<double, std::milli>(end - start).count();
+		}
+		return total / frames;
+	}
+
+	bool bench(const char* name, int fanout, int depth, int frames, unsigned maxThreads) {
+		Scene serial;
+		build(serial, fanout, depth);
+		double serialMs = run(serial, nullptr, frames);
+		printf("%-6s %8zu nodes %3zu levels  serial     %8.3f ms\n", name, serial.nodes.size(),
+			serial.hierarchy.levelStarts.size() - 1, serialMs);
+
+		bool identical = true;
+		for (unsigned threads = 1; threads <= maxThreads; ++threads) {
+			Scene scene;
+			build(scene, fanout, depth);
+			ThreadPool pool(threads);
+			double ms = run(scene, &pool, frames);
+
+			const std::vector<mat4>& a = serial.hierarchy.worldMatrices;
+			const std::vector<mat4>& b = scene.hierarchy.worldMatrices;
+			bool same = memcmp(&a[0], &b[0], a.size() * sizeof(mat4)) == 0;
+			identical = identical && same;
+
+			printf("%-6s %8zu nodes %3zu levels  %2u threads %8.3f ms  x%.2f%s\n", name, scene.nodes.size(),
+				scene.hierarchy.levelStarts.size() - 1, threads, ms, serialMs / ms, same ? "" : "  MISMATCH");
+		}
+		return identical;
+	}
+}
+
+int main(int argc, char** argv) {
+	int frames = argc > 1 ? atoi(argv[1]) : 50;
+	unsigned maxThreads = argc > 2 ? static_cast<unsigned>(atoi(argv[2])) : std::thread::hardware_concurrency();
+	if (maxThreads == 0) {
+		maxThreads = 1;
+	}
+
+	bool ok = true;
+	ok = bench("wide", 256, 2, frames, maxThreads) && ok;
+	ok = bench("deep", 2, 16, frames, maxThreads) && ok;
+	return ok ? 0 : 1;
+}
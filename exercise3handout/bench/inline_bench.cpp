@@ -0,0 +1,100 @@
+// Times the two maths-heavy paths of a frame: Node::updateHierarchy() over
+// a synthetic scene, and the vertex generation of Shapes::addArrow(). Build
+// it once against the current maths_funcs.h and once against an older one
+// to see what inlining the vector and matrix operators is worth.
+//
+// The arrows go through arrow_vertices() of shape_geometry.cpp, the part of
+// addArrow() that does not need a GL context.
+//
+//   inline_bench [frames]
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "node.h"
+#include "shape_geometry.h"
+#include "transform_hierarchy.h"
+
+namespace {
+
+	// the machine is shared, a median is steadier than a mean
+	double median(std::vector<double>& samples) {
+		std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+		return samples[samples.size() / 2];
+	}
+
+	// median milliseconds per frame, and a sum of the results so nothing is optimised out
+	double bench_arrows(int frames, int arrows, double* checksum) {
+		std::vector<vec3> vertices(arrows * ArrowVertexCount);
+		std::vector<double> samples(frames);
+		*checksum = 0.0;
+		for (int frame = 0; frame < frames; ++frame) {
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int a = 0; a < arrows; ++a) {
+				float t = static_cast<float>(a + frame);
+				vec3 from(t * 0.01f, 0.f, -t * 0.02f);
+				vec3 to = from + vec3(1.f, 2.f + (a % 7), 0.5f);
+				arrow_vertices(from, to, &vertices[a * ArrowVertexCount]);
+			}
+			auto end = std::chrono::high_resolution_clock::now();
+			samples[frame] = std::chrono::duration<double, std::milli>(end - start).count();
+			*checksum += vertices[(frame * 31) % vertices.size()].y;
+		}
+		return median(samples);
+	}
+
+	double bench_hierarchy(int frames, int fanout, int depth, double* checksum) {
+		TransformHierarchy hierarchy;
+		size_t count = 1;
+		size_t level = 1;
+		for (int d = 0; d < depth; ++d) {
+			level *= fanout;
+			count += level;
+		}
+		std::vector<Node> nodes(count);
+		for (size_t i = 0; i < count; ++i) {
+			nodes[i].init(hierarchy);
+		}
+		for (size_t i = 1; i < count; ++i) {
+			nodes[(i - 1) / fanout].addChild(nodes[i]);
+			nodes[i].setPosition(vec3(1.f, 0.f, 0.f));
+			nodes[i].setScale(vec3(1.f, 1.01f, 1.f));
+		}
+
+		std::vector<double> samples(frames);
+		*checksum = 0.0;
+		for (int frame = 0; frame < frames; ++frame) {
+			for (size_t i = 0; i < count; ++i) {
+				float angle = static_cast<float>(frame + i % 360);
+				nodes[i].setRotation(quat_from_axis_deg(angle, 0.f, 1.f, 0.f));
+			}
+			auto start = std::chrono::high_resolution_clock::now();
+			nodes[0].updateHierarchy();
+			auto end = std::chrono::high_resolution_clock::now();
+			samples[frame] = std::chrono::duration<double, std::milli>(end - start).count();
+			*checksum += hierarchy.worldMatrices[count - 1].m[12];
+		}
+		return median(samples);
+	}
+}
+
+int main(int argc, char** argv) {
+	int frames = argc > 1 ? atoi(argv[1]) : 200;
+	if (frames <= 0) {
+		fprintf(stderr, "usage: inline_bench [frames]\n");
+		return 1;
+	}
+
+	double checksum = 0.0;
+	double ms = bench_arrows(frames, 4096, &checksum);
+	printf("addArrow         %6d arrows            %8.3f ms  (checksum %g)\n", 4096, ms, checksum);
+
+	ms = bench_hierarchy(frames, 4, 7, &checksum);
+	printf("updateHierarchy  %6d nodes  fanout 4   %8.3f ms  (checksum %g)\n", 21845, ms, checksum);
+	ms = bench_hierarchy(frames, 2, 14, &checksum);
+	printf("updateHierarchy  %6d nodes  fanout 2   %8.3f ms  (checksum %g)\n", 32767, ms, checksum);
+	return 0;
+}
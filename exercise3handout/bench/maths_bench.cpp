@@ -0,0 +1,336 @@
+// Micro-benchmarks for maths_funcs: every case runs one function over
+// arrays of inputs and reports nanoseconds per call. With --json the results
+// are also written in a form compare_bench.py reads, so two builds (two
+// commits, SIMD on and off) can be compared case by case:
+//
+//   maths_bench [--json file] [--filter text] [--size n] [--repetitions n] [--min-time ms]
+//   python3 compare_bench.py before.json after.json
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "maths_funcs.h"
+
+namespace {
+
+	typedef std::chrono::high_resolution_clock Clock;
+
+	// inputs and outputs of every case, filled once
+	struct Data {
+		std::vector<mat4> matrices_a, matrices_b, affine, out_matrices;
+		std::vector<versor> quats_a, quats_b, out_quats;
+		std::vector<vec3> vectors_a, vectors_b, out_vectors, out_scales;
+		std::vector<float> factors, out_floats;
+	};
+
+	versor random_quat(std::mt19937& rng) {
+		std::uniform_real_distribution<float> axis(-1.f, 1.f);
+		std::uniform_real_distribution<float> angle(-180.f, 180.f);
+		vec3 a = normalise(vec3(axis(rng), axis(rng), axis(rng) + 2.f));
+		return quat_from_axis_deg(angle(rng), a.x, a.y, a.z);
+	}
+
+	void fill(Data& data, size_t n) {
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<float> any(-10.f, 10.f);
+		std::uniform_real_distribution<float> positive(0.5f, 2.f);
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+		data.matrices_a.resize(n);
+		data.matrices_b.resize(n);
+		data.affine.resize(n);
+		data.out_matrices.resize(n);
+		data.quats_a.resize(n);
+		data.quats_b.resize(n);
+		data.out_quats.resize(n);
+		data.vectors_a.resize(n);
+		data.vectors_b.resize(n);
+		data.out_vectors.resize(n);
+		data.out_scales.resize(n);
+		data.factors.resize(n);
+		data.out_floats.resize(n);
+		for (size_t i = 0; i < n; ++i) {
+			for (int k = 0; k < 16; ++k) {
+				data.matrices_a[i].m[k] = any(rng);
+				data.matrices_b[i].m[k] = any(rng);
+			}
+			// T*R*S, what decompose() and inverse_affine() are meant for
+			mat4 rotation = quat_to_mat4(random_quat(rng));
+			data.affine[i] = scaler(rotation, vec3(positive(rng), positive(rng), positive(rng)));
+			data.affine[i].setColumn(3, vec4(any(rng), any(rng), any(rng), 1.f));
+			data.quats_a[i] = random_quat(rng);
+			data.quats_b[i] = random_quat(rng);
+			data.vectors_a[i] = vec3(any(rng), any(rng), any(rng));
+			data.vectors_b[i] = vec3(any(rng), any(rng), any(rng));
+			data.factors[i] = unit(rng);
+		}
+	}
+
+	/*-------------------------------CASES----------------------------------------*/
+	// each one goes once over the n inputs and writes n outputs
+
+	void mat4_mul(Data& d, size_t n) {
+		for (size_t i = 0; i < n; ++i) {
+			d.out_matrices[i] = d.matrices_a[i] * d.matrices_b[i];
+		}
+	}
+
+	void mat4_mul_array(Data& d, size_t n) {
+		mul_mat4_array(&d.matrices_a[0], &d.matrices_b[0], &d.out_matrices[0], n);
+	}
+
+	void mat4_mul_vec4(Data& d, size_t n) {
+		for (size_t i = 0; i < n; ++i) {
+			d.out_vectors[i] = vec3(d.matrices_a[i] * vec4(d.vectors_a[i], 1.f));
+		}
+	}
+
+	void mat4_transform_points(Data& d, size_t n) {
+		transform_points(d.affine[0], &d.vectors_a[0], &d.out_vectors[0], n);
+	}
+
+	void mat4_inverse(Data& d, size_t n) {
+		for (size_t i = 0; i < n; ++i) {
+			d.out_matrices[i] = inverse(d.matrices_a[i]);
+		}
+	}
+
+	void mat4_inverse_affine(Data& d, size_t n) {
+		for (size_t i = 0; i < n; ++i) {
+			d.out_matrices[i] = inverse_affine(d.affine[i]);
+		}
+	}
+
+	void mat4_determinant(Data& d, size_t n) {
+		for (size_t i = 0; i < n; ++i) {
+			d.out_floats[i] = determinant(d.matrices_a[i]);
+		}
+	}
+
+	void mat4_transpose(Data& d, size_t n) {
+		for (size_t i = 0; i < n; ++i) {
+			d.out_matrices[i] = transpose(d.matrices_a[i]);
+		}
+	}
+
+	void mat4_decompose(Data& d, size_t n) {
+		for (size_t i = 0; i < n; ++i) {
+			d.affine[i].decompose(d.out_quats[i], d.out_vectors[i], d.out_scales[i]);
+		}
+	}
+
+	void quat_to_matrix(Data& d, size_t n) {
+		for (size_t i = 0; i < n; ++i) {
+			d.out_matrices[i] = quat_to_mat4(d.quats_a[i]);
+		}
+	}
+
+	void quat_slerp(Data& d, size_t n) {
+		for (size_t i = 0; i < n; ++i) {
+			d.out_quats[i] = slerp(d.quats_a[i], d.quats_b[i], d.factors[i]);
+		}
+	}
+
+	void vec3_normalise(Data& d, size_t n) {
+		for (size_t i = 0; i < n; ++i) {
+			d.out_vectors[i] = normalise(d.vectors_a[i]);
+		}
+	}
+
+	void vec3_cross(Data& d, size_t n) {
+		for (size_t i = 0; i < n; ++i) {
+			d.out_vectors[i] = cross(d.vectors_a[i], d.vectors_b[i]);
+		}
+	}
+
+	void vec3_dot(Data& d, size_t n) {
+		for (size_t i = 0; i < n; ++i) {
+			d.out_floats[i] = dot(d.vectors_a[i], d.vectors_b[i]);
+		}
+	}
+
+	struct Case {
+		const char* name;
+		void (*run)(Data&, size_t);
+	};
+
+	const Case Cases[] = {
+		{ "mat4_mul", mat4_mul },
+		{ "mat4_mul_array", mat4_mul_array },
+		{ "mat4_mul_vec4", mat4_mul_vec4 },
+		{ "mat4_transform_points", mat4_transform_points },
+		{ "mat4_inverse", mat4_inverse },
+		{ "mat4_inverse_affine", mat4_inverse_affine },
+		{ "mat4_determinant", mat4_determinant },
+		{ "mat4_transpose", mat4_transpose },
+		{ "mat4_decompose", mat4_decompose },
+		{ "quat_to_mat4", quat_to_matrix },
+		{ "quat_slerp", quat_slerp },
+		{ "vec3_normalise", vec3_normalise },
+		{ "vec3_cross", vec3_cross },
+		{ "vec3_dot", vec3_dot },
+	};
+
+	/*-------------------------------HARNESS--------------------------------------*/
+	struct Options {
+		const char* json = nullptr;
+		const char* filter = nullptr;
+		size_t size = 4096;
+		int repetitions = 5;
+		double min_time_ms = 20.0;
+	};
+
+	struct Result {
+		const char* name;
+		size_t calls; // per repetition
+		std::vector<double> ns; // per call, one for each repetition
+	};
+
+	// read back a few outputs so none of the loops can be dropped
+	volatile float sink;
+
+	void consume(const Data& d, size_t n) {
+		size_t i = n / 2;
+		sink = d.out_matrices[i].m[5] + d.out_quats[i].q[1] + d.out_vectors[i].y + d.out_scales[i].x +
+			d.out_floats[i];
+	}
+
+	Result measure(const Case& c, Data& data, const Options& options) {
+		// enough passes over the arrays for one repetition to last min_time
+		c.run(data, options.size);
+		size_t passes = 1;
+		for (;;) {
+			Clock::time_point start = Clock::now();
+			for (size_t p = 0; p < passes; ++p) {
+				c.run(data, options.size);
+			}
+			double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			if (ms >= options.min_time_ms || passes >= (size_t(1) << 30)) {
+				break;
+			}
+			passes = ms > 0.0 ? std::max(passes * 2, size_t(passes * options.min_time_ms * 1.2 / ms)) : passes * 16;
+		}
+
+		Result result;
+		result.name = c.name;
+		result.calls = passes * options.size;
+		for (int r = 0; r < options.repetitions; ++r) {
+			Clock::time_point start = Clock::now();
+			for (size_t p = 0; p < passes; ++p) {
+				c.run(data, options.size);
+			}
+			double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+			result.ns.push_back(ns / result.calls);
+			consume(data, options.size);
+		}
+		return result;
+	}
+
+	double median(std::vector<double> values) {
+		std::sort(values.begin(), values.end());
+		size_t half = values.size() / 2;
+		return values.size() % 2 ? values[half] : 0.5 * (values[half - 1] + values[half]);
+	}
+
+	const char* simd_backend() {
+#if defined( MATHS_SIMD_SSE )
+		return "sse";
+#elif defined( MATHS_SIMD_NEON )
+		return "neon";
+#else
+		return "scalar";
+#endif
+	}
+
+	bool write_json(const char* path, const Options& options, const std::vector<Result>& results) {
+		FILE* file = fopen(path, "w");
+		if (!file) {
+			fprintf(stderr, "maths_bench: could not write %s\n", path);
+			return false;
+		}
+		fprintf(file, "{\n");
+		fprintf(file, "  \"context\": {\n");
+		fprintf(file, "    \"simd\": \"%s\",\n", simd_backend());
+#ifdef NDEBUG
+		fprintf(file, "    \"build\": \"release\",\n");
+#else
+		fprintf(file, "    \"build\": \"debug\",\n");
+#endif
+		fprintf(file, "    \"size\": %zu,\n", options.size);
+		fprintf(file, "    \"repetitions\": %d\n", options.repetitions);
+		fprintf(file, "  },\n");
+		fprintf(file, "  \"benchmarks\": [\n");
+		for (size_t i = 0; i < results.size(); ++i) {
+			const Result& r = results[i];
+			fprintf(file, "    {\"name\": \"%s\", \"calls\": %zu, \"time_unit\": \"ns\", \"median\": %.4f, \"min\": %.4f, "
+				"\"samples\": [", r.name, r.calls, median(r.ns), *std::min_element(r.ns.begin(), r.ns.end()));
+			for (size_t k = 0; k < r.ns.size(); ++k) {
+				fprintf(file, "%s%.4f", k ? ", " : "", r.ns[k]);
+			}
+			fprintf(file, "]}%s\n", i + 1 < results.size() ? "," : "");
+		}
+		fprintf(file, "  ]\n}\n");
+		fclose(file);
+		return true;
+	}
+
+	bool parse(int argc, char** argv, Options& options) {
+		for (int i = 1; i < argc; ++i) {
+			bool has_value = i + 1 < argc;
+			if (!strcmp(argv[i], "--json") && has_value) {
+				options.json = argv[++i];
+			}
+			else if (!strcmp(argv[i], "--filter") && has_value) {
+				options.filter = argv[++i];
+			}
+			else if (!strcmp(argv[i], "--size") && has_value) {
+				options.size = strtoul(argv[++i], nullptr, 10);
+			}
+			else if (!strcmp(argv[i], "--repetitions") && has_value) {
+				options.repetitions = atoi(argv[++i]);
+			}
+			else if (!strcmp(argv[i], "--min-time") && has_value) {
+				options.min_time_ms = atof(argv[++i]);
+			}
+			else {
+				return false;
+			}
+		}
+		return options.size > 0 && options.repetitions > 0 && options.min_time_ms > 0.0;
+	}
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	if (!parse(argc, argv, options)) {
+		fprintf(stderr, "usage: maths_bench [--json file] [--filter text] [--size n] [--repetitions n] "
+			"[--min-time ms]\n");
+		return 1;
+	}
+
+	Data data;
+	fill(data, options.size);
+	printf("maths_bench  simd %s  %zu elements  %d repetitions\n", simd_backend(), options.size, options.repetitions);
+	printf("%-24s %10s %10s\n", "case", "median ns", "min ns");
+
+	std::vector<Result> results;
+	for (const Case& c : Cases) {
+		if (options.filter && !strstr(c.name, options.filter)) {
+			continue;
+		}
+		results.push_back(measure(c, data, options));
+		const Result& r = results.back();
+		printf("%-24s %10.2f %10.2f\n", r.name, median(r.ns), *std::min_element(r.ns.begin(), r.ns.end()));
+	}
+
+	if (options.json && !write_json(options.json, options, results)) {
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,268 @@
+// Checks the mat4 kernels of maths_funcs against the scalar loops they
+// replaced, copied below as they were: mat4 * mat4, mat4 * vec4,
+// mul_mat4_array and transform_points, on random inputs, identities, inputs
+// aliased with the output and every transform_points length up to a few
+// wide steps. Built twice, with the SIMD backend and with MATHS_NO_SIMD.
+// Exits with 1 on any mismatch.
+//
+// The products have to match bit for bit, with one exception: the old
+// mat4 * mat4 started every sum from +0, so a result of -0 came out as +0.
+// A zero of either sign is accepted against a zero of the other.
+//
+//   maths_check [random cases]
+
+#include <random>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "maths_funcs.h"
+
+namespace {
+
+	int failures = 0;
+	size_t compared = 0;
+	uint32_t worst_ulps = 0;
+
+	uint32_t bits_of(float f) {
+		uint32_t u;
+		memcpy(&u, &f, sizeof(u));
+		return u;
+	}
+
+	// distance in representable floats, for the report when something is off
+	uint32_t ulps(float a, float b) {
+		int64_t ia = (int32_t)bits_of(a);
+		int64_t ib = (int32_t)bits_of(b);
+		ia = ia < 0 ? INT32_MIN - ia : ia;
+		ib = ib < 0 ? INT32_MIN - ib : ib;
+		int64_t d = ia > ib ? ia - ib : ib - ia;
+		return d > UINT32_MAX ? UINT32_MAX : (uint32_t)d;
+	}
+
+	bool same(float expected, float got) {
+		return bits_of(expected) == bits_of(got) || (expected == 0.f && got == 0.f);
+	}
+
+	void check(const float* expected, const float* got, int count, const char* what) {
+		for (int i = 0; i < count; ++i) {
+			++compared;
+			if (same(expected[i], got[i])) {
+				continue;
+			}
+			uint32_t d = ulps(expected[i], got[i]);
+			worst_ulps = d > worst_ulps ? d : worst_ulps;
+			if (failures < 20) {
+				printf("FAILED: %s [%d] expected %.9g (0x%08x) got %.9g (0x%08x), %u ulps\n", what, i, expected[i],
+					bits_of(expected[i]), got[i], bits_of(got[i]), d);
+			}
+			++failures;
+		}
+	}
+
+	/*------------------------------REFERENCE-------------------------------*/
+	// mat4::operator*( const mat4 & ) before the SIMD kernels
+	mat4 reference_mul( const mat4 &a, const mat4 &rhs ) {
+		mat4 r = zero_mat4();
+		int r_index = 0;
+		for ( int col = 0; col < 4; col++ ) {
+			for ( int row = 0; row < 4; row++ ) {
+				float sum = 0.0f;
+				for ( int i = 0; i < 4; i++ ) {
+					sum += rhs.m[i + col * 4] * a.m[row + i * 4];
+				}
+				r.m[r_index] = sum;
+				r_index++;
+			}
+		}
+		return r;
+	}
+
+	// mat4::operator*( const vec4 & ) before the SIMD kernels
+	vec4 reference_mul( const mat4 &a, const vec4 &rhs ) {
+		const float *m = a.m;
+		float x = m[0] * rhs.v[0] + m[4] * rhs.v[1] + m[8] * rhs.v[2] + m[12] * rhs.v[3];
+		float y = m[1] * rhs.v[0] + m[5] * rhs.v[1] + m[9] * rhs.v[2] + m[13] * rhs.v[3];
+		float z = m[2] * rhs.v[0] + m[6] * rhs.v[1] + m[10] * rhs.v[2] + m[14] * rhs.v[3];
+		float w = m[3] * rhs.v[0] + m[7] * rhs.v[1] + m[11] * rhs.v[2] + m[15] * rhs.v[3];
+		return vec4( x, y, z, w );
+	}
+
+	/*-------------------------------INPUTS---------------------------------*/
+	// mixed magnitudes and signs, plus exact zeros of both signs, so the
+	// rounding of every partial sum gets exercised
+	float random_value(std::mt19937& rng) {
+		std::uniform_int_distribution<int> kind(0, 15);
+		std::uniform_real_distribution<float> unit(-1.f, 1.f);
+		std::uniform_int_distribution<int> exponent(-20, 20);
+		switch (kind(rng)) {
+		case 0: return 0.f;
+		case 1: return -0.f;
+		case 2: return 1.f;
+		case 3: return -1.f;
+		default: return ldexpf(unit(rng), exponent(rng));
+		}
+	}
+
+	mat4 random_mat4(std::mt19937& rng) {
+		mat4 m;
+		for (int i = 0; i < 16; ++i) {
+			m.m[i] = random_value(rng);
+		}
+		return m;
+	}
+
+	mat4 random_affine(std::mt19937& rng) {
+		mat4 m = random_mat4(rng);
+		m.m[3] = 0.f;
+		m.m[7] = 0.f;
+		m.m[11] = 0.f;
+		m.m[15] = 1.f;
+		return m;
+	}
+
+	vec4 random_vec4(std::mt19937& rng) {
+		return vec4(random_value(rng), random_value(rng), random_value(rng), random_value(rng));
+	}
+
+	vec3 random_vec3(std::mt19937& rng) {
+		return vec3(random_value(rng), random_value(rng), random_value(rng));
+	}
+
+	/*--------------------------------CASES---------------------------------*/
+	void check_products(const mat4& a, const mat4& b, const vec4& v) {
+		mat4 expected = reference_mul(a, b);
+		mat4 got = a * b;
+		check(expected.m, got.m, 16, "mat4 * mat4");
+
+		vec4 expected_v = reference_mul(a, v);
+		vec4 got_v = a * v;
+		check(expected_v.v, got_v.v, 4, "mat4 * vec4");
+
+		// the kernel may write over either input
+		mat4 in_a = a;
+		mul_mat4_kernel(in_a.m, b.m, in_a.m);
+		check(expected.m, in_a.m, 16, "mul_mat4_kernel out == a");
+		mat4 in_b = b;
+		mul_mat4_kernel(a.m, in_b.m, in_b.m);
+		check(expected.m, in_b.m, 16, "mul_mat4_kernel out == b");
+		mat4 squared = a;
+		mul_mat4_kernel(squared.m, squared.m, squared.m);
+		mat4 expected_squared = reference_mul(a, a);
+		check(expected_squared.m, squared.m, 16, "mul_mat4_kernel out == a == b");
+	}
+
+	void check_identity(const mat4& a, const vec4& v) {
+		mat4 identity = identity_mat4();
+		mat4 left = identity * a;
+		mat4 right = a * identity;
+		check(reference_mul(identity, a).m, left.m, 16, "identity * a");
+		check(reference_mul(a, identity).m, right.m, 16, "a * identity");
+		check(a.m, left.m, 16, "identity * a == a");
+		check(a.m, right.m, 16, "a * identity == a");
+		vec4 same_v = identity * v;
+		check(v.v, same_v.v, 4, "identity * v == v");
+	}
+
+	void check_array(std::mt19937& rng, size_t n) {
+		std::vector<mat4> a(n);
+		std::vector<mat4> b(n);
+		for (size_t i = 0; i < n; ++i) {
+			a[i] = random_mat4(rng);
+			b[i] = random_mat4(rng);
+		}
+		std::vector<mat4> expected(n);
+		for (size_t i = 0; i < n; ++i) {
+			expected[i] = reference_mul(a[i], b[i]);
+		}
+
+		std::vector<mat4> out(n + 1);
+		mat4 guard = random_mat4(rng);
+		out[n] = guard;
+		mul_mat4_array(a.data(), b.data(), out.data(), n);
+		for (size_t i = 0; i < n; ++i) {
+			check(expected[i].m, out[i].m, 16, "mul_mat4_array");
+		}
+		check(guard.m, out[n].m, 16, "mul_mat4_array past the end");
+
+		std::vector<mat4> in_a = a;
+		mul_mat4_array(in_a.data(), b.data(), in_a.data(), n);
+		std::vector<mat4> in_b = b;
+		mul_mat4_array(a.data(), in_b.data(), in_b.data(), n);
+		for (size_t i = 0; i < n; ++i) {
+			check(expected[i].m, in_a[i].m, 16, "mul_mat4_array out == a");
+			check(expected[i].m, in_b[i].m, 16, "mul_mat4_array out == b");
+		}
+	}
+
+	void check_points(std::mt19937& rng, const mat4& m, size_t n) {
+		std::vector<vec3> in(n);
+		for (size_t i = 0; i < n; ++i) {
+			in[i] = random_vec3(rng);
+		}
+		std::vector<vec3> expected(n);
+		for (size_t i = 0; i < n; ++i) {
+			vec4 p = reference_mul(m, vec4(in[i], 1.0f));
+			expected[i] = vec3(p.v[0], p.v[1], p.v[2]);
+		}
+
+		// a guard after the last point catches a kernel storing 4 floats into a vec3
+		std::vector<vec3> out(n + 1);
+		vec3 guard = random_vec3(rng);
+		out[n] = guard;
+		transform_points(m, in.data(), out.data(), n);
+		for (size_t i = 0; i < n; ++i) {
+			check(expected[i].v, out[i].v, 3, "transform_points");
+		}
+		check(guard.v, out[n].v, 3, "transform_points past the end");
+
+		std::vector<vec3> in_place(in);
+		in_place.push_back(guard);
+		transform_points(m, in_place.data(), in_place.data(), n);
+		for (size_t i = 0; i < n; ++i) {
+			check(expected[i].v, in_place[i].v, 3, "transform_points out == in");
+		}
+		check(guard.v, in_place[n].v, 3, "transform_points in place, past the end");
+	}
+}
+
+int main(int argc, char** argv) {
+	size_t cases = argc > 1 ? (size_t)atol(argv[1]) : 200000;
+
+#if defined( MATHS_SIMD_SSE )
+	const char* backend = "sse";
+#elif defined( MATHS_SIMD_NEON )
+	const char* backend = "neon";
+#else
+	const char* backend = "scalar";
+#endif
+
+	std::mt19937 rng(7);
+	for (size_t c = 0; c < cases; ++c) {
+		mat4 a = random_mat4(rng);
+		mat4 b = random_mat4(rng);
+		vec4 v = random_vec4(rng);
+		check_products(a, b, v);
+		if (c % 64 == 0) {
+			check_identity(a, v);
+		}
+	}
+
+	// every length through a few wide steps, so any tail handling is covered
+	for (size_t n = 0; n <= 33; ++n) {
+		check_array(rng, n);
+		check_points(rng, random_affine(rng), n);
+		check_points(rng, random_mat4(rng), n);
+	}
+	check_array(rng, 1000);
+	check_points(rng, random_affine(rng), 1001);
+
+	printf("%s backend: %zu floats compared, %d mismatches", backend, compared, failures);
+	if (failures) {
+		printf(", worst %u ulps", worst_ulps);
+	}
+	printf("\n");
+	return failures ? 1 : 0;
+}
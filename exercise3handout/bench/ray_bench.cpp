@@ -0,0 +1,206 @@
+// Checks the packet ray-sphere kernels against ray_sphere() one pair at a
+// time, on hand made edge cases (tangent, origin inside, sphere behind) and
+// on random scenes, then times one ray against many spheres and many rays
+// against one sphere both ways. Exits with 1 on any mismatch.
+//
+//   ray_bench [spheres] [rays]
+
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "ray_spheres.h"
+
+namespace {
+
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double ms_since(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	int failures = 0;
+
+	void check(bool ok, const char* what) {
+		if (!ok) {
+			printf("FAILED: %s\n", what);
+			++failures;
+		}
+	}
+
+	bool same(float a, float b) {
+		return fabsf(a - b) <= 1e-5f * fmaxf(1.f, fabsf(a));
+	}
+
+	// the reference: ray_sphere() on every sphere in order
+	int scalar_nearest(const vec3& origin, const vec3& direction, const SphereBatch& spheres, float max_distance,
+		float* distance) {
+		int best = -1;
+		float best_t = max_distance;
+		for (size_t i = 0; i < spheres.size(); ++i) {
+			vec3 center(spheres.center_x[i], spheres.center_y[i], spheres.center_z[i]);
+			float t = ray_sphere(origin, direction, center, spheres.radius[i]);
+			if (t >= 0.f && t < best_t) {
+				best_t = t;
+				best = (int)i;
+			}
+		}
+		if (best >= 0) {
+			*distance = best_t;
+		}
+		return best;
+	}
+
+	// far away spheres no ray below reaches, so the case under test lands in
+	// the given slot: inside an eight wide step or in the scalar tail
+	void pad(SphereBatch& spheres, size_t count) {
+		while (spheres.size() < count) {
+			spheres.add(vec3(1000.f, 1000.f, 1000.f + spheres.size()), 0.5f);
+		}
+	}
+
+	void edge_cases() {
+		const vec3 forward(0.f, 0.f, 1.f);
+		const size_t slots[] = { 0, 5, 8, 13 }; // first step, second half, second step, tail of 14
+		for (size_t s = 0; s < sizeof(slots) / sizeof(slots[0]); ++s) {
+			size_t slot = slots[s];
+			float distance = -2.f;
+
+			// tangent: grazes the unit sphere at (0, 1, 0), 5 along
+			SphereBatch spheres;
+			pad(spheres, slot);
+			spheres.add(vec3(0.f, 0.f, 0.f), 1.f);
+			pad(spheres, 14);
+			vec3 grazing(0.f, 1.f, -5.f);
+			float reference = ray_sphere(grazing, forward, vec3(0.f, 0.f, 0.f), 1.f);
+			check(reference == 5.f, "scalar tangent hit at 5");
+			check(ray_spheres(grazing, forward, spheres, 1e30f, &distance) == (int)slot && distance == reference,
+				"packet tangent hit");
+			check(ray_spheres(vec3(0.f, 1.0001f, -5.f), forward, spheres, 1e30f, &distance) == -1, "packet near miss");
+
+			// origin inside: distance 0
+			check(ray_spheres(vec3(0.f, 0.f, 0.5f), forward, spheres, 1e30f, &distance) == (int)slot && distance == 0.f,
+				"packet origin inside");
+			// sphere behind the origin
+			check(ray_spheres(vec3(0.f, 0.f, 3.f), forward, spheres, 1e30f, &distance) == -1, "packet sphere behind");
+			// beyond max_distance
+			check(ray_spheres(vec3(0.f, 0.f, -5.f), forward, spheres, 3.f, &distance) == -1, "packet max distance");
+
+			// the same cases as rays against one sphere
+			RayBatch rays;
+			for (size_t r = 0; r < 14; ++r) {
+				rays.add(vec3(0.f, 0.f, 3.f + r), forward); // all behind
+			}
+			std::vector<float> distances(rays.size());
+			check(rays_sphere(rays, vec3(0.f, 0.f, 0.f), 1.f, distances.data(), &distance) == -1, "rays all behind");
+			rays.origin_y[slot] = 1.f;
+			rays.origin_z[slot] = -5.f;
+			check(rays_sphere(rays, vec3(0.f, 0.f, 0.f), 1.f, distances.data(), &distance) == (int)slot
+				&& distance == 5.f, "rays tangent");
+			rays.origin_y[slot] = 0.f;
+			rays.origin_z[slot] = 0.25f;
+			check(rays_sphere(rays, vec3(0.f, 0.f, 0.f), 1.f, nullptr, &distance) == (int)slot && distance == 0.f,
+				"rays origin inside");
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	size_t count = argc > 1 ? (size_t)atoi(argv[1]) : 100000;
+	int ray_count = argc > 2 ? atoi(argv[2]) : 1000;
+	const float world = 500.f;
+
+	edge_cases();
+
+	std::mt19937 rng(11);
+	std::uniform_real_distribution<float> position(-world, world);
+	std::uniform_real_distribution<float> size(0.5f, 4.f);
+	std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+	SphereBatch spheres;
+	for (size_t i = 0; i < count; ++i) {
+		spheres.add(vec3(position(rng), position(rng), position(rng)), size(rng));
+	}
+	std::vector<vec3> origins(ray_count);
+	std::vector<vec3> directions(ray_count);
+	for (int r = 0; r < ray_count; ++r) {
+		// some rays start among the spheres, so insides and behinds happen too
+		origins[r] = r % 2 ? vec3(position(rng), position(rng), position(rng))
+			: vec3(unit(rng) * world, unit(rng) * world, world * 1.5f);
+		directions[r] = normalise(vec3(unit(rng) * 0.3f, unit(rng) * 0.3f, -1.f));
+	}
+
+	// one ray, many spheres
+	int mismatches = 0;
+	int hits = 0;
+	std::vector<int> reference(ray_count);
+	std::vector<float> reference_t(ray_count);
+	Clock::time_point start = Clock::now();
+	for (int r = 0; r < ray_count; ++r) {
+		reference[r] = scalar_nearest(origins[r], directions[r], spheres, 1e30f, &reference_t[r]);
+	}
+	double scalar_us = ms_since(start) * 1000.0 / ray_count;
+	start = Clock::now();
+	for (int r = 0; r < ray_count; ++r) {
+		float distance = 0.f;
+		int hit = ray_spheres(origins[r], directions[r], spheres, 1e30f, &distance);
+		hits += hit >= 0 ? 1 : 0;
+		mismatches += hit != reference[r] || (hit >= 0 && !same(distance, reference_t[r])) ? 1 : 0;
+	}
+	double packet_us = ms_since(start) * 1000.0 / ray_count;
+	printf("1 ray x %zu spheres   scalar %8.2f us  packet %8.2f us  x%.1f  %d/%d hit%s\n", count, scalar_us, packet_us,
+		scalar_us / packet_us, hits, ray_count, mismatches ? "  MISMATCH" : "");
+	check(mismatches == 0, "one ray against many spheres matches the scalar loop");
+
+	// many rays, one sphere
+	RayBatch rays;
+	std::uniform_real_distribution<float> near(-3.f, 3.f);
+	for (size_t i = 0; i < count; ++i) {
+		rays.add(vec3(near(rng), near(rng), near(rng)), normalise(vec3(unit(rng), unit(rng), unit(rng))));
+	}
+	const vec3 center(0.5f, -0.25f, 0.f);
+	const float radius = 1.5f;
+	const int repeats = 20;
+	std::vector<float> expected(count);
+	std::vector<float> distances(count);
+	int nearest_expected = -1;
+	start = Clock::now();
+	for (int repeat = 0; repeat < repeats; ++repeat) {
+		float best = 1e30f;
+		nearest_expected = -1;
+		for (size_t i = 0; i < count; ++i) {
+			vec3 origin(rays.origin_x[i], rays.origin_y[i], rays.origin_z[i]);
+			vec3 direction(rays.direction_x[i], rays.direction_y[i], rays.direction_z[i]);
+			expected[i] = ray_sphere(origin, direction, center, radius);
+			if (expected[i] >= 0.f && expected[i] < best) {
+				best = expected[i];
+				nearest_expected = (int)i;
+			}
+		}
+	}
+	scalar_us = ms_since(start) * 1000.0 / repeats;
+	int nearest = -1;
+	float distance = 0.f;
+	start = Clock::now();
+	for (int repeat = 0; repeat < repeats; ++repeat) {
+		nearest = rays_sphere(rays, center, radius, distances.data(), &distance);
+	}
+	packet_us = ms_since(start) * 1000.0 / repeats;
+	mismatches = nearest != nearest_expected ? 1 : 0;
+	size_t inside = 0;
+	size_t missed = 0;
+	for (size_t i = 0; i < count; ++i) {
+		mismatches += (expected[i] < 0.f) != (distances[i] < 0.f) || (expected[i] >= 0.f && !same(distances[i], expected[i]))
+			? 1 : 0;
+		inside += distances[i] == 0.f ? 1 : 0;
+		missed += distances[i] < 0.f ? 1 : 0;
+	}
+	printf("%zu rays x 1 sphere   scalar %8.2f us  packet %8.2f us  x%.1f  %zu inside, %zu missed%s\n", count, scalar_us,
+		packet_us, scalar_us / packet_us, inside, missed, mismatches ? "  MISMATCH" : "");
+	check(mismatches == 0, "many rays against one sphere match the scalar loop");
+
+	return failures == 0 ? 0 : 1;
+}
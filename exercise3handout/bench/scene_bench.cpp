@@ -0,0 +1,437 @@
+// Headless driver for the CPU side of a frame. Builds a synthetic Node tree
+// with a sphere mesh on every node, animates part of it and runs the stages
+// Exercise3::update() runs, in the same order, for N frames:
+//
+//   animate    new rotations for the animated nodes
+//   hierarchy  TransformHierarchy::update()
+//   bounds     world boxes into the cull batch, refit of the scene BVH
+//   cull       cull() against the camera frustum
+//   pick       a ray through the BVH, exact test on the mesh's triangle BVH
+//   drawlist   keyed packets for the visible nodes, sorted
+//
+// and prints the percentiles of every stage and the heap allocations it
+// made. Needs no window or GL context, so it runs anywhere the bench
+// targets build.
+//
+// The pick stage goes through raycast_mesh_space, as Meshgroup::Mesh::raycast
+// does, and the drawlist stage keys its packets with RenderQueue's
+// make_render_key. Both live in GL-free units linked in below.
+//
+//   scene_bench [--depth n] [--fanout n] [--count n] [--frames n] [--animated fraction]
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <new>
+#include <random>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unordered_map>
+#include <vector>
+
+#include "bounds.h"
+#include "bvh.h"
+#include "node.h"
+#include "render_key.h"
+#include "transform_hierarchy.h"
+#include "triangle_bvh.h"
+
+/*-------------------------------ALLOCATIONS----------------------------------*/
+// every heap allocation of the program goes through here, the stages read
+// the counters before and after they run
+namespace {
+	size_t allocation_count = 0;
+	size_t allocation_bytes = 0;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	++allocation_count;
+	allocation_bytes += size;
+	return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& nothrow) noexcept {
+	return operator new(size, nothrow);
+}
+
+void* operator new(size_t size) {
+	void* p = operator new(size, std::nothrow);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+	free(p);
+}
+
+void operator delete[](void* p) noexcept {
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+	free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+	free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+	free(p);
+}
+
+namespace {
+
+	typedef std::chrono::high_resolution_clock Clock;
+
+	enum Stage { Animate, Hierarchy, Bounds, Cull, Pick, DrawList, StageCount };
+	const char* StageNames[StageCount] = { "animate", "hierarchy", "bounds", "cull", "pick", "drawlist" };
+
+	struct Options {
+		int depth = 6;
+		int fanout = 4;
+		size_t count = 0; // 0: the full tree
+		int frames = 300;
+		float animated = 0.25f;
+	};
+
+	// a unit UV sphere, what Exercise3 draws on every sphere node
+	struct SphereMesh {
+		std::vector<float> positions;
+		std::vector<uint32_t> indices;
+		AABB local_aabb;
+		BoundingSphere local_sphere;
+		TriangleBVH triangle_bvh;
+
+		void build(int rings, int segments) {
+			for (int r = 0; r <= rings; ++r) {
+				float theta = ONE_DEG_IN_RAD * 180.f * r / rings;
+				for (int s = 0; s <= segments; ++s) {
+					float phi = ONE_DEG_IN_RAD * 360.f * s / segments;
+					positions.push_back(sinf(theta) * cosf(phi));
+					positions.push_back(cosf(theta));
+					positions.push_back(sinf(theta) * sinf(phi));
+				}
+			}
+			for (int r = 0; r < rings; ++r) {
+				for (int s = 0; s < segments; ++s) {
+					uint32_t a = r * (segments + 1) + s;
+					uint32_t b = a + segments + 1;
+					uint32_t quad[6] = { a, b, a + 1, a + 1, b, b + 1 };
+					indices.insert(indices.end(), quad, quad + 6);
+				}
+			}
+			size_t vertex_count = positions.size() / 3;
+			local_aabb = compute_aabb(&positions[0], vertex_count);
+			local_sphere = compute_bounding_sphere(&positions[0], vertex_count, local_aabb);
+			triangle_bvh.build(&positions[0], vertex_count, &indices[0], indices.size());
+		}
+	};
+
+	// RenderQueue's packet, without the GL handles
+	struct Packet {
+		uint64_t key;
+		uint32_t node;
+		mat4 world;
+		vec3 color;
+	};
+
+	struct Scene {
+		TransformHierarchy hierarchy;
+		std::vector<Node> nodes;
+		std::vector<uint8_t> animated;
+		SphereMesh mesh;
+
+		DynamicBVH bvh;
+		std::vector<int> proxies;
+		CullBatch bounds;
+		std::vector<uint8_t> visible;
+
+		std::vector<Packet> packets;
+		std::unordered_map<uint64_t, uint32_t> texture_set_ids;
+		std::unordered_map<uint64_t, uint32_t> vao_ids;
+
+		mat4 view, proj;
+		vec3 camera;
+	};
+
+	uint32_t id_of(std::unordered_map<uint64_t, uint32_t>& ids, uint64_t name) {
+		std::unordered_map<uint64_t, uint32_t>::iterator found = ids.find(name);
+		if (found != ids.end()) {
+			return found->second;
+		}
+		uint32_t id = (uint32_t)ids.size();
+		ids[name] = id;
+		return id;
+	}
+
+	// breadth first, fanout children per node, until depth levels below the
+	// root or count nodes
+	void build(Scene& scene, const Options& options) {
+		size_t count = 1;
+		size_t level = 1;
+		for (int d = 0; d < options.depth; ++d) {
+			level *= options.fanout;
+			count += level;
+		}
+		if (options.count > 0 && options.count < count) {
+			count = options.count;
+		}
+
+		std::mt19937 rng(11);
+		std::uniform_real_distribution<float> offset(-4.f, 4.f);
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+		scene.nodes.resize(count);
+		scene.animated.resize(count);
+		for (size_t i = 0; i < count; ++i) {
+			scene.nodes[i].init(scene.hierarchy);
+		}
+		for (size_t i = 1; i < count; ++i) {
+			scene.nodes[(i - 1) / options.fanout].addChild(scene.nodes[i]);
+			scene.nodes[i].setPosition(vec3(offset(rng), offset(rng) * 0.25f, offset(rng)));
+			scene.nodes[i].setScale(vec3(0.9f, 0.9f, 0.9f));
+			scene.animated[i] = unit(rng) < options.animated;
+		}
+		scene.hierarchy.update();
+
+		scene.mesh.build(12, 16);
+		scene.proxies.resize(count);
+		for (size_t i = 0; i < count; ++i) {
+			AABB box = transform_aabb(scene.mesh.local_aabb, scene.nodes[i].worldMatrix());
+			scene.proxies[i] = scene.bvh.insert(box, (uint32_t)i);
+		}
+		scene.visible.resize(count);
+		scene.proj = perspective(67.f, 16.f / 9.f, 0.1f, 1000.f);
+	}
+
+	// what every stage produced, so the work cannot be optimised away and
+	// the runs can be told apart
+	struct Totals {
+		size_t locals, worlds, reinserted, visible, picks;
+		// picks whose kept triangle hit is not the returned sphere's
+		size_t pick_mismatches;
+	};
+
+	/*---------------------------------STAGES-------------------------------------*/
+	void animate(Scene& scene, int frame) {
+		float angle = frame * 0.5f;
+		for (size_t i = 1; i < scene.nodes.size(); ++i) {
+			if (scene.animated[i]) {
+				scene.nodes[i].setRotation(quat_from_axis_deg(angle + i, 0.f, 1.f, 0.f));
+			}
+		}
+		// the camera stands near the root and turns, as the user looking around
+		float yaw = frame * 0.02f;
+		scene.camera = vec3(0.f, 2.f, 0.f);
+		scene.view = look_at(scene.camera, scene.camera + vec3(cosf(yaw), -0.1f, sinf(yaw)), vec3(0.f, 1.f, 0.f));
+	}
+
+	void update_bounds(Scene& scene, Totals& totals) {
+		scene.bounds.clear();
+		for (size_t i = 0; i < scene.nodes.size(); ++i) {
+			const mat4& world = scene.nodes[i].worldMatrix();
+			AABB box = transform_aabb(scene.mesh.local_aabb, world);
+			scene.bounds.add(box, transform_sphere(scene.mesh.local_sphere, world));
+			if (scene.nodes[i].worldChanged() && scene.bvh.update(scene.proxies[i], box)) {
+				++totals.reinserted;
+			}
+		}
+	}
+
+	void pick(Scene& scene, int frame, Totals& totals) {
+		// at a different node every frame, like a cursor moving over the scene
+		const Node& target = scene.nodes[(frame * 7919) % scene.nodes.size()];
+		vec3 origin = scene.camera;
+		vec3 direction = normalise(vec3(target.worldMatrix().getColumn(3)) - origin);
+
+		// as Exercise3::pickSphere: boxes are entered closest first but a
+		// later box can still hold a closer triangle, only a hit in front of
+		// the best so far replaces it
+		float best = 1e30f;
+		TriangleHit closest_hit;
+		auto exact_test = [&](uint32_t i) {
+			TriangleHit hit;
+			const mat4& world_inverse = scene.nodes[i].worldInverseMatrix();
+			if (!raycast_mesh_space(scene.mesh.triangle_bvh, world_inverse, origin, direction, best, &hit) ||
+				hit.distance >= best) {
+				return -1.f;
+			}
+			best = hit.distance;
+			closest_hit = hit;
+			return hit.distance;
+		};
+		uint32_t picked = 0;
+		float distance = 0.f;
+		if (scene.bvh.raycast(origin, direction, 1e30f, exact_test, &picked, &distance)) {
+			++totals.picks;
+			if (distance != closest_hit.distance) {
+				++totals.pick_mismatches;
+			}
+		}
+	}
+
+	void build_draw_list(Scene& scene) {
+		scene.packets.clear();
+		for (size_t i = 0; i < scene.nodes.size(); ++i) {
+			if (!scene.visible[i]) {
+				continue;
+			}
+			const mat4& world = scene.nodes[i].worldMatrix();
+			// a handful of materials and vertex arrays, so the key has something to sort
+			Packet packet;
+			packet.node = (uint32_t)i;
+			packet.world = world;
+			packet.color = vec3(0.5f, 0.5f, 0.5f);
+			float depth = length(vec3(world.getColumn(3)) - scene.camera);
+			packet.key = make_render_key(0, id_of(scene.texture_set_ids, i % 8), id_of(scene.vao_ids, i % 3), depth);
+			scene.packets.push_back(packet);
+		}
+		std::sort(scene.packets.begin(), scene.packets.end(),
+			[](const Packet& a, const Packet& b) { return a.key < b.key; });
+	}
+
+	/*---------------------------------REPORT-------------------------------------*/
+	struct StageStats {
+		std::vector<double> us;
+		size_t allocations = 0;
+		size_t bytes = 0;
+	};
+
+	double percentile(const std::vector<double>& sorted, double p) {
+		size_t index = (size_t)(p * (sorted.size() - 1) + 0.5);
+		return sorted[index];
+	}
+
+	bool parse(int argc, char** argv, Options& options) {
+		for (int i = 1; i < argc; ++i) {
+			bool has_value = i + 1 < argc;
+			if (!strcmp(argv[i], "--depth") && has_value) {
+				options.depth = atoi(argv[++i]);
+			}
+			else if (!strcmp(argv[i], "--fanout") && has_value) {
+				options.fanout = atoi(argv[++i]);
+			}
+			else if (!strcmp(argv[i], "--count") && has_value) {
+				options.count = strtoul(argv[++i], nullptr, 10);
+			}
+			else if (!strcmp(argv[i], "--frames") && has_value) {
+				options.frames = atoi(argv[++i]);
+			}
+			else if (!strcmp(argv[i], "--animated") && has_value) {
+				options.animated = (float)atof(argv[++i]);
+			}
+			else {
+				return false;
+			}
+		}
+		return options.depth >= 0 && options.fanout > 0 && options.frames > 0 && options.animated >= 0.f &&
+			options.animated <= 1.f;
+	}
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	if (!parse(argc, argv, options)) {
+		fprintf(stderr, "usage: scene_bench [--depth n] [--fanout n] [--count n] [--frames n] [--animated fraction]\n");
+		return 1;
+	}
+
+	Scene scene;
+	build(scene, options);
+	printf("scene_bench  %zu nodes  %zu levels  fanout %d  %.0f%% animated  %d frames\n", scene.nodes.size(),
+		scene.hierarchy.levelStarts.size() - 1, options.fanout, options.animated * 100.f, options.frames);
+
+	StageStats stats[StageCount];
+	Totals totals = {};
+	std::vector<double> frame_us;
+	Clock::time_point stage_start;
+	size_t stage_allocations = 0;
+	size_t stage_bytes = 0;
+	auto begin_stage = [&]() {
+		stage_allocations = allocation_count;
+		stage_bytes = allocation_bytes;
+		stage_start = Clock::now();
+	};
+	auto end_stage = [&](Stage stage, bool record) {
+		double us = std::chrono::duration<double, std::micro>(Clock::now() - stage_start).count();
+		size_t allocations = allocation_count - stage_allocations;
+		size_t bytes = allocation_bytes - stage_bytes;
+		if (record) {
+			stats[stage].us.push_back(us);
+			stats[stage].allocations += allocations;
+			stats[stage].bytes += bytes;
+		}
+	};
+
+	// frame 0 warms the caches and grows the containers, it is not reported
+	for (int frame = 0; frame <= options.frames; ++frame) {
+		bool record = frame > 0;
+		Clock::time_point frame_start = Clock::now();
+
+		begin_stage();
+		animate(scene, frame);
+		end_stage(Animate, record);
+
+		begin_stage();
+		scene.hierarchy.update();
+		end_stage(Hierarchy, record);
+		totals.locals += scene.hierarchy.localUpdateCount;
+		totals.worlds += scene.hierarchy.worldUpdateCount;
+
+		begin_stage();
+		update_bounds(scene, totals);
+		end_stage(Bounds, record);
+
+		begin_stage();
+		CullStats cull_stats = cull(Frustum::from_matrix(scene.proj * scene.view), scene.bounds, scene.visible.data());
+		end_stage(Cull, record);
+		totals.visible += cull_stats.visible;
+
+		begin_stage();
+		pick(scene, frame, totals);
+		end_stage(Pick, record);
+
+		begin_stage();
+		build_draw_list(scene);
+		end_stage(DrawList, record);
+
+		if (record) {
+			frame_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - frame_start).count());
+		}
+	}
+
+	double frames = options.frames;
+	printf("%-10s %9s %9s %9s %9s %12s %12s\n", "stage", "p50 us", "p90 us", "p99 us", "max us", "allocs/frame",
+		"bytes/frame");
+	for (int s = 0; s < StageCount; ++s) {
+		std::vector<double>& us = stats[s].us;
+		std::sort(us.begin(), us.end());
+		printf("%-10s %9.1f %9.1f %9.1f %9.1f %12.1f %12.0f\n", StageNames[s], percentile(us, 0.5),
+			percentile(us, 0.9), percentile(us, 0.99), us.back(), stats[s].allocations / frames,
+			stats[s].bytes / frames);
+	}
+	std::sort(frame_us.begin(), frame_us.end());
+	printf("%-10s %9.1f %9.1f %9.1f %9.1f\n", "frame", percentile(frame_us, 0.5), percentile(frame_us, 0.9),
+		percentile(frame_us, 0.99), frame_us.back());
+	printf("per frame: %.0f locals, %.0f worlds, %.1f reinserted, %.0f visible, %.2f picks hit\n",
+		totals.locals / (frames + 1), totals.worlds / (frames + 1), totals.reinserted / (frames + 1),
+		totals.visible / (frames + 1), totals.picks / (frames + 1));
+	if (totals.pick_mismatches) {
+		printf("FAILED: %zu picks kept the triangle of another sphere\n", totals.pick_mismatches);
+		return 1;
+	}
+	return 0;
+}
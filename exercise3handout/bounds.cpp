@@ -0,0 +1,290 @@
+#include "bounds.h"
+
+#include <float.h>
+#include <math.h>
+
+#if defined( MATHS_SIMD_SSE )
+#include <xmmintrin.h>
+#elif defined( MATHS_SIMD_NEON )
+#include <arm_neon.h>
+#endif
+
+/*------------------------------BOUNDING VOLUMES------------------------------*/
+vec3 AABB::center() const {
+	return vec3((min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f);
+}
+
+vec3 AABB::extents() const {
+	return vec3((max.x - min.x) * 0.5f, (max.y - min.y) * 0.5f, (max.z - min.z) * 0.5f);
+}
+
+AABB compute_aabb(const float* positions, size_t count) {
+	AABB box;
+	if (positions == nullptr || count == 0) {
+		box.min = vec3(0.f, 0.f, 0.f);
+		box.max = vec3(0.f, 0.f, 0.f);
+		return box;
+	}
+	box.min = vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+	box.max = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (size_t i = 0; i < count; ++i) {
+		const float* p = positions + i * 3;
+		for (int a = 0; a < 3; ++a) {
+			box.min.v[a] = fminf(box.min.v[a], p[a]);
+			box.max.v[a] = fmaxf(box.max.v[a], p[a]);
+		}
+	}
+	return box;
+}
+
+BoundingSphere compute_bounding_sphere(const float* positions, size_t count, const AABB& box) {
+	BoundingSphere sphere;
+	sphere.center = box.center();
+	float radius2 = 0.f;
+	for (size_t i = 0; i < count; ++i) {
+		const float* p = positions + i * 3;
+		float dx = p[0] - sphere.center.x;
+		float dy = p[1] - sphere.center.y;
+		float dz = p[2] - sphere.center.z;
+		radius2 = fmaxf(radius2, dx * dx + dy * dy + dz * dz);
+	}
+	sphere.radius = sqrtf(radius2);
+	return sphere;
+}
+
+AABB transform_aabb(const AABB& box, const mat4& m) {
+	// Arvo: the new half extents are |M| times the old ones
+	vec3 c = box.center();
+	vec3 e = box.extents();
+	AABB result;
+	for (int row = 0; row < 3; ++row) {
+		float center = m.m[12 + row];
+		float extent = 0.f;
+		for (int col = 0; col < 3; ++col) {
+			float a = m.m[col * 4 + row];
+			center += a * c.v[col];
+			extent += fabsf(a) * e.v[col];
+		}
+		result.min.v[row] = center - extent;
+		result.max.v[row] = center + extent;
+	}
+	return result;
+}
+
+BoundingSphere transform_sphere(const BoundingSphere& sphere, const mat4& m) {
+	BoundingSphere result;
+	float scale2 = 0.f;
+	for (int col = 0; col < 3; ++col) {
+		const float* axis = m.m + col * 4;
+		scale2 = fmaxf(scale2, axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	}
+	for (int row = 0; row < 3; ++row) {
+		result.center.v[row] = m.m[row] * sphere.center.x + m.m[4 + row] * sphere.center.y
+			+ m.m[8 + row] * sphere.center.z + m.m[12 + row];
+	}
+	result.radius = sphere.radius * sqrtf(scale2);
+	return result;
+}
+
+/*-------------------------------------RAYS-----------------------------------*/
+RaySlabs::RaySlabs(const vec3& ray_origin, const vec3& direction) {
+	for (int a = 0; a < 3; ++a) {
+		origin[a] = ray_origin.v[a];
+		parallel[a] = fabsf(direction.v[a]) < 1e-12f;
+		inverse[a] = parallel[a] ? 0.f : 1.f / direction.v[a];
+	}
+}
+
+bool intersect_ray_aabb(const RaySlabs& ray, const AABB& box, float max_t, float* t_enter) {
+	float t0 = 0.f;
+	float t1 = max_t;
+	for (int a = 0; a < 3; ++a) {
+		if (ray.parallel[a]) {
+			if (ray.origin[a] < box.min.v[a] || ray.origin[a] > box.max.v[a]) {
+				return false;
+			}
+			continue;
+		}
+		float ta = (box.min.v[a] - ray.origin[a]) * ray.inverse[a];
+		float tb = (box.max.v[a] - ray.origin[a]) * ray.inverse[a];
+		if (ta > tb) {
+			float t = ta;
+			ta = tb;
+			tb = t;
+		}
+		t0 = fmaxf(t0, ta);
+		t1 = fminf(t1, tb);
+		if (t0 > t1) {
+			return false;
+		}
+	}
+	*t_enter = t0;
+	return true;
+}
+
+/*-----------------------------------FRUSTUM----------------------------------*/
+Frustum Frustum::from_matrix(const mat4& view_proj) {
+	// Gribb and Hartmann: each clip plane is the last row plus or minus another
+	const float* m = view_proj.m;
+	vec4 row[4];
+	for (int i = 0; i < 4; ++i) {
+		row[i] = vec4(m[i], m[4 + i], m[8 + i], m[12 + i]);
+	}
+	Frustum frustum;
+	for (int axis = 0; axis < 3; ++axis) {
+		for (int side = 0; side < 2; ++side) {
+			float sign = side == 0 ? 1.f : -1.f;
+			vec4& plane = frustum.planes[axis * 2 + side];
+			for (int k = 0; k < 4; ++k) {
+				plane.v[k] = row[3].v[k] + sign * row[axis].v[k];
+			}
+			float length = sqrtf(plane.v[0] * plane.v[0] + plane.v[1] * plane.v[1] + plane.v[2] * plane.v[2]);
+			for (int k = 0; k < 4; ++k) {
+				plane.v[k] /= length;
+			}
+		}
+	}
+	return frustum;
+}
+
+bool Frustum::intersects(const BoundingSphere& sphere) const {
+	for (int i = 0; i < PlaneCount; ++i) {
+		const float* p = planes[i].v;
+		float d = p[0] * sphere.center.x + p[1] * sphere.center.y + p[2] * sphere.center.z + p[3];
+		if (d < -sphere.radius) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Frustum::intersects(const AABB& box) const {
+	vec3 c = box.center();
+	vec3 e = box.extents();
+	for (int i = 0; i < PlaneCount; ++i) {
+		const float* p = planes[i].v;
+		float d = p[0] * c.x + p[1] * c.y + p[2] * c.z + p[3];
+		float r = fabsf(p[0]) * e.x + fabsf(p[1]) * e.y + fabsf(p[2]) * e.z;
+		if (d < -r) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*----------------------------------CULLING-----------------------------------*/
+void CullBatch::clear() {
+	center_x.clear();
+	center_y.clear();
+	center_z.clear();
+	extent_x.clear();
+	extent_y.clear();
+	extent_z.clear();
+	radius.clear();
+}
+
+size_t CullBatch::add(const AABB& box, const BoundingSphere& sphere) {
+	// both volumes are tested from one centre: the box's, with the sphere
+	// radius grown by the distance between the two centres
+	vec3 c = box.center();
+	vec3 e = box.extents();
+	float dx = sphere.center.x - c.x;
+	float dy = sphere.center.y - c.y;
+	float dz = sphere.center.z - c.z;
+	center_x.push_back(c.x);
+	center_y.push_back(c.y);
+	center_z.push_back(c.z);
+	extent_x.push_back(e.x);
+	extent_y.push_back(e.y);
+	extent_z.push_back(e.z);
+	radius.push_back(sphere.radius + sqrtf(dx * dx + dy * dy + dz * dz));
+	return radius.size() - 1;
+}
+
+size_t CullBatch::size() const {
+	return radius.size();
+}
+
+CullStats cull(const Frustum& frustum, const CullBatch& batch, uint8_t* visible) {
+	// with d the signed distance of the centre to a plane, the sphere is out
+	// when d < -radius and the box when d < -(|n| . extents): one distance,
+	// and the smaller of the two reaches decides
+	size_t count = batch.size();
+	size_t i = 0;
+
+#if defined( MATHS_SIMD_SSE )
+	const __m128 sign_mask = _mm_set1_ps(-0.f);
+	for (; i + 4 <= count; i += 4) {
+		__m128 cx = _mm_loadu_ps(&batch.center_x[i]);
+		__m128 cy = _mm_loadu_ps(&batch.center_y[i]);
+		__m128 cz = _mm_loadu_ps(&batch.center_z[i]);
+		__m128 ex = _mm_loadu_ps(&batch.extent_x[i]);
+		__m128 ey = _mm_loadu_ps(&batch.extent_y[i]);
+		__m128 ez = _mm_loadu_ps(&batch.extent_z[i]);
+		__m128 r = _mm_loadu_ps(&batch.radius[i]);
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < Frustum::PlaneCount; ++p) {
+			const float* plane = frustum.planes[p].v;
+			__m128 nx = _mm_set1_ps(plane[0]);
+			__m128 ny = _mm_set1_ps(plane[1]);
+			__m128 nz = _mm_set1_ps(plane[2]);
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+				_mm_add_ps(_mm_mul_ps(nz, cz), _mm_set1_ps(plane[3])));
+			__m128 box_reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign_mask, nx), ex),
+				_mm_mul_ps(_mm_andnot_ps(sign_mask, ny), ey)), _mm_mul_ps(_mm_andnot_ps(sign_mask, nz), ez));
+			__m128 reach = _mm_min_ps(box_reach, r);
+			// d < -reach  <=>  d + reach < 0
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(d, reach), _mm_setzero_ps()));
+		}
+		int mask = _mm_movemask_ps(outside);
+		for (int lane = 0; lane < 4; ++lane) {
+			visible[i + lane] = (mask >> lane) & 1 ? 0 : 1;
+		}
+	}
+#elif defined( MATHS_SIMD_NEON )
+	for (; i + 4 <= count; i += 4) {
+		float32x4_t cx = vld1q_f32(&batch.center_x[i]);
+		float32x4_t cy = vld1q_f32(&batch.center_y[i]);
+		float32x4_t cz = vld1q_f32(&batch.center_z[i]);
+		float32x4_t ex = vld1q_f32(&batch.extent_x[i]);
+		float32x4_t ey = vld1q_f32(&batch.extent_y[i]);
+		float32x4_t ez = vld1q_f32(&batch.extent_z[i]);
+		float32x4_t r = vld1q_f32(&batch.radius[i]);
+		uint32x4_t outside = vdupq_n_u32(0);
+		for (int p = 0; p < Frustum::PlaneCount; ++p) {
+			const float* plane = frustum.planes[p].v;
+			float32x4_t d = vaddq_f32(vaddq_f32(vmulq_n_f32(cx, plane[0]), vmulq_n_f32(cy, plane[1])),
+				vaddq_f32(vmulq_n_f32(cz, plane[2]), vdupq_n_f32(plane[3])));
+			float32x4_t box_reach = vaddq_f32(vaddq_f32(vmulq_n_f32(ex, fabsf(plane[0])), vmulq_n_f32(ey, fabsf(plane[1]))),
+				vmulq_n_f32(ez, fabsf(plane[2])));
+			float32x4_t reach = vminq_f32(box_reach, r);
+			outside = vorrq_u32(outside, vcltq_f32(vaddq_f32(d, reach), vdupq_n_f32(0.f)));
+		}
+		uint32_t lanes[4];
+		vst1q_u32(lanes, outside);
+		for (int lane = 0; lane < 4; ++lane) {
+			visible[i + lane] = lanes[lane] ? 0 : 1;
+		}
+	}
+#endif
+
+	for (; i < count; ++i) {
+		bool outside = false;
+		for (int p = 0; p < Frustum::PlaneCount && !outside; ++p) {
+			const float* plane = frustum.planes[p].v;
+			float d = plane[0] * batch.center_x[i] + plane[1] * batch.center_y[i] + plane[2] * batch.center_z[i] + plane[3];
+			float box_reach = fabsf(plane[0]) * batch.extent_x[i] + fabsf(plane[1]) * batch.extent_y[i] + fabsf(plane[2]) * batch.extent_z[i];
+			float reach = fminf(box_reach, batch.radius[i]);
+			outside = d + reach < 0.f;
+		}
+		visible[i] = outside ? 0 : 1;
+	}
+
+	CullStats stats;
+	stats.visible = 0;
+	for (size_t j = 0; j < count; ++j) {
+		stats.visible += visible[j];
+	}
+	stats.culled = count - stats.visible;
+	return stats;
+}
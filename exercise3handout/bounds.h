@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "maths_funcs.h"
+
+// Bounding volumes and frustum culling. No GL in here.
+
+struct AABB {
+	vec3 min;
+	vec3 max;
+
+	vec3 center() const;
+	vec3 extents() const; // half the size
+};
+
+struct BoundingSphere {
+	vec3 center;
+	float radius;
+};
+
+// positions are xyz triplets. An empty range gives a zero box at the origin
+AABB compute_aabb(const float* positions, size_t count);
+// centred on the box, radius reaching the farthest vertex
+BoundingSphere compute_bounding_sphere(const float* positions, size_t count, const AABB& box);
+
+// the box around the transformed box, exact for its corners
+AABB transform_aabb(const AABB& box, const mat4& m);
+// the radius grows with the largest axis scale of m
+BoundingSphere transform_sphere(const BoundingSphere& sphere, const mat4& m);
+
+// A ray set up for many slab tests: the inverse direction is computed once.
+// Axes the ray runs parallel to are tested by the origin alone
+struct RaySlabs {
+	float origin[3];
+	float inverse[3];
+	bool parallel[3];
+
+	RaySlabs(const vec3& origin, const vec3& direction);
+};
+
+// distance along the ray at which it enters box, false when it misses it or
+// only reaches it after max_t. 0 when the origin is inside
+bool intersect_ray_aabb(const RaySlabs& ray, const AABB& box, float max_t, float* t_enter);
+
+// Six planes with their normals pointing inside: a point p is inside a plane
+// when dot(plane.xyz, p) + plane.w >= 0. Normalised, so w is a distance.
+struct Frustum {
+
+	enum { Left, Right, Bottom, Top, Near, Far, PlaneCount };
+
+	vec4 planes[PlaneCount];
+
+	// planes of the clip volume of view_proj, in the space view_proj maps from
+	static Frustum from_matrix(const mat4& view_proj);
+
+	bool intersects(const BoundingSphere& sphere) const;
+	bool intersects(const AABB& box) const;
+};
+
+// World bounds of many objects in structure-of-arrays form, so cull() can
+// test four of them per plane with one SIMD instruction.
+struct CullBatch {
+
+	std::vector<float> center_x, center_y, center_z;
+	std::vector<float> extent_x, extent_y, extent_z;
+	std::vector<float> radius;
+
+	void clear();
+	// returns the index the object has in visible[] after cull()
+	size_t add(const AABB& box, const BoundingSphere& sphere);
+	size_t size() const;
+};
+
+struct CullStats {
+	size_t visible;
+	size_t culled;
+};
+
+// visible[i] = 1 when both the sphere and the box of object i touch the
+// frustum, 0 otherwise. visible needs batch.size() entries. Conservative:
+// the sphere is regrown around the box centre, and a volume straddling two
+// planes outside a corner still counts as visible
+CullStats cull(const Frustum& frustum, const CullBatch& batch, uint8_t* visible);
@@ -0,0 +1,575 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+
+namespace {
+
+	AABB merge(const AABB& a, const AABB& b) {
+		AABB box;
+		for (int i = 0; i < 3; ++i) {
+			box.min.v[i] = fminf(a.min.v[i], b.min.v[i]);
+			box.max.v[i] = fmaxf(a.max.v[i], b.max.v[i]);
+		}
+		return box;
+	}
+
+	AABB grow(const AABB& a, float amount) {
+		AABB box;
+		for (int i = 0; i < 3; ++i) {
+			box.min.v[i] = a.min.v[i] - amount;
+			box.max.v[i] = a.max.v[i] + amount;
+		}
+		return box;
+	}
+
+	float surface_area(const AABB& box) {
+		float x = box.max.x - box.min.x;
+		float y = box.max.y - box.min.y;
+		float z = box.max.z - box.min.z;
+		return 2.f * (x * y + y * z + z * x);
+	}
+
+	bool contains(const AABB& outer, const AABB& inner) {
+		for (int i = 0; i < 3; ++i) {
+			if (inner.min.v[i] < outer.min.v[i] || inner.max.v[i] > outer.max.v[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool overlaps(const AABB& a, const AABB& b) {
+		for (int i = 0; i < 3; ++i) {
+			if (a.max.v[i] < b.min.v[i] || b.max.v[i] < a.min.v[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	enum Containment { Outside, Intersecting, Inside };
+
+	Containment classify(const Frustum& frustum, const AABB& box) {
+		vec3 c = box.center();
+		vec3 e = box.extents();
+		Containment result = Inside;
+		for (int i = 0; i < Frustum::PlaneCount; ++i) {
+			const float* p = frustum.planes[i].v;
+			float d = p[0] * c.x + p[1] * c.y + p[2] * c.z + p[3];
+			float r = fabsf(p[0]) * e.x + fabsf(p[1]) * e.y + fabsf(p[2]) * e.z;
+			if (d < -r) {
+				return Outside;
+			}
+			if (d < r) {
+				result = Intersecting;
+			}
+		}
+		return result;
+	}
+
+}
+
+DynamicBVH::DynamicBVH(float margin)
+	:root(Null)
+	,margin(margin)
+	,free_list(Null)
+	,leaf_count(0)
+{
+}
+
+void DynamicBVH::clear() {
+	nodes.clear();
+	root = Null;
+	free_list = Null;
+	leaf_count = 0;
+}
+
+size_t DynamicBVH::size() const {
+	return leaf_count;
+}
+
+int DynamicBVH::height() const {
+	return root == Null ? 0 : nodes[root].height;
+}
+
+int DynamicBVH::allocate() {
+	int index;
+	if (free_list == Null) {
+		index = (int)nodes.size();
+		nodes.push_back(TreeNode());
+	}
+	else {
+		index = free_list;
+		free_list = nodes[index].parent;
+	}
+	TreeNode& node = nodes[index];
+	node.parent = Null;
+	node.left = Null;
+	node.right = Null;
+	node.height = 0;
+	node.user = 0;
+	return index;
+}
+
+void DynamicBVH::release(int index) {
+	nodes[index].parent = free_list;
+	nodes[index].height = -1;
+	free_list = index;
+}
+
+int DynamicBVH::insert(const AABB& box, uint32_t user) {
+	int leaf = allocate();
+	nodes[leaf].box = grow(box, margin);
+	nodes[leaf].user = user;
+	insert_leaf(leaf, INT_MAX);
+	++leaf_count;
+	return leaf;
+}
+
+void DynamicBVH::remove(int proxy) {
+	assert(nodes[proxy].leaf() && nodes[proxy].height == 0);
+	remove_leaf(proxy);
+	release(proxy);
+	--leaf_count;
+}
+
+bool DynamicBVH::update(int proxy, const AABB& box) {
+	const AABB& fat = nodes[proxy].box;
+	AABB loosest = grow(box, 4.f * margin);
+	// still inside, and the fat box has not grown far too loose after a shrink
+	if (contains(fat, box) && contains(loosest, fat)) {
+		return false;
+	}
+	// a short move: the fat box grows over the old and the new place and the
+	// ancestors grow with it, the tree keeps its shape. An object that keeps
+	// going soon outgrows loosest and is reinserted below
+	AABB enlarged = merge(fat, grow(box, margin));
+	if (contains(loosest, enlarged)) {
+		nodes[proxy].box = enlarged;
+		enlarge_upwards(nodes[proxy].parent, enlarged);
+		return false;
+	}
+	remove_leaf(proxy);
+	nodes[proxy].box = grow(box, margin);
+	// moved objects often, the cheap search. insert() did the thorough one
+	insert_leaf(proxy, ReinsertBudget);
+	return true;
+}
+
+uint32_t DynamicBVH::user(int proxy) const {
+	return nodes[proxy].user;
+}
+
+const AABB& DynamicBVH::fat_box(int proxy) const {
+	return nodes[proxy].box;
+}
+
+int DynamicBVH::find_sibling(const AABB& leaf_box, int budget) {
+	// branch and bound search for the sibling that grows the total surface
+	// of the tree least: pairing with a node costs the area of the new
+	// parent plus what every ancestor of that node grows by (inherited)
+	float leaf_area = surface_area(leaf_box);
+	int best = root;
+	float best_cost = surface_area(merge(nodes[root].box, leaf_box));
+
+	search.clear();
+	search.push_back(Candidate(root, 0.f));
+	for (int visited = 0; !search.empty(); ++visited) {
+		std::pop_heap(search.begin(), search.end());
+		Candidate candidate = search.back();
+		search.pop_back();
+
+		// out of budget: the most promising candidate left is followed down
+		// alone, always into the child that grows least
+		bool greedy = visited >= budget;
+		if (greedy) {
+			search.clear();
+		}
+
+		const TreeNode& node = nodes[candidate.index];
+		float combined_area = surface_area(merge(node.box, leaf_box));
+		float cost = combined_area + candidate.inherited;
+		if (cost < best_cost) {
+			best_cost = cost;
+			best = candidate.index;
+		}
+		if (node.leaf()) {
+			continue;
+		}
+		// no child can beat the best when even the leaf's own area doesn't fit
+		float inherited = candidate.inherited + combined_area - surface_area(node.box);
+		if (leaf_area + inherited >= best_cost) {
+			continue;
+		}
+		if (greedy) {
+			const TreeNode& left = nodes[node.left];
+			const TreeNode& right = nodes[node.right];
+			float left_growth = surface_area(merge(left.box, leaf_box)) - surface_area(left.box);
+			float right_growth = surface_area(merge(right.box, leaf_box)) - surface_area(right.box);
+			search.push_back(Candidate(left_growth < right_growth ? node.left : node.right, inherited));
+			continue;
+		}
+		search.push_back(Candidate(node.left, inherited));
+		std::push_heap(search.begin(), search.end());
+		search.push_back(Candidate(node.right, inherited));
+		std::push_heap(search.begin(), search.end());
+	}
+	return best;
+}
+
+void DynamicBVH::insert_leaf(int leaf, int budget) {
+	if (root == Null) {
+		root = leaf;
+		nodes[leaf].parent = Null;
+		return;
+	}
+
+	AABB leaf_box = nodes[leaf].box;
+	int sibling = find_sibling(leaf_box, budget);
+	int old_parent = nodes[sibling].parent;
+	int new_parent = allocate();
+	nodes[new_parent].parent = old_parent;
+	nodes[new_parent].box = merge(leaf_box, nodes[sibling].box);
+	nodes[new_parent].height = nodes[sibling].height + 1;
+	nodes[new_parent].left = sibling;
+	nodes[new_parent].right = leaf;
+	nodes[sibling].parent = new_parent;
+	nodes[leaf].parent = new_parent;
+
+	if (old_parent == Null) {
+		root = new_parent;
+	}
+	else if (nodes[old_parent].left == sibling) {
+		nodes[old_parent].left = new_parent;
+	}
+	else {
+		nodes[old_parent].right = new_parent;
+	}
+
+	refit_upwards(new_parent);
+}
+
+void DynamicBVH::remove_leaf(int leaf) {
+	if (leaf == root) {
+		root = Null;
+		return;
+	}
+
+	int parent = nodes[leaf].parent;
+	int grand_parent = nodes[parent].parent;
+	int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+	release(parent);
+	if (grand_parent == Null) {
+		root = sibling;
+		nodes[sibling].parent = Null;
+		return;
+	}
+
+	if (nodes[grand_parent].left == parent) {
+		nodes[grand_parent].left = sibling;
+	}
+	else {
+		nodes[grand_parent].right = sibling;
+	}
+	nodes[sibling].parent = grand_parent;
+	refit_upwards(grand_parent);
+}
+
+void DynamicBVH::enlarge_upwards(int index, const AABB& box) {
+	// stops at the first ancestor that already holds the box, all above do too
+	while (index != Null && !contains(nodes[index].box, box)) {
+		nodes[index].box = merge(nodes[index].box, box);
+		index = nodes[index].parent;
+	}
+}
+
+void DynamicBVH::refit_upwards(int index) {
+	while (index != Null) {
+		index = balance(index);
+		TreeNode& node = nodes[index];
+		const TreeNode& left = nodes[node.left];
+		const TreeNode& right = nodes[node.right];
+		node.height = 1 + (left.height > right.height ? left.height : right.height);
+		node.box = merge(left.box, right.box);
+		index = node.parent;
+	}
+}
+
+int DynamicBVH::balance(int index_a) {
+	TreeNode& a = nodes[index_a];
+	if (a.leaf() || a.height < 2) {
+		return index_a;
+	}
+
+	int index_b = a.left;
+	int index_c = a.right;
+	TreeNode& b = nodes[index_b];
+	TreeNode& c = nodes[index_c];
+	int difference = c.height - b.height;
+
+	// rotate c up
+	if (difference > 1) {
+		int index_f = c.left;
+		int index_g = c.right;
+		TreeNode& f = nodes[index_f];
+		TreeNode& g = nodes[index_g];
+
+		c.left = index_a;
+		c.parent = a.parent;
+		a.parent = index_c;
+		if (c.parent == Null) {
+			root = index_c;
+		}
+		else if (nodes[c.parent].left == index_a) {
+			nodes[c.parent].left = index_c;
+		}
+		else {
+			nodes[c.parent].right = index_c;
+		}
+
+		// the taller grandchild stays under c
+		if (f.height > g.height) {
+			c.right = index_f;
+			a.right = index_g;
+			g.parent = index_a;
+			a.box = merge(b.box, g.box);
+			c.box = merge(a.box, f.box);
+			a.height = 1 + (b.height > g.height ? b.height : g.height);
+			c.height = 1 + (a.height > f.height ? a.height : f.height);
+		}
+		else {
+			c.right = index_g;
+			a.right = index_f;
+			f.parent = index_a;
+			a.box = merge(b.box, f.box);
+			c.box = merge(a.box, g.box);
+			a.height = 1 + (b.height > f.height ? b.height : f.height);
+			c.height = 1 + (a.height > g.height ? a.height : g.height);
+		}
+		return index_c;
+	}
+
+	// rotate b up
+	if (difference < -1) {
+		int index_d = b.left;
+		int index_e = b.right;
+		TreeNode& d = nodes[index_d];
+		TreeNode& e = nodes[index_e];
+
+		b.left = index_a;
+		b.parent = a.parent;
+		a.parent = index_b;
+		if (b.parent == Null) {
+			root = index_b;
+		}
+		else if (nodes[b.parent].left == index_a) {
+			nodes[b.parent].left = index_b;
+		}
+		else {
+			nodes[b.parent].right = index_b;
+		}
+
+		if (d.height > e.height) {
+			b.right = index_d;
+			a.left = index_e;
+			e.parent = index_a;
+			a.box = merge(c.box, e.box);
+			b.box = merge(a.box, d.box);
+			a.height = 1 + (c.height > e.height ? c.height : e.height);
+			b.height = 1 + (a.height > d.height ? a.height : d.height);
+		}
+		else {
+			b.right = index_e;
+			a.left = index_d;
+			d.parent = index_a;
+			a.box = merge(c.box, d.box);
+			b.box = merge(a.box, e.box);
+			a.height = 1 + (c.height > d.height ? c.height : d.height);
+			b.height = 1 + (a.height > e.height ? a.height : e.height);
+		}
+		return index_b;
+	}
+
+	return index_a;
+}
+
+bool DynamicBVH::raycast(const vec3& origin, const vec3& direction, float max_distance, const RayHit& hit,
+	uint32_t* user, float* distance) const {
+	if (root == Null) {
+		return false;
+	}
+
+	RaySlabs ray(origin, direction);
+
+	struct Entry {
+		int index;
+		float t;
+	};
+	Entry stack[StackSize];
+	int top = 0;
+
+	float best = max_distance;
+	bool found = false;
+
+	float t;
+	if (!intersect_ray_aabb(ray, nodes[root].box, best, &t)) {
+		return false;
+	}
+	stack[top].index = root;
+	stack[top].t = t;
+	++top;
+
+	while (top > 0) {
+		Entry entry = stack[--top];
+		// a closer hit was found since this was pushed
+		if (entry.t > best) {
+			continue;
+		}
+		const TreeNode& node = nodes[entry.index];
+
+		if (node.leaf()) {
+			float d = hit(node.user);
+			if (d >= 0.f && d <= best) {
+				best = d;
+				found = true;
+				*user = node.user;
+			}
+			continue;
+		}
+
+		float t_left, t_right;
+		bool hit_left = intersect_ray_aabb(ray, nodes[node.left].box, best, &t_left);
+		bool hit_right = intersect_ray_aabb(ray, nodes[node.right].box, best, &t_right);
+		assert(top + 2 <= StackSize);
+		// the nearer child goes on top so it is searched first
+		if (hit_left && hit_right) {
+			bool left_first = t_left <= t_right;
+			stack[top].index = left_first ? node.right : node.left;
+			stack[top].t = left_first ? t_right : t_left;
+			++top;
+			stack[top].index = left_first ? node.left : node.right;
+			stack[top].t = left_first ? t_left : t_right;
+			++top;
+		}
+		else if (hit_left) {
+			stack[top].index = node.left;
+			stack[top].t = t_left;
+			++top;
+		}
+		else if (hit_right) {
+			stack[top].index = node.right;
+			stack[top].t = t_right;
+			++top;
+		}
+	}
+
+	if (found) {
+		*distance = best;
+	}
+	return found;
+}
+
+void DynamicBVH::query(const AABB& box, std::vector<uint32_t>& users) const {
+	if (root == Null) {
+		return;
+	}
+	int stack[StackSize];
+	int top = 0;
+	stack[top++] = root;
+	while (top > 0) {
+		const TreeNode& node = nodes[stack[--top]];
+		if (!overlaps(node.box, box)) {
+			continue;
+		}
+		if (node.leaf()) {
+			users.push_back(node.user);
+			continue;
+		}
+		assert(top + 2 <= StackSize);
+		stack[top++] = node.left;
+		stack[top++] = node.right;
+	}
+}
+
+void DynamicBVH::query(const Frustum& frustum, std::vector<uint32_t>& users) const {
+	if (root == Null) {
+		return;
+	}
+	int stack[StackSize];
+	int top = 0;
+	stack[top++] = root;
+	while (top > 0) {
+		int index = stack[--top];
+		const TreeNode& node = nodes[index];
+		Containment containment = classify(frustum, node.box);
+		if (containment == Outside) {
+			continue;
+		}
+		// nothing below needs testing
+		if (containment == Inside || node.leaf()) {
+			add_leaves(index, users);
+			continue;
+		}
+		assert(top + 2 <= StackSize);
+		stack[top++] = node.left;
+		stack[top++] = node.right;
+	}
+}
+
+void DynamicBVH::add_leaves(int index, std::vector<uint32_t>& users) const {
+	int stack[StackSize];
+	int top = 0;
+	stack[top++] = index;
+	while (top > 0) {
+		const TreeNode& node = nodes[stack[--top]];
+		if (node.leaf()) {
+			users.push_back(node.user);
+			continue;
+		}
+		assert(top + 2 <= StackSize);
+		stack[top++] = node.left;
+		stack[top++] = node.right;
+	}
+}
+
+bool DynamicBVH::validate() const {
+	if (root == Null) {
+		return leaf_count == 0;
+	}
+	if (nodes[root].parent != Null) {
+		return false;
+	}
+	size_t leaves = 0;
+	std::vector<int> stack(1, root);
+	while (!stack.empty()) {
+		int index = stack.back();
+		stack.pop_back();
+		const TreeNode& node = nodes[index];
+		if (node.leaf()) {
+			if (node.height != 0 || node.right != Null) {
+				return false;
+			}
+			++leaves;
+			continue;
+		}
+		const TreeNode& left = nodes[node.left];
+		const TreeNode& right = nodes[node.right];
+		if (left.parent != index || right.parent != index) {
+			return false;
+		}
+		int expected = 1 + (left.height > right.height ? left.height : right.height);
+		if (node.height != expected) {
+			return false;
+		}
+		if (!contains(node.box, left.box) || !contains(node.box, right.box)) {
+			return false;
+		}
+		stack.push_back(node.left);
+		stack.push_back(node.right);
+	}
+	return leaves == leaf_count;
+}
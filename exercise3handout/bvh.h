@@ -0,0 +1,96 @@
+#pragma once
+
+#include <functional>
+#include <stdint.h>
+#include <vector>
+#include "bounds.h"
+
+// Dynamic bounding volume hierarchy over world space boxes, for scene level
+// queries (picking, frustum, overlap). Every object is a leaf holding a box
+// fattened by margin, so small moves are absorbed by update() without
+// touching the tree. Inserts pick the sibling that adds the least surface
+// area with a branch and bound search, and the branches are kept roughly
+// balanced with AVL style rotations, as in Box2D's b2DynamicTree. Reinserts
+// of moving objects cut that search short after ReinsertBudget nodes and
+// descend greedily from there.
+//
+// Leaves are addressed by the proxy id insert() returns; the caller keeps
+// its own id in the leaf's user field and gets it back from the queries.
+struct DynamicBVH {
+
+	static const int Null = -1;
+
+	struct TreeNode {
+		AABB box;
+		int parent;  // next free slot while the node is on the free list
+		int left;
+		int right;
+		int height;  // 0 for leaves, -1 for free slots
+		uint32_t user;
+
+		bool leaf() const { return left == Null; }
+	};
+
+	std::vector<TreeNode> nodes;
+	int root;
+	float margin;
+
+	explicit DynamicBVH(float margin = 0.1f);
+
+	void clear();
+	size_t size() const;  // leaves
+	int height() const;
+
+	int insert(const AABB& box, uint32_t user);
+	void remove(int proxy);
+	// refit after the object moved. A box that left its fat box but is still
+	// close grows the fat box and its ancestors in place, only a box gone far
+	// reinserts the leaf. Returns true when it did
+	bool update(int proxy, const AABB& box);
+
+	uint32_t user(int proxy) const;
+	const AABB& fat_box(int proxy) const;
+
+	// exact test for a leaf the ray reached: the hit distance along the ray,
+	// negative for a miss
+	typedef std::function<float(uint32_t user)> RayHit;
+	// closest hit within max_distance. direction needs not be normalised,
+	// distances are in units of its length
+	bool raycast(const vec3& origin, const vec3& direction, float max_distance, const RayHit& hit,
+		uint32_t* user, float* distance) const;
+
+	// appends the user ids of every leaf whose fat box touches the volume
+	void query(const AABB& box, std::vector<uint32_t>& users) const;
+	void query(const Frustum& frustum, std::vector<uint32_t>& users) const;
+
+	// checks parent links, heights and that every box contains its children
+	bool validate() const;
+
+private:
+	static const int StackSize = 256;
+	static const int ReinsertBudget = 32;
+
+	int allocate();
+	void release(int index);
+	// budget: nodes the branch and bound search may look at before it
+	// follows the best lead greedily
+	void insert_leaf(int leaf, int budget);
+	int find_sibling(const AABB& leaf_box, int budget);
+	void remove_leaf(int leaf);
+	int balance(int index);
+	void refit_upwards(int index);
+	void enlarge_upwards(int index, const AABB& box);
+	void add_leaves(int index, std::vector<uint32_t>& users) const;
+
+	// insert_leaf() candidates, a min heap on the inherited cost
+	struct Candidate {
+		int index;
+		float inherited;
+		Candidate(int index, float inherited) : index(index), inherited(inherited) {}
+		bool operator<(const Candidate& other) const { return inherited > other.inherited; }
+	};
+	std::vector<Candidate> search;
+
+	int free_list;
+	size_t leaf_count;
+};
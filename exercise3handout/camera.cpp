@@ -1,6 +1,7 @@
 #include "camera.h"
 
 #include <GL/glew.h>
+#include <assert.h>
 
 #define _USE_MATH_DEFINES
 #include <math.h>
@@ -17,16 +18,42 @@ void Camera::updateProjection() {
 	float Sz = -( far + near ) / ( far - near );
 	float Pz = -( 2.0f * far * near ) / ( far - near );
 	proj_mat = { Sx,	 0.0f, 0.0f, 0.0f,	0.0f, Sy,		0.0f, 0.0f, 0.0f, 0.0f, Sz,	 -1.0f, 0.0f, 0.0f, Pz,		0.0f };
+	proj_inverse_mat = inverse_perspective( proj_mat );
 }
 
-void Camera::get_shader_uniforms(GLuint shader_programme) {
+static_assert(sizeof( Camera::Block ) == 3 * 64 + 2 * 16, "Camera::Block must match the std140 layout");
 
-	view_mat_location = glGetUniformLocation( shader_programme, "view" );
-	proj_mat_location = glGetUniformLocation( shader_programme, "proj" );
+Frustum Camera::frustum(const mat4& view) const {
+	return Frustum::from_matrix( proj_mat * view );
 }
 
-void Camera::set_shader_uniforms(GLuint shader_programme, const mat4& view) {
-	// set uniforms
-	glUniformMatrix4fv( view_mat_location, 1, GL_FALSE, view.m );
-	glUniformMatrix4fv( proj_mat_location, 1, GL_FALSE, proj_mat.m );
+void Camera::load_to_gpu() {
+	glGenBuffers( 1, &ubo );
+	glBindBuffer( GL_UNIFORM_BUFFER, ubo );
+	glBufferData( GL_UNIFORM_BUFFER, sizeof( Block ), NULL, GL_STREAM_DRAW );
+	glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+}
+
+void Camera::get_shader_uniforms(const ShaderProgram& shader_programme) {
+	const ShaderProgram::Block* block = shader_programme.find_block( "CameraBlock" );
+	if (!block) {
+		return;
+	}
+	assert(block->data_size == (GLint)sizeof( Block ));
+	shader_programme.bind_block( "CameraBlock", BlockBinding );
+}
+
+void Camera::set_shader_uniforms(const mat4& view, const vec3& position, const vec3& ambient_color) {
+	Block block;
+	block.view = view;
+	block.proj = proj_mat;
+	block.view_proj = proj_mat * view;
+	block.camera_position = vec4( position, 1.0f );
+	block.ambient_color = vec4( ambient_color, 1.0f );
+
+	// a fresh store every frame so the driver never waits on last frame's draws
+	glBindBuffer( GL_UNIFORM_BUFFER, ubo );
+	glBufferData( GL_UNIFORM_BUFFER, sizeof( Block ), &block, GL_STREAM_DRAW );
+	glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+	glBindBufferBase( GL_UNIFORM_BUFFER, BlockBinding, ubo );
 }
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "bounds.h"
 #include "maths_funcs.h"
 #include "node.h"
+#include "shader_program.h"
 #include <GL/glew.h>
 
 struct Camera
@@ -16,13 +18,31 @@ struct Camera
     float aspect;
 
     mat4 proj_mat;
+    mat4 proj_inverse_mat; // kept in sync by updateProjection()
 
-    int view_mat_location;
-    int proj_mat_location;
+    // std140 layout of the CameraBlock uniform block the shaders declare.
+    // Every member is a multiple of 16 bytes, so no padding is needed
+    struct Block
+    {
+        mat4 view;
+        mat4 proj;
+        mat4 view_proj; // proj * view, so vertex shaders do one multiply less
+        vec4 camera_position; // w unused
+        vec4 ambient_color;   // w unused
+    };
+    static const GLuint BlockBinding = 0;
+
+    GLuint ubo;
 
     void init();
     void updateProjection();
 
-    void get_shader_uniforms(GLuint shader_programme);
-    void set_shader_uniforms(GLuint shader_programme, const mat4 &view);
+    void load_to_gpu();
+    // once per program after linking: points its CameraBlock at BlockBinding
+    void get_shader_uniforms(const ShaderProgram &shader_programme);
+    // once per frame, before any program that reads the block draws
+    void set_shader_uniforms(const mat4 &view, const vec3 &position, const vec3 &ambient_color);
+
+    // world space planes of what proj_mat * view sees
+    Frustum frustum(const mat4 &view) const;
 };
@@ -0,0 +1,158 @@
+#include "debug_draw.h"
+
+#include <math.h>
+#include "transform_hierarchy.h"
+
+namespace {
+
+	vec3 transform_point(const mat4& m, const vec3& p) {
+		vec4 clip = m * vec4(p.x, p.y, p.z, 1.f);
+		return vec3(clip.x / clip.w, clip.y / clip.w, clip.z / clip.w);
+	}
+
+	vec3 unit_column(const mat4& m, int column) {
+		const float* c = m.m + column * 4;
+		float length = sqrtf(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+		float scale = length > 0.f ? 1.f / length : 0.f;
+		return vec3(c[0] * scale, c[1] * scale, c[2] * scale);
+	}
+}
+
+GLuint DebugDraw::vertex(const vec3& position, const vec3& color) {
+	lines.points.push_back(position);
+	lines.colors.push_back(color);
+	return (GLuint)(lines.points.size() - 1);
+}
+
+void DebugDraw::line(const vec3& from, const vec3& to, const vec3& color) {
+	lines.indices.push_back(vertex(from, color));
+	lines.indices.push_back(vertex(to, color));
+}
+
+void DebugDraw::arrow(const vec3& from, const vec3& to, const vec3& color) {
+	float dx = to.x - from.x;
+	float dy = to.y - from.y;
+	float dz = to.z - from.z;
+	float length = sqrtf(dx * dx + dy * dy + dz * dz);
+	GLuint tip = vertex(to, color);
+	lines.indices.push_back(vertex(from, color));
+	lines.indices.push_back(tip);
+	if (length <= 0.f) {
+		return;
+	}
+
+	// two axes across the shaft, from whichever world axis is least aligned with it
+	vec3 along(dx / length, dy / length, dz / length);
+	vec3 other = fabsf(along.x) < 0.9f ? vec3(1.f, 0.f, 0.f) : vec3(0.f, 1.f, 0.f);
+	vec3 side = normalise(cross(along, other));
+	vec3 up = cross(side, along);
+
+	float head = length * 0.15f;
+	float spread = head * 0.4f;
+	vec3 base(to.x - along.x * head, to.y - along.y * head, to.z - along.z * head);
+	for (int k = 0; k < 4; ++k) {
+		const vec3& axis = k < 2 ? side : up;
+		float sign = k % 2 ? -1.f : 1.f;
+		vec3 corner(base.x + axis.x * spread * sign, base.y + axis.y * spread * sign, base.z + axis.z * spread * sign);
+		lines.indices.push_back(tip);
+		lines.indices.push_back(vertex(corner, color));
+	}
+}
+
+void DebugDraw::aabb(const AABB& box, const vec3& color) {
+	// corner k has the max of axis a when bit a of k is set
+	GLuint first = 0;
+	for (int k = 0; k < 8; ++k) {
+		vec3 corner(k & 1 ? box.max.x : box.min.x, k & 2 ? box.max.y : box.min.y, k & 4 ? box.max.z : box.min.z);
+		GLuint index = vertex(corner, color);
+		first = k == 0 ? index : first;
+	}
+	for (int k = 0; k < 8; ++k) {
+		for (int bit = 1; bit < 8; bit <<= 1) {
+			if (!(k & bit)) {
+				lines.indices.push_back(first + k);
+				lines.indices.push_back(first + (k | bit));
+			}
+		}
+	}
+}
+
+void DebugDraw::sphere(const vec3& center, float radius, const vec3& color, int segments) {
+	for (int axis = 0; axis < 3; ++axis) {
+		GLuint first = 0;
+		for (int s = 0; s < segments; ++s) {
+			float angle = 2.f * (float)M_PI * s / segments;
+			float a = cosf(angle) * radius;
+			float b = sinf(angle) * radius;
+			vec3 point = center;
+			point.v[(axis + 1) % 3] += a;
+			point.v[(axis + 2) % 3] += b;
+			GLuint index = vertex(point, color);
+			first = s == 0 ? index : first;
+		}
+		for (int s = 0; s < segments; ++s) {
+			lines.indices.push_back(first + s);
+			lines.indices.push_back(first + (s + 1) % segments);
+		}
+	}
+}
+
+void DebugDraw::frustum(const mat4& view_proj, const vec3& color) {
+	// the clip cube's corners, back through the inverse, and the cube's edges
+	mat4 clip_to_world = inverse(view_proj);
+	GLuint first = 0;
+	for (int k = 0; k < 8; ++k) {
+		vec3 clip(k & 1 ? 1.f : -1.f, k & 2 ? 1.f : -1.f, k & 4 ? 1.f : -1.f);
+		GLuint index = vertex(transform_point(clip_to_world, clip), color);
+		first = k == 0 ? index : first;
+	}
+	for (int k = 0; k < 8; ++k) {
+		for (int bit = 1; bit < 8; bit <<= 1) {
+			if (!(k & bit)) {
+				lines.indices.push_back(first + k);
+				lines.indices.push_back(first + (k | bit));
+			}
+		}
+	}
+}
+
+void DebugDraw::axes(const mat4& world, float size) {
+	vec3 origin(world.m[12], world.m[13], world.m[14]);
+	for (int column = 0; column < 3; ++column) {
+		vec3 axis = unit_column(world, column);
+		vec3 color(column == 0 ? 1.f : 0.f, column == 1 ? 1.f : 0.f, column == 2 ? 1.f : 0.f);
+		line(origin, vec3(origin.x + axis.x * size, origin.y + axis.y * size, origin.z + axis.z * size), color);
+	}
+}
+
+void DebugDraw::axes(const Node& node, float size) {
+	axes(node.worldMatrix(), size);
+}
+
+void DebugDraw::axes(const TransformHierarchy& hierarchy, float size) {
+	for (size_t i = 0; i < hierarchy.worldMatrices.size(); ++i) {
+		if (hierarchy.flags[i] & TransformHierarchy::Free) {
+			continue;
+		}
+		axes(hierarchy.worldMatrices[i], size);
+	}
+}
+
+size_t DebugDraw::line_count() const {
+	return lines.indices.size() / 2;
+}
+
+void DebugDraw::get_shader_uniforms(const ShaderProgram& shader_programme) {
+	lines.get_shader_uniforms(shader_programme);
+}
+
+void DebugDraw::flush(const ShaderProgram& shader_programme) {
+	lines.load_to_gpu();
+	lines.set_shader_uniforms(shader_programme, identity_mat4());
+	lines.render(shader_programme);
+	lines.clear();
+}
+
+void DebugDraw::unload_from_gpu() {
+	lines.unload_from_gpu();
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <GL/Glew.h>
+#include "bounds.h"
+#include "lineshapes.h"
+#include "maths_funcs.h"
+#include "node.h"
+#include "shader_program.h"
+
+struct TransformHierarchy;
+
+// Immediate mode debug lines. Anything can queue primitives during the
+// frame, they all go into one vertex stream and flush() draws them with a
+// single call, then starts over. The CPU arrays keep their capacity and
+// the GPU side is a Lines ring, so a frame of debug drawing allocates
+// nothing once the scene has been drawn at its largest.
+struct DebugDraw {
+
+	Lines lines;
+
+	void line(const vec3& from, const vec3& to, const vec3& color);
+	// a line with a four stroke head at to
+	void arrow(const vec3& from, const vec3& to, const vec3& color);
+	void aabb(const AABB& box, const vec3& color);
+	// three great circles, around the x, y and z axes
+	void sphere(const vec3& center, float radius, const vec3& color, int segments = 16);
+	// the twelve edges of the clip volume of view_proj
+	void frustum(const mat4& view_proj, const vec3& color);
+	// x, y and z of a world matrix in red, green and blue, size long
+	void axes(const mat4& world, float size = 1.f);
+	void axes(const Node& node, float size = 1.f);
+	// every node of the hierarchy
+	void axes(const TransformHierarchy& hierarchy, float size = 1.f);
+
+	size_t line_count() const;
+
+	void get_shader_uniforms(const ShaderProgram& shader_programme);
+	// uploads and draws everything queued since the last flush, in world
+	// space, with shader_programme bound. Then empties the queue
+	void flush(const ShaderProgram& shader_programme);
+	void unload_from_gpu();
+
+private:
+	GLuint vertex(const vec3& position, const vec3& color);
+};
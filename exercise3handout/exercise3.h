@@ -6,12 +6,20 @@
 #include <array>
 #include <assert.h>
 
+#include "animation.h"
+#include "bounds.h"
+#include "bvh.h"
 #include "camera.h"
+#include "debug_draw.h"
 #include "gl_utils.h"
+#include "instanced_renderer.h"
 #include "lineshapes.h"
 #include "maths_funcs.h"
 #include "mesh.h"
 #include "node.h"
+#include "profiler.h"
+#include "render_queue.h"
+#include "shader_program.h"
 
 constexpr int NumSpheres = 4;
 
@@ -43,8 +51,10 @@ struct Exercise3
 
     // ------------------------------------------------------------------------------------------ REVIEW
 
-    static vec3 getWorldMousePosition(float _mouseX, float _mouseY, float _wWidth, float _wHeight, const mat4 &_projMat,
-                                      const mat4 &_viewMat, const vec3 &_camPos)
+    // Takes the inverse projection and the inverse view (the camera world matrix) so a click
+    // does not have to invert anything.
+    static vec3 getWorldMousePosition(float _mouseX, float _mouseY, float _wWidth, float _wHeight,
+                                      const mat4 &_invProjMat, const mat4 &_invViewMat, const vec3 &_camPos)
     {
         // General info on the proj-view-model concept
         // https://stackoverflow.com/questions/46749675/opengl-mouse-coordinates-to-space-coordinates
@@ -61,11 +71,11 @@ struct Exercise3
         auto mouse_clip = vec4(mouse_ndc.x, mouse_ndc.y, -1.f, 1.f); // negative z should be forwards
 
         // Clip to eye, in between 'near' and 'far', camera is origin
-        auto mouse_eye = inverse(_projMat) * mouse_clip;
+        auto mouse_eye = _invProjMat * mouse_clip;
         mouse_eye = vec4(mouse_eye.x, mouse_eye.y, -1.f, 0.f);
 
         // Eye to world, in world space, root is origin
-        auto mouse_world = vec3(inverse(_viewMat) * mouse_eye);
+        auto mouse_world = vec3(_invViewMat * mouse_eye);
 
         return normalise(mouse_world) + _camPos;
     }
@@ -159,16 +169,37 @@ struct Exercise3
     {
         Exercise3 &exercise = *static_cast<Exercise3 *>(glfwGetWindowUserPointer(window));
 
+        if (key == GLFW_KEY_I && action == GLFW_PRESS)
+        {
+            exercise.useInstancing = !exercise.useInstancing;
+            printf("spheres drawn %s\n", exercise.useInstancing ? "instanced" : "through the render queue");
+            return;
+        }
+
+        if (key == GLFW_KEY_G && action == GLFW_PRESS)
+        {
+            exercise.showDebug = !exercise.showDebug;
+            return;
+        }
+
+        if (key == GLFW_KEY_P && action == GLFW_PRESS)
+        {
+            const char *traceFile = "frame_trace.json";
+            if (Profiler::main().write_chrome_trace(traceFile))
+                printf("last %d frames written to %s\n", Profiler::main().frame_count(), traceFile);
+            return;
+        }
+
         // --------------------------------------------------------------------------- REVIEW
         if (key != GLFW_KEY_F) // Changed to F because couldn't find K0
             return;
         // ---------------------------------------------------------------------------
 
-        auto cam = vec3(exercise.camNode.worldMatrix.getColumn(3));
+        auto cam = vec3(exercise.camNode.worldMatrix().getColumn(3));
         auto mouse =
             getWorldMousePosition(static_cast<float>(mousePosX), static_cast<float>(mousePosY),
                                   static_cast<float>(exercise.windowsWidth), static_cast<float>(exercise.windowsHeight),
-                                  exercise.camera.proj_mat, exercise.camNode.worldInverseMatrix, cam);
+                                  exercise.camera.proj_inverse_mat, exercise.camNode.worldMatrix(), cam);
 
         auto ray = Ray(mouse, normalise(mouse - cam));
 
@@ -183,44 +214,77 @@ struct Exercise3
 
         if (GLFW_PRESS == action)
         {
-            auto cam = vec3(exercise.camNode.worldMatrix.getColumn(3));
-            auto mouse = getWorldMousePosition(static_cast<float>(mousePosX), static_cast<float>(mousePosY),
-                                               static_cast<float>(exercise.windowsWidth),
-                                               static_cast<float>(exercise.windowsHeight), exercise.camera.proj_mat,
-                                               exercise.camNode.worldInverseMatrix, cam);
-
-            auto ray = Ray(mouse, normalise(mouse - cam));
-
-            auto closest_sphere = -1;
-            auto closest_sphere_dis = std::numeric_limits<float>::max();
+            TriangleHit hit;
+            auto closest_sphere = exercise.pickSphere(exercise.mouseRay(), &hit);
 
-            for (auto i = 0; i < NumSpheres; i++)
-            {
-                auto this_sphere_dis = 0.f;
-                auto pos = vec3(exercise.sphereNodes[i].worldMatrix.getColumn(3));
+            exercise.selectedSphereIndex = closest_sphere;
+            if (closest_sphere < 0)
+                printf("sphere %i was clicked\n", closest_sphere);
+            else
+                printf("sphere %i was clicked, triangle %u at %.3f (u %.3f, v %.3f)\n", closest_sphere, hit.triangle,
+                       hit.distance, hit.u, hit.v);
+        }
+    }
 
-                // --------------------------------------------------------------------------- REVIEW
-                // if (!raySphereIntersection(ray, pos, 1, &this_sphere_dis)) // Included
-                //    continue;                                               //
-                if (!raySphereThrough(ray, pos, 1, &this_sphere_dis)) // Mine
-                    continue;                                         //
-                //  ---------------------------------------------------------------------------
+    // Ray from the camera through the cursor
+    Ray mouseRay() const
+    {
+        auto cam = vec3(camNode.worldMatrix().getColumn(3));
+        auto mouse = getWorldMousePosition(static_cast<float>(mousePosX), static_cast<float>(mousePosY),
+                                           static_cast<float>(windowsWidth), static_cast<float>(windowsHeight),
+                                           camera.proj_inverse_mat, camNode.worldMatrix(), cam);
 
-                if (this_sphere_dis > closest_sphere_dis)
-                    continue;
+        return Ray(mouse, normalise(mouse - cam));
+    }
 
-                closest_sphere = i;
-                closest_sphere_dis = this_sphere_dis;
-            }
+    // Closest sphere whose triangles the ray hits, -1 when none. The BVH only calls
+    // back for spheres whose box the ray crosses, closest first, and each of those is
+    // tested against its mesh's triangle BVH in mesh space. A box entered later can
+    // still hold a closer triangle, so only a hit in front of the best one so far
+    // replaces it.
+    int pickSphere(const Ray &ray, TriangleHit *hit_) const
+    {
+        const Meshgroup::Mesh &sphereMesh = meshGroup.meshes[0];
+
+        auto best_distance = std::numeric_limits<float>::max();
+        TriangleHit closest_hit;
+        uint32_t closest_sphere = 0;
+        auto exact_test = [&](uint32_t i) {
+            // the mesh itself rather than its proxy sphere (raySphereThrough)
+            TriangleHit this_hit;
+            if (!sphereMesh.raycast(sphereNodes[i].worldInverseMatrix(), ray.origin, ray.direction, best_distance,
+                                    &this_hit) ||
+                this_hit.distance >= best_distance)
+                return -1.f;
+
+            best_distance = this_hit.distance;
+            closest_hit = this_hit;
+            return this_hit.distance;
+        };
+        float closest_distance = 0.f;
+        if (!sceneBVH.raycast(ray.origin, ray.direction, std::numeric_limits<float>::max(), exact_test,
+                              &closest_sphere, &closest_distance))
+            return -1;
+
+        *hit_ = closest_hit;
+        return static_cast<int>(closest_sphere);
+    }
 
-            exercise.selectedSphereIndex = closest_sphere;
-            printf("sphere %i was clicked\n", closest_sphere);
-        }
+    // Selected spheres are white, the one under the cursor is lightened
+    vec3 sphereDisplayColor(int i) const
+    {
+        if (i == selectedSphereIndex)
+            return vec3(1, 1, 1);
+        if (i == hoveredSphereIndex)
+            return vec3(sphereColor[i].x * 0.5f + 0.5f, sphereColor[i].y * 0.5f + 0.5f, sphereColor[i].z * 0.5f + 0.5f);
+        return sphereColor[i];
     }
 
     vec3 ambientColor = vec3(0.7f, 0.7f, 0.75f);
 
     Meshgroup meshGroup;
+    // plays the group's first clip, if it has any
+    AnimationSampler meshAnimation;
     std::vector<Meshgroup::Mesh *> gulls;
 
     std::array<Node, NumSpheres> sphereNodes;
@@ -228,6 +292,7 @@ struct Exercise3
     std::array<vec3, NumSpheres> sphereScales = {vec3(1, 1, 1), vec3(1, 1, 1), vec3(1, 1, 1), vec3(1, 1, 1)};
     std::array<vec3, NumSpheres> sphereColor = {vec3(1, 0, 0), vec3(0, 1, 0), vec3(0, 0, 1), vec3(1, 1, 0)};
     int selectedSphereIndex = NumSpheres + 1;
+    int hoveredSphereIndex = -1; // picked again every frame while the window has focus
 
     Node meshGroupNode;
     float meshYaw = 0;
@@ -241,12 +306,30 @@ struct Exercise3
     vec3 cameraPosition;
 
     Node sceneRoot;
-    GLuint mesh_shader_index;
-    GLuint lines_shader_index;
+    ShaderProgram mesh_shader;
+    ShaderProgram instanced_shader;
+    ShaderProgram lines_shader;
+
+    // sphere world bounds, tested against the view every frame
+    CullBatch sphereBounds;
+    std::array<uint8_t, NumSpheres> sphereVisible;
+    CullStats cullStats = {};
+
+    // scene level queries over the same world boxes, refit when a sphere moves
+    DynamicBVH sceneBVH;
+    std::array<int, NumSpheres> sphereProxies;
+
+    InstancedRenderer sphereRenderer;
+    RenderQueue renderQueue;
+    bool useInstancing = true; // I toggles between instancing and the render queue
 
     Lines grid;
     Lines axis;
 
+    // node axes, sphere bounds and scene BVH boxes, toggled with G
+    DebugDraw debugDraw;
+    bool showDebug = false;
+
     void init(int width, int height)
     {
 
@@ -260,8 +343,9 @@ struct Exercise3
         startGlContext(&window, width, height);
         glfwSetWindowUserPointer(window, this);
 
-        mesh_shader_index = create_programme_from_files("test_vs.glsl", "test_fs.glsl");
-        lines_shader_index = create_programme_from_files("lines_vs.glsl", "lines_fs.glsl");
+        mesh_shader.load_from_files("test_vs.glsl", "test_fs.glsl");
+        instanced_shader.load_from_files("instanced_vs.glsl", "instanced_fs.glsl");
+        lines_shader.load_from_files("lines_vs.glsl", "lines_fs.glsl");
 
         sceneRoot.init();
 
@@ -271,13 +355,13 @@ struct Exercise3
         for (int i = 0; i < NumSpheres; ++i)
         {
             sphereNodes[i].init();
-            sphereNodes[i].position = spherePositions[i];
+            sphereNodes[i].setPosition(spherePositions[i]);
             meshGroupNode.addChild(sphereNodes[i]);
         }
 
         // float scaleValue = 0.001f;
-        // meshGroupNode.scale = vec3(scaleValue, scaleValue, scaleValue);
-        // meshGroupNode.position = vec3(0, 20, 0);
+        // meshGroupNode.setScale(vec3(scaleValue, scaleValue, scaleValue));
+        // meshGroupNode.setPosition(vec3(0, 20, 0));
 
         _chdir("../data/");
         Meshgroup::load_default_textures();
@@ -290,25 +374,32 @@ struct Exercise3
 
         _chdir("../data/sphere/");
         meshGroup.load_from_file("sphere.obj");
-        meshGroup.load_to_gpu();
-        meshGroup.get_shader_uniforms(mesh_shader_index);
+        meshGroup.load_to_gpu(Meshgroup::InterleavedQuantized);
+        meshGroup.get_shader_uniforms(mesh_shader);
+
+        sphereRenderer.init();
+        sphereRenderer.get_shader_uniforms(instanced_shader);
 
         assert(meshGroup.nodes.size() > 0);
         assert(meshGroup.meshes.size() > 0);
 
         meshGroupNode.addChild(meshGroup.nodes[0]);
+        if (!meshGroup.clips.empty())
+            meshAnimation.play(&meshGroup.clips[0]);
 
         vec3 gridColor(fmodf(ambientColor.v[0] + 0.5f, 1.f), fmodf(ambientColor.v[1] + 0.5f, 1.f),
                        fmodf(ambientColor.v[2] + 0.5f, 1.f));
         Shapes::addGrid(grid, vec3(-5, 0, -5), vec3(5, 0, 5), gridColor, 10);
         grid.load_to_gpu();
-        grid.get_shader_uniforms(lines_shader_index);
+        grid.get_shader_uniforms(lines_shader);
+        axis.get_shader_uniforms(lines_shader);
+        debugDraw.get_shader_uniforms(lines_shader);
 
         // camera
         cameraPosition = vec3(0, 1, 6);
 
         camNode.init();
-        camNode.position = cameraPosition;
+        camNode.setPosition(cameraPosition);
         sceneRoot.addChild(camNode);
 
         camera.near = 0.1f;
@@ -320,9 +411,19 @@ struct Exercise3
         camera.speed = 7.0f;
         camera.yaw_speed = 20.f;
         camera.pitch_speed = 10.f;
+        camera.load_to_gpu();
+        camera.get_shader_uniforms(mesh_shader);
+        camera.get_shader_uniforms(instanced_shader);
+        camera.get_shader_uniforms(lines_shader);
 
         sceneRoot.updateHierarchy();
 
+        for (int i = 0; i < NumSpheres; ++i)
+        {
+            sphereProxies[i] = sceneBVH.insert(transform_aabb(meshGroup.meshes[0].local_aabb, sphereNodes[i].worldMatrix()),
+                                               static_cast<uint32_t>(i));
+        }
+
         // tell GL to only draw onto a pixel if the shape is closer to the viewer
         glEnable(GL_DEPTH_TEST); // enable depth-testing
         glDepthFunc(GL_LESS);    // depth-testing interprets a smaller value as "closer"
@@ -345,11 +446,18 @@ struct Exercise3
         float elapsed_seconds = current_seconds - previous_seconds;
         previous_seconds = current_seconds;
 
-        _update_fps_counter(window);
+        Profiler &profiler = Profiler::main();
+        profiler.begin_frame();
+        updateWindowTitle(current_seconds);
+
         // wipe the drawing surface clear
+        int gpuClear = profiler.begin_gpu("clear");
         glClearColor(ambientColor.v[0], ambientColor.v[1], ambientColor.v[2], 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         glViewport(0, 0, g_gl_width, g_gl_height);
+        profiler.end_gpu(gpuClear);
+
+        int input = profiler.begin_cpu("input");
         glfwPollEvents();
 
         // ------------------------------------------------------------------------------------------ REVIEW
@@ -402,9 +510,9 @@ struct Exercise3
 
         //      auto Y = quat_from_axis_rad(yaw, wUp.x, wUp.y, wUp.z);
         //      auto P = quat_from_axis_rad(pitch, right.x, right.y, right.z);
-        //      camNode.rotation = P * Y;
+        //      camNode.setRotation(P * Y);
 
-        camNode.rotation = quat_from_axis_deg(camYaw, 0, 1, 0) * quat_from_axis_deg(camPitch, 1, 0, 0);
+        camNode.setRotation(quat_from_axis_deg(camYaw, 0, 1, 0) * quat_from_axis_deg(camPitch, 1, 0, 0));
 
         if (glfwGetKey(window, GLFW_KEY_W))
             cameraPosition += forward * elapsed_seconds * camera.speed;
@@ -419,7 +527,7 @@ struct Exercise3
         if (glfwGetKey(window, GLFW_KEY_LEFT_CONTROL))
             cameraPosition -= wUp * elapsed_seconds * camera.speed;
 
-        camNode.position = cameraPosition;
+        camNode.setPosition(cameraPosition);
 
         // ------------------------------------------------------------------------------------------
 
@@ -429,46 +537,153 @@ struct Exercise3
         mat4 cameraMatrix = translate(identity_mat4(), cameraPosition * -1.f);
         mat4 gridMatrix = translate(identity_mat4(), vec3(0, 0, 0));
 
-        meshGroupNode.rotation = quat_from_axis_deg(meshYaw += elapsed_seconds * 10, 0, 1, 0);
+        meshGroupNode.setRotation(quat_from_axis_deg(meshYaw += elapsed_seconds * 10, 0, 1, 0));
+        profiler.end_cpu(input);
 
+        int animation = profiler.begin_cpu("animation");
+        meshAnimation.advance(elapsed_seconds, meshGroup.nodes);
+        profiler.end_cpu(animation);
+
+        int hierarchy = profiler.begin_cpu("updateHierarchy");
         sceneRoot.updateHierarchy();
+        profiler.end_cpu(hierarchy);
 
-        glUseProgram(mesh_shader_index);
+        // view, projection and ambient for every program below, uploaded once
+        int uniforms = profiler.begin_cpu("uniform upload");
+        camera.set_shader_uniforms(camNode.worldInverseMatrix(), vec3(camNode.worldMatrix().getColumn(3)), ambientColor);
+        profiler.end_cpu(uniforms);
 
-        camera.get_shader_uniforms(mesh_shader_index);
-        camera.set_shader_uniforms(mesh_shader_index, camNode.worldInverseMatrix);
-        // camera.set_shader_uniforms(mesh_shader_index, cameraMatrix );
+        // spheres outside the view are never submitted
+        int bounds = profiler.begin_cpu("bounds");
+        const Meshgroup::Mesh &sphereMesh = meshGroup.meshes[0];
+        sphereBounds.clear();
+        for (int i = 0; i < NumSpheres; ++i)
+        {
+            const mat4 &world = sphereNodes[i].worldMatrix();
+            AABB box = transform_aabb(sphereMesh.local_aabb, world);
+            sphereBounds.add(box, transform_sphere(sphereMesh.local_sphere, world));
+            if (sphereNodes[i].worldChanged())
+                sceneBVH.update(sphereProxies[i], box);
+        }
+        profiler.end_cpu(bounds);
+        if (isInputEnabled)
+        {
+            ProfileZone zone("picking");
+            TriangleHit hoverHit;
+            hoveredSphereIndex = pickSphere(mouseRay(), &hoverHit);
+        }
 
-        meshGroup.set_shader_uniforms(mesh_shader_index, ambientColor);
+        int culling = profiler.begin_cpu("culling");
+        cullStats = cull(camera.frustum(camNode.worldInverseMatrix()), sphereBounds, sphereVisible.data());
+        profiler.end_cpu(culling);
 
-        for (int i = 0; i < NumSpheres; ++i)
+        int submission = profiler.begin_cpu("draw submission");
+        int gpuSpheres = profiler.begin_gpu("spheres");
+        if (useInstancing)
+        {
+            glUseProgram(instanced_shader.id);
+
+            sphereRenderer.set_shader_uniforms(instanced_shader);
+
+            // every sphere in one draw
+            sphereRenderer.begin();
+            for (int i = 0; i < NumSpheres; ++i)
+            {
+                if (!sphereVisible[i])
+                    continue;
+                sphereRenderer.add(meshGroup.meshes[0], sphereNodes[i].worldMatrix(),
+                                   sphereDisplayColor(i));
+            }
+            sphereRenderer.render(instanced_shader);
+        }
+        else
         {
-            meshGroup.meshes[0].render(mesh_shader_index, sphereNodes[i].worldMatrix,
-                                       i == selectedSphereIndex ? vec3(1, 1, 1) : sphereColor[i]);
+            glUseProgram(mesh_shader.id);
+
+            // one draw per sphere, sorted and with redundant state skipped
+            renderQueue.begin();
+            for (int i = 0; i < NumSpheres; ++i)
+            {
+                if (!sphereVisible[i])
+                    continue;
+                const mat4 &world = sphereNodes[i].worldMatrix();
+                float depth = length(vec3(world.getColumn(3)) - cameraPosition);
+                renderQueue.submit(mesh_shader, meshGroup.meshes[0], world,
+                                   sphereDisplayColor(i), depth);
+            }
+            renderQueue.flush();
         }
 
         glUseProgram(0);
+        profiler.end_gpu(gpuSpheres);
+        profiler.end_cpu(submission);
 
-        glUseProgram(lines_shader_index);
-
-        camera.get_shader_uniforms(lines_shader_index);
-        camera.set_shader_uniforms(lines_shader_index, camNode.worldInverseMatrix);
-        // camera.set_shader_uniforms(mesh_shader_index, cameraMatrix );
+        int lines = profiler.begin_cpu("lines");
+        int gpuLines = profiler.begin_gpu("lines");
+        glUseProgram(lines_shader.id);
 
-        grid.get_shader_uniforms(lines_shader_index);
-        grid.set_shader_uniforms(lines_shader_index, sceneRoot.worldMatrix);
+        grid.set_shader_uniforms(lines_shader, sceneRoot.worldMatrix());
         // grid.set_shader_uniforms(lines_shader_index, gridMatrix);
-        grid.render(lines_shader_index);
+        grid.render(lines_shader);
 
-        axis.get_shader_uniforms(lines_shader_index);
-        axis.set_shader_uniforms(lines_shader_index, sceneRoot.worldMatrix);
+        axis.set_shader_uniforms(lines_shader, sceneRoot.worldMatrix());
 
-        axis.render(lines_shader_index);
+        axis.render(lines_shader);
+
+        if (showDebug)
+        {
+            debugDraw.axes(TransformHierarchy::main(), 0.5f);
+            for (int i = 0; i < NumSpheres; ++i)
+                debugDraw.aabb(transform_aabb(sphereMesh.local_aabb, sphereNodes[i].worldMatrix()),
+                               sphereVisible[i] ? vec3(1, 1, 0) : vec3(0.4f, 0.4f, 0.4f));
+            for (size_t n = 0; n < sceneBVH.nodes.size(); ++n)
+            {
+                const DynamicBVH::TreeNode &treeNode = sceneBVH.nodes[n];
+                if (treeNode.height >= 0)
+                    debugDraw.aabb(treeNode.box, treeNode.leaf() ? vec3(0, 1, 1) : vec3(1, 0, 1));
+            }
+        }
+        // one draw for everything queued this frame
+        debugDraw.flush(lines_shader);
 
         glUseProgram(0);
+        profiler.end_gpu(gpuLines);
+        profiler.end_cpu(lines);
 
         // put the stuff we've been drawing onto the display
+        int swap = profiler.begin_cpu("swap");
         glfwSwapBuffers(window);
+        profiler.end_cpu(swap);
+
+        profiler.end_frame();
+    }
+
+    // Frame rate and where the time goes in the title, four times a second.
+    // Runs before this frame draws, so the counters are the last frame's
+    void updateWindowTitle(float current_seconds)
+    {
+        static float lastTitle = 0.f;
+        if (current_seconds - lastTitle < 0.25f)
+            return;
+        lastTitle = current_seconds;
+
+        const Profiler &profiler = Profiler::main();
+        const int frames = 30;
+        double frameMs = profiler.average_ms(frames);
+        char title[256];
+        int length = snprintf(title, sizeof(title),
+                 "opengl @ fps: %.2f  frame %.2f ms  hierarchy %.3f ms  submission %.3f ms  gpu %.3f ms",
+                 frameMs > 0.0 ? 1000.0 / frameMs : 0.0, frameMs, profiler.average_cpu_ms("updateHierarchy", frames),
+                 profiler.average_cpu_ms("draw submission", frames),
+                 profiler.average_gpu_ms("spheres", frames) + profiler.average_gpu_ms("lines", frames));
+        if (length > 0 && length < static_cast<int>(sizeof(title)))
+            length += snprintf(title + length, sizeof(title) - length, "  spheres %zu visible %zu culled",
+                               cullStats.visible, cullStats.culled);
+        // the instanced path draws in one call, only the queue has calls to count
+        if (!useInstancing && length > 0 && length < static_cast<int>(sizeof(title)))
+            snprintf(title + length, sizeof(title) - length, "  GL calls %zu issued %zu skipped",
+                     renderQueue.state.issued, renderQueue.state.skipped);
+        glfwSetWindowTitle(window, title);
     }
 
     bool isLoopGo()
@@ -478,6 +693,11 @@ struct Exercise3
 
     void terminate()
     {
+        meshGroup.unload_textures();
+        grid.unload_from_gpu();
+        axis.unload_from_gpu();
+        debugDraw.unload_from_gpu();
+        Profiler::main().unload_from_gpu();
         // close GL context and any other GLFW resources
         glfwTerminate();
     }
@@ -121,22 +121,6 @@ void glfw_framebuffer_size_callback( GLFWwindow *window, int width, int height )
 	/* update any perspective matrices used here */
 }
 
-void _update_fps_counter( GLFWwindow *window ) {
-	static double previous_seconds = glfwGetTime();
-	static int frame_count;
-	double current_seconds = glfwGetTime();
-	double elapsed_seconds = current_seconds - previous_seconds;
-	if ( elapsed_seconds > 0.25 ) {
-		previous_seconds = current_seconds;
-		double fps = (double)frame_count / elapsed_seconds;
-		char tmp[128];
-		sprintf( tmp, "opengl @ fps: %.2f", fps );
-		glfwSetWindowTitle( window, tmp );
-		frame_count = 0;
-	}
-	frame_count++;
-}
-
 /*-----------------------------------SHADERS----------------------------------*/
 bool parse_file_into_str( const char *file_name, char *shader_str, int max_len ) {
 	shader_str[0] = '\0'; // reset string
@@ -250,9 +234,17 @@ GLuint create_programme_from_files( const char *vert_file_name,
 
 /*----------------------------------TEXTURES----------------------------------*/
 bool load_image_data(const char *file_name, unsigned char** image_data, int& x, int& y, int& n)  {
+	prepare_image_decoding();
+	return decode_image_data(file_name, image_data, x, y, n);
+}
+
+void prepare_image_decoding() {
+	stbi_set_flip_vertically_on_load(true);
+}
+
+bool decode_image_data(const char *file_name, unsigned char** image_data, int& x, int& y, int& n)  {
 	//int x, y, n;
 	int force_channels = 4;
-	stbi_set_flip_vertically_on_load(true);
 	*image_data = stbi_load(file_name, &x, &y, &n, force_channels);
 	if (!*image_data) {
 		fprintf(stderr, "ERROR: could not load %s\n", file_name);
@@ -17,7 +17,6 @@ bool gl_log_err( const char *message, ... );
 bool startGlContext(GLFWwindow** window,int width, int height);
 void glfw_error_callback( int error, const char *description );
 void glfw_framebuffer_size_callback( GLFWwindow *window, int width, int height );
-void _update_fps_counter( GLFWwindow *window );
 /*-----------------------------------SHADERS----------------------------------*/
 bool parse_file_into_str( const char *file_name, char *shader_str, int max_len );
 void print_shader_info_log( GLuint shader_index );
@@ -30,6 +29,10 @@ GLuint create_programme_from_files( const char *vert_file_name,
 /*----------------------------------TEXTURES----------------------------------*/
 bool load_texture( const char *file_name, GLuint *tex );
 bool load_image_data(const char *file_name, unsigned char** image_data, int& x, int& y, int& n);
+// stb_image keeps the flip flag in a global: set it once with
+// prepare_image_decoding() and decode_image_data() is safe on any thread
+void prepare_image_decoding();
+bool decode_image_data(const char *file_name, unsigned char** image_data, int& x, int& y, int& n);
 void unload_image_data(unsigned char* image_data);
 void load_texture_to_gpu(unsigned char* image_data, GLuint* tex, int x, int y, int n);
 #endif
@@ -0,0 +1,34 @@
+#version 410
+
+// inputs: texture coordinates, and view and light directions in tangent space
+in vec2 st;
+in vec3 view_dir_tan;
+in vec3 light_dir_tan;
+
+// the normal map texture
+uniform sampler2D normal_map;
+uniform sampler2D diffuse_map;
+in vec3 diffuse_base_color; // per instance
+
+// per frame, see Camera::Block
+layout(std140) uniform CameraBlock {
+	mat4 view;
+	mat4 proj;
+	mat4 view_proj;
+	vec4 camera_position;
+	vec4 ambient_color;
+};
+
+// output colour
+out vec4 frag_colour;
+
+in vec4 test_tan;
+in float vertex_distance;
+
+void main() {
+	vec3 diffuse_texture_color = texture (diffuse_map, st).rgb;
+	vec3 diffuse_color = diffuse_base_color * diffuse_texture_color;
+
+	frag_colour.rgb = mix(diffuse_color , max(vertex_distance,0)*diffuse_color,0.5);
+	frag_colour.a = 1.0;
+}
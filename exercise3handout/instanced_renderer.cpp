@@ -0,0 +1,110 @@
+#include "instanced_renderer.h"
+
+#include <stddef.h>
+#include <string.h>
+
+void InstancedRenderer::init() {
+	glGenBuffers(1, &instances_vbo);
+	draw_count = 0;
+	instance_count = 0;
+}
+
+void InstancedRenderer::begin() {
+	for (size_t i = 0; i < batches.size(); ++i) {
+		batches[i].instances.clear();
+	}
+}
+
+void InstancedRenderer::add(Meshgroup::Mesh& mesh, const mat4& worldMatrix, const vec3& color) {
+	std::unordered_map<const Meshgroup::Mesh*, size_t>::iterator found = batch_lookup.find(&mesh);
+	size_t index;
+	if (found == batch_lookup.end()) {
+		index = batches.size();
+		batches.push_back(Batch());
+		batches.back().mesh = &mesh;
+		batch_lookup[&mesh] = index;
+	}
+	else {
+		index = found->second;
+	}
+
+	Instance instance;
+	memcpy(instance.model, worldMatrix.m, sizeof(instance.model));
+	memcpy(instance.color, color.v, sizeof(instance.color));
+	batches[index].instances.push_back(instance);
+}
+
+void InstancedRenderer::get_shader_uniforms(const ShaderProgram& shader_programme) {
+	normal_map_location = shader_programme.uniform_location( "normal_map" );
+	diffuse_map_location = shader_programme.uniform_location( "diffuse_map" );
+	position_offset_location = shader_programme.uniform_location( "position_offset" );
+	position_scale_location = shader_programme.uniform_location( "position_scale" );
+	octahedral_normals_location = shader_programme.uniform_location( "octahedral_normals" );
+}
+
+void InstancedRenderer::set_shader_uniforms(const ShaderProgram& shader_programme) {
+	shader_programme.set( normal_map_location, 0 );
+	shader_programme.set( diffuse_map_location, 1 );
+}
+
+void InstancedRenderer::render(const ShaderProgram& shader_programme) {
+	draw_count = 0;
+	instance_count = 0;
+
+	staging.clear();
+	for (size_t i = 0; i < batches.size(); ++i) {
+		staging.insert(staging.end(), batches[i].instances.begin(), batches[i].instances.end());
+	}
+	if (staging.empty()) {
+		return;
+	}
+
+	// a fresh store every frame so the driver never waits on last frame's draws
+	glBindBuffer(GL_ARRAY_BUFFER, instances_vbo);
+	glBufferData(GL_ARRAY_BUFFER, staging.size() * sizeof(Instance), &staging[0], GL_STREAM_DRAW);
+
+	size_t first = 0;
+	for (size_t i = 0; i < batches.size(); ++i) {
+		const Batch& batch = batches[i];
+		size_t count = batch.instances.size();
+		if (count == 0) {
+			continue;
+		}
+		const Meshgroup::Mesh& mesh = *batch.mesh;
+
+		shader_programme.set(position_offset_location, mesh.position_offset);
+		shader_programme.set(position_scale_location, mesh.position_scale);
+		shader_programme.set(octahedral_normals_location, mesh.octahedral_normals ? 1 : 0);
+
+		glActiveTexture( GL_TEXTURE0 );
+		glBindTexture( GL_TEXTURE_2D, mesh.nmap_tex);
+		glActiveTexture( GL_TEXTURE1 );
+		glBindTexture( GL_TEXTURE_2D, mesh.dmap_tex);
+
+		glBindVertexArray(mesh.vao);
+		// GL 4.1 has no base instance, so the attributes point at this batch
+		const GLsizei stride = sizeof(Instance);
+		size_t base = first * sizeof(Instance);
+		for (GLuint column = 0; column < 4; ++column) {
+			GLuint location = ModelLocation + column;
+			glEnableVertexAttribArray(location);
+			glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(base + offsetof(Instance, model) + column * 4 * sizeof(float)));
+			glVertexAttribDivisor(location, 1);
+		}
+		glEnableVertexAttribArray(ColorLocation);
+		glVertexAttribPointer(ColorLocation, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(base + offsetof(Instance, color)));
+		glVertexAttribDivisor(ColorLocation, 1);
+
+		glDrawElementsInstanced(GL_TRIANGLES, mesh.index_count, mesh.index_type, 0, (GLsizei)count);
+
+		// leave the shared VAO the way Mesh::render() set it up
+		for (GLuint location = ModelLocation; location <= ColorLocation; ++location) {
+			glDisableVertexAttribArray(location);
+		}
+		glBindVertexArray(0);
+
+		first += count;
+		++draw_count;
+		instance_count += count;
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include <GL/Glew.h>
+#include "maths_funcs.h"
+#include "mesh.h"
+#include "shader_program.h"
+
+// Collects (mesh, world matrix, colour) every frame and draws each mesh once
+// with glDrawElementsInstanced. Instances are streamed into one buffer per
+// frame and fed to instanced_vs.glsl as per-instance attributes: the model
+// matrix in locations 5-8 and the colour in 9, next to the mesh's own 0-4.
+struct InstancedRenderer {
+
+	struct Instance {
+		float model[16];
+		float color[3];
+	};
+
+	static const GLuint ModelLocation = 5;
+	static const GLuint ColorLocation = 9;
+
+	GLuint instances_vbo;
+
+	// draw calls and instances of the last render()
+	size_t draw_count;
+	size_t instance_count;
+
+	void init();
+
+	// forget the last frame's instances, the batches keep their memory
+	void begin();
+	void add(Meshgroup::Mesh& mesh, const mat4& worldMatrix, const vec3& color);
+
+	void get_shader_uniforms(const ShaderProgram& shader_programme);
+	void set_shader_uniforms(const ShaderProgram& shader_programme);
+	void render(const ShaderProgram& shader_programme);
+
+private:
+	struct Batch {
+		Meshgroup::Mesh* mesh;
+		std::vector<Instance> instances;
+	};
+	std::vector<Batch> batches;
+	std::unordered_map<const Meshgroup::Mesh*, size_t> batch_lookup;
+	// every batch back to back, uploaded in one go
+	std::vector<Instance> staging;
+
+	int normal_map_location;
+	int diffuse_map_location;
+	int position_offset_location;
+	int position_scale_location;
+	int octahedral_normals_location;
+};
@@ -0,0 +1,54 @@
+#version 410
+
+layout(location = 0) in vec3 vertex_position;
+layout(location = 1) in vec3 vertex_normal;
+layout(location = 2) in vec2 uvs0;
+layout(location = 3) in vec2 uvs1;
+layout(location = 4) in vec4 vtangent;
+
+// per instance, see InstancedRenderer
+layout(location = 5) in mat4 instance_model;
+layout(location = 9) in vec3 instance_color;
+
+// per frame, see Camera::Block
+layout(std140) uniform CameraBlock {
+	mat4 view;
+	mat4 proj;
+	mat4 view_proj;
+	vec4 camera_position;
+	vec4 ambient_color;
+};
+
+// vertex decode, as in test_vs.glsl
+uniform vec3 position_offset;
+uniform vec3 position_scale;
+uniform bool octahedral_normals;
+
+out vec4 test_tan;
+
+out vec2 st;
+out vec3 view_dir_tan;
+out vec3 light_dir_tan;
+out float vertex_distance;
+out vec3 diffuse_base_color;
+
+vec3 oct_decode(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+void main() {
+	vec3 position = position_offset + vertex_position * position_scale;
+	vec3 normal = octahedral_normals ? oct_decode(vertex_normal.xy) : vertex_normal;
+	vec4 tangent = vec4(vtangent.xyz, sign(vtangent.w));
+
+	gl_Position = view_proj * instance_model * vec4 (position, 1.0);
+	mat3 modelRot = mat3(instance_model);
+	vertex_distance = (modelRot*position).z;
+	st = uvs0;
+	test_tan = vec4(cross(normal, tangent.xyz) * tangent.w, 0.0);
+	diffuse_base_color = instance_color;
+}
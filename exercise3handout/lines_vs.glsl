@@ -3,11 +3,20 @@
 layout(location = 0) in vec3 vertex_position;
 layout(location = 1) in vec3 vertex_color;
 
-uniform mat4 model, view, proj;
+uniform mat4 model;
+
+// per frame, see Camera::Block
+layout(std140) uniform CameraBlock {
+	mat4 view;
+	mat4 proj;
+	mat4 view_proj;
+	vec4 camera_position;
+	vec4 ambient_color;
+};
 
 out vec3 lerp_color;
 
 void main() {
-	gl_Position =  proj * view * model * vec4 (vertex_position, 1.0);
+	gl_Position = view_proj * model * vec4 (vertex_position, 1.0);
 	lerp_color = vertex_color;
 }
@@ -1,5 +1,10 @@
 #include "lineshapes.h"
 
+#include <stddef.h>
+#include <string.h>
+#include "gl_utils.h"
+#include "shape_geometry.h"
+
 void Lines::add(GLfloat *vertex_data, GLfloat *color_data, size_t vertexCount, GLuint *indices_data, size_t indexCount)
 {
     size_t point_size = points.size();
@@ -34,123 +39,184 @@ void Lines::clear()
     indices.clear();
 }
 
+namespace
+{
+    struct LineVertex
+    {
+        vec3 point;
+        vec3 color;
+    };
+
+    size_t grown_capacity(size_t capacity, size_t needed)
+    {
+        size_t grown = capacity ? capacity : 256;
+        while (grown < needed)
+            grown *= 2;
+        return grown;
+    }
+}
+
+void Lines::reserve(size_t vertex_count, size_t index_count)
+{
+    if (vertex_count <= vertex_capacity && index_count <= index_capacity)
+        return;
+
+    vertex_capacity = grown_capacity(vertex_capacity, vertex_count);
+    index_capacity = grown_capacity(index_capacity, index_count);
+
+    // glBufferData hands the old storage back to the driver, which frees it once
+    // pending draws are done with it, so the fences on it are moot
+    for (int r = 0; r < RingSize; ++r)
+    {
+        if (fences[r])
+        {
+            glDeleteSync(fences[r]);
+            fences[r] = 0;
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, vertices_vbo);
+    glBufferData(GL_ARRAY_BUFFER, RingSize * vertex_capacity * sizeof(LineVertex), NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_vbo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, RingSize * index_capacity * sizeof(GLuint), NULL, GL_STREAM_DRAW);
+}
+
 void Lines::load_to_gpu()
 {
     size_t vertex_count = points.size();
     size_t index_count = indices.size();
 
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
+    if (!vao)
+    {
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vertices_vbo);
+        glGenBuffers(1, &index_vbo);
 
-    size_t attribIx = 0;
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vertices_vbo);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (GLvoid *)offsetof(LineVertex, point));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (GLvoid *)offsetof(LineVertex, color));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_vbo);
+    }
+    else
+    {
+        glBindVertexArray(vao);
+    }
 
-    if (vertex_count)
+    uploaded_index_count = index_count;
+    if (!vertex_count || !index_count)
     {
-        glGenBuffers(1, &points_vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, points_vbo);
-        glBufferData(GL_ARRAY_BUFFER, 3 * vertex_count * sizeof(GLfloat), &points[0].v[0], GL_STATIC_DRAW);
-        glEnableVertexAttribArray(attribIx);
-        glVertexAttribPointer(attribIx, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+        glBindVertexArray(0);
+        return;
     }
-    ++attribIx;
 
-    if (vertex_count)
+    reserve(vertex_count, index_count);
+    region = (region + 1) % RingSize;
+
+    // the GPU read this region RingSize uploads ago, usually long done
+    if (fences[region])
     {
-        glGenBuffers(1, &colors_vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, colors_vbo);
-        glBufferData(GL_ARRAY_BUFFER, 3 * vertex_count * sizeof(GLfloat), &colors[0].v[0], GL_STATIC_DRAW);
-        glEnableVertexAttribArray(attribIx);
-        glVertexAttribPointer(attribIx, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+        glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1000000000));
+        glDeleteSync(fences[region]);
+        fences[region] = 0;
     }
 
-    ++attribIx;
+    const GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
 
-    if (index_count)
+    glBindBuffer(GL_ARRAY_BUFFER, vertices_vbo);
+    LineVertex *vertices = (LineVertex *)glMapBufferRange(
+        GL_ARRAY_BUFFER, region * vertex_capacity * sizeof(LineVertex), vertex_count * sizeof(LineVertex), access);
+    if (vertices)
     {
-        glGenBuffers(1, &index_vbo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_vbo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * index_count, &indices[0], GL_STATIC_DRAW);
+        for (size_t i = 0; i < vertex_count; ++i)
+        {
+            vertices[i].point = points[i];
+            vertices[i].color = colors[i];
+        }
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+
+    GLuint *mapped_indices = (GLuint *)glMapBufferRange(
+        GL_ELEMENT_ARRAY_BUFFER, region * index_capacity * sizeof(GLuint), index_count * sizeof(GLuint), access);
+    if (mapped_indices)
+    {
+        memcpy(mapped_indices, &indices[0], index_count * sizeof(GLuint));
+        glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+    }
+
+    if (!vertices || !mapped_indices)
+    {
+        gl_log_err("ERROR: could not map the line buffers\n");
+        uploaded_index_count = 0;
     }
     glBindVertexArray(0);
 }
 
-void Lines::get_shader_uniforms(GLuint shader_programme)
+void Lines::unload_from_gpu()
 {
-    model_matrix_location = glGetUniformLocation(shader_programme, "model");
+    for (int r = 0; r < RingSize; ++r)
+    {
+        if (fences[r])
+            glDeleteSync(fences[r]);
+        fences[r] = 0;
+    }
+    if (vao)
+    {
+        glDeleteBuffers(1, &vertices_vbo);
+        glDeleteBuffers(1, &index_vbo);
+        glDeleteVertexArrays(1, &vao);
+    }
+    vao = vertices_vbo = index_vbo = 0;
+    vertex_capacity = index_capacity = 0;
+    uploaded_index_count = 0;
 }
 
-void Lines::set_shader_uniforms(GLuint shader_programme, const mat4 &worldMatrix)
+void Lines::get_shader_uniforms(const ShaderProgram &shader_programme)
 {
-    glUniformMatrix4fv(model_matrix_location, 1, GL_FALSE, worldMatrix.m);
+    model_matrix_location = shader_programme.uniform_location("model");
 }
 
-void Lines::render(GLuint shader_programme)
+void Lines::set_shader_uniforms(const ShaderProgram &shader_programme, const mat4 &worldMatrix)
 {
-    size_t index_count = indices.size();
+    shader_programme.set(model_matrix_location, worldMatrix);
+}
+
+void Lines::render(const ShaderProgram &shader_programme)
+{
+    if (!vao || !uploaded_index_count)
+        return;
+
+    // the region is picked by offsetting the indices and the vertices they index
     glBindVertexArray(vao);
-    glDrawElements(GL_LINES, index_count, GL_UNSIGNED_INT, 0);
+    glDrawElementsBaseVertex(GL_LINES, (GLsizei)uploaded_index_count, GL_UNSIGNED_INT,
+                             (GLvoid *)(region * index_capacity * sizeof(GLuint)), (GLint)(region * vertex_capacity));
     glBindVertexArray(0);
+
+    if (fences[region])
+        glDeleteSync(fences[region]);
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 }
 
 // ---------------------------------------------------------------------------
-// Copied form exercise1
 
 void Shapes::addArrow(Lines &lines, const vec3 &from, const vec3 &to, const vec3 &color)
 {
-    // Vector with random deep decimals so using cross(one, axis) always yields a valid
-    // result for every arbitrary arrow we'd like to draw
-    vec3 one(0.5054846f, 0.5068565f, 0.5046546f);
-
-    const int iterations = 25;    // number of additional edges
-    const float sharpness = 0.1f; // edges sharpness: 0 = sharpest, 1 = flattest
-    const float length = 0.15f;   // edges length
-
-    // Total number of vertices
-    const unsigned int vertex_count = iterations + 2;
-
-    // Vertex storage
-    vec3 arrow_vertices[vertex_count];
-    arrow_vertices[0] = from;
-    arrow_vertices[1] = to;
+    // Vertex storage, see shape_geometry.h
+    vec3 vertices[ArrowVertexCount];
+    arrow_vertices(from, to, vertices);
 
     // Color of the lines drawn
-    // Has to be of length 'vertex_count'
-    vec3 arrow_colors[vertex_count];
-    for (unsigned int i = 0; i < vertex_count; i++)
-        arrow_colors[i] = color;
-
-    // Rotation axis and inverse
-    auto axis_dir = to - from;
-    auto axis_inv = from - to;
-
-    // Point to rotate and angle of rotation
-    auto point = normalise(normalise(cross(one, axis_dir)) * sharpness + normalise(axis_inv) * 0.5f) * length;
-    auto alpha = 360.f / iterations;
-
-    // Rotate the point and save it's positions
-    for (unsigned int i = 0; i < iterations; i++)
-    {
-        // b = Ax
-        auto x = vec4(point, 1);
-        auto A = quat_to_mat4(quat_from_axis_deg(alpha * i, axis_dir.x, axis_dir.y, axis_dir.z)) * x;
-        auto b = vec3(A.x, A.y, A.z) + to;
-        arrow_vertices[i + 2] = b;
-    }
+    // Has to be of length 'ArrowVertexCount'
+    vec3 colors[ArrowVertexCount];
+    for (unsigned int i = 0; i < ArrowVertexCount; i++)
+        colors[i] = color;
 
     // This thing draw pairs of vertices
-    const unsigned int index_count = iterations * 2 + 2;
-    unsigned int arrow_indices[index_count];
-    arrow_indices[0] = 0; // from
-    arrow_indices[1] = 1; // to
-
-    // Make pairs of vertices to draw
-    for (unsigned int i = 0; i < iterations; i++)
-    {
-        arrow_indices[i * 2 + 2] = 1;     // to
-        arrow_indices[i * 2 + 3] = i + 2; // point
-    }
+    unsigned int indices[ArrowIndexCount];
+    arrow_indices(indices);
 
-    lines.add(&arrow_vertices[0].v[0], &arrow_colors[0].v[0], vertex_count, &arrow_indices[0], index_count);
+    lines.add(&vertices[0].v[0], &colors[0].v[0], ArrowVertexCount, &indices[0], ArrowIndexCount);
 }
 
 // ---------------------------------------------------------------------------
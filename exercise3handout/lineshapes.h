@@ -4,17 +4,33 @@
 #include <GL/Glew.h>
 #include "maths_funcs.h"
 #include "node.h"
-
+#include "shader_program.h"
+
+// Debug lines, rebuilt on the CPU with add()/clear() and streamed to the GPU
+// by load_to_gpu(). The GL objects are made once and reused: the vertex and
+// index buffers are split in RingSize regions, every upload writes the next
+// region through an unsynchronized map, and a fence per region keeps the CPU
+// off a region the GPU may still be drawing from. The buffers only grow,
+// orphaning the old storage, when the lines outgrow a region.
 struct Lines  {
 
+	static const int RingSize = 3;
+
 	std::vector<vec3> points;
 	std::vector<vec3> colors;
 	std::vector<unsigned int> indices;
 
-	GLuint vao;
-	GLuint points_vbo;
-	GLuint colors_vbo;
-	GLuint index_vbo;
+	GLuint vao = 0;
+	GLuint vertices_vbo = 0; // interleaved position and color
+	GLuint index_vbo = 0;
+
+	// per region, in vertices and indices
+	size_t vertex_capacity = 0;
+	size_t index_capacity = 0;
+	// region the last load_to_gpu() wrote, and what it holds
+	int region = RingSize - 1;
+	size_t uploaded_index_count = 0;
+	GLsync fences[RingSize] = {};
 
 	int model_matrix_location;
 	
@@ -22,9 +38,13 @@ struct Lines  {
 	void clear();
 
 	void load_to_gpu();
-	void get_shader_uniforms(GLuint shader_programme);
-	void set_shader_uniforms(GLuint shader_programme, const mat4& worldMatrix);
-	void render(GLuint shader_programme);
+	void unload_from_gpu();
+	void get_shader_uniforms(const ShaderProgram& shader_programme);
+	void set_shader_uniforms(const ShaderProgram& shader_programme, const mat4& worldMatrix);
+	void render(const ShaderProgram& shader_programme);
+
+private:
+	void reserve(size_t vertex_count, size_t index_count);
 };
 
 
@@ -1,139 +1,13 @@
 #include "maths_funcs.h"
 #include <stdio.h>
 
-/*--------------------------------CONSTRUCTORS--------------------------------*/
-vec2::vec2() {}
-
-vec2::vec2( float x, float y ) {
-	v[0] = x;
-	v[1] = y;
-}
-
-vec3::vec3() {}
-
-vec3::vec3( float x, float y, float z ) {
-	v[0] = x;
-	v[1] = y;
-	v[2] = z;
-}
-
-vec3::vec3( const vec2 &vv, float z ) {
-	v[0] = vv.v[0];
-	v[1] = vv.v[1];
-	v[2] = z;
-}
-
-vec3::vec3( const vec4 &vv ) {
-	v[0] = vv.v[0];
-	v[1] = vv.v[1];
-	v[2] = vv.v[2];
-}
-
-vec4::vec4() {}
-
-vec4::vec4( float x, float y, float z, float w ) {
-	v[0] = x;
-	v[1] = y;
-	v[2] = z;
-	v[3] = w;
-}
-
-vec4::vec4( const vec2 &vv, float z, float w ) {
-	v[0] = vv.v[0];
-	v[1] = vv.v[1];
-	v[2] = z;
-	v[3] = w;
-}
-
-vec4::vec4( const vec3 &vv, float w ) {
-	v[0] = vv.v[0];
-	v[1] = vv.v[1];
-	v[2] = vv.v[2];
-	v[3] = w;
-}
-
-mat3::mat3() {}
-
-/* note: entered in COLUMNS */
-mat3::mat3( float a, float b, float c, float d, float e, float f, float g, float h, float i ) {
-	m[0] = a;
-	m[1] = b;
-	m[2] = c;
-	m[3] = d;
-	m[4] = e;
-	m[5] = f;
-	m[6] = g;
-	m[7] = h;
-	m[8] = i;
-}
-
-mat4::mat4() {}
-
-/* note: entered in COLUMNS */
-mat4::mat4( float a, float b, float c, float d, float e, float f, float g, float h, float i, float j, float k, float l, float mm, float n, float o, float p ) {
-	m[0] = a;
-	m[1] = b;
-	m[2] = c;
-	m[3] = d;
-
-	m[4] = e;
-	m[5] = f;
-	m[6] = g;
-	m[7] = h;
-
-	m[8] = i;
-	m[9] = j;
-	m[10] = k;
-	m[11] = l;
-
-	m[12] = mm;
-	m[13] = n;
-	m[14] = o;
-	m[15] = p;
-}
-mat3 mat4::getRotation() const{
-	mat3 ret;
-	ret.m[0] = m[0];
-	ret.m[1] = m[1];
-	ret.m[2] = m[2];
-
-	ret.m[3] = m[4];
-	ret.m[4] = m[5];
-	ret.m[5] = m[6];
-
-	ret.m[6] = m[8];
-	ret.m[7] = m[9];
-	ret.m[8] = m[10];
-
-	return ret;
-}
-
-vec4 mat4::getColumn(int i) const {
-	vec4 ret =col[i];
-	return ret;
-}
-
-vec4 mat4::getRow(int i) const {
-	vec4 ret;
-	ret.v[0] = m[i+0];
-	ret.v[1] = m[i+4];
-	ret.v[2] = m[i+8];
-	ret.v[3] = m[i+12];
-	return ret;
-}
-
-void mat4::setRow(int i, const vec4& v ) {
-	vec4 ret;
-	m[0+i]= v[0];
-	m[4+i]= v[1];
-	m[8+i]= v[2];
-	m[12+i]= v[3];
-}
-
-void mat4::setColumn(int i, const vec4& v) {
-	col[i] = v;
-}
+// the header functions have to stay usable in constant expressions
+static_assert( identity_mat4().m[15] == 1.0f, "identity_mat4 is not constexpr" );
+static_assert( dot( cross( vec3( 1.0f, 0.0f, 0.0f ), vec3( 0.0f, 1.0f, 0.0f ) ), vec3( 0.0f, 0.0f, 1.0f ) ) == 1.0f,
+			   "vec3 functions are not constexpr" );
+static_assert( quat_to_mat4( versor( 0.0f, 0.0f, 0.0f, 1.0f ) ).m[0] == 1.0f, "quat_to_mat4 is not constexpr" );
 
+/*------------------------------DECOMPOSITION---------------------------------*/
 //void mat3::QDUdecomposition(mat3& kQ, vec3& kD, vec3& kU) const 
 //{
 //	// Factor M = QR = QDU where Q is orthogonal, D is diagonal,
@@ -306,126 +180,6 @@ void print( const mat4 &m ) {
 }
 
 /*------------------------------VECTOR FUNCTIONS------------------------------*/
-float length( const vec3 &v ) {
-	return sqrtf( v.v[0] * v.v[0] + v.v[1] * v.v[1] + v.v[2] * v.v[2] );
-}
-
-// squared length
-float length2( const vec3 &v ) {
-	return v.v[0] * v.v[0] + v.v[1] * v.v[1] + v.v[2] * v.v[2];
-}
-
-// note: proper spelling (hehe)
-vec3 normalise( const vec3 &v ) {
-	vec3 vb;
-	float l = length( v );
-	if ( 0.0f == l ) {
-		return vec3( 0.0f, 0.0f, 0.0f );
-	}
-	vb.v[0] = v.v[0] / l;
-	vb.v[1] = v.v[1] / l;
-	vb.v[2] = v.v[2] / l;
-	return vb;
-}
-
-vec3 vec3::operator+( const vec3 &rhs ) const {
-	vec3 vc;
-	vc.v[0] = v[0] + rhs.v[0];
-	vc.v[1] = v[1] + rhs.v[1];
-	vc.v[2] = v[2] + rhs.v[2];
-	return vc;
-}
-
-vec3 &vec3::operator+=( const vec3 &rhs ) {
-	v[0] += rhs.v[0];
-	v[1] += rhs.v[1];
-	v[2] += rhs.v[2];
-	return *this; // return self
-}
-
-vec3 vec3::operator-( const vec3 &rhs ) const {
-	vec3 vc;
-	vc.v[0] = v[0] - rhs.v[0];
-	vc.v[1] = v[1] - rhs.v[1];
-	vc.v[2] = v[2] - rhs.v[2];
-	return vc;
-}
-
-vec3 &vec3::operator-=( const vec3 &rhs ) {
-	v[0] -= rhs.v[0];
-	v[1] -= rhs.v[1];
-	v[2] -= rhs.v[2];
-	return *this;
-}
-
-vec3 vec3::operator+( float rhs ) const {
-	vec3 vc;
-	vc.v[0] = v[0] + rhs;
-	vc.v[1] = v[1] + rhs;
-	vc.v[2] = v[2] + rhs;
-	return vc;
-}
-
-vec3 vec3::operator-( float rhs ) const {
-	vec3 vc;
-	vc.v[0] = v[0] - rhs;
-	vc.v[1] = v[1] - rhs;
-	vc.v[2] = v[2] - rhs;
-	return vc;
-}
-
-vec3 vec3::operator*( float rhs ) {
-	vec3 vc;
-	vc.v[0] = v[0] * rhs;
-	vc.v[1] = v[1] * rhs;
-	vc.v[2] = v[2] * rhs;
-	return vc;
-}
-
-vec3 vec3::operator/( float rhs ) {
-	vec3 vc;
-	vc.v[0] = v[0] / rhs;
-	vc.v[1] = v[1] / rhs;
-	vc.v[2] = v[2] / rhs;
-	return vc;
-}
-
-vec3 &vec3::operator*=( float rhs ) {
-	v[0] = v[0] * rhs;
-	v[1] = v[1] * rhs;
-	v[2] = v[2] * rhs;
-	return *this;
-}
-
-vec3 &vec3::operator=( const vec3 &rhs ) {
-	v[0] = rhs.v[0];
-	v[1] = rhs.v[1];
-	v[2] = rhs.v[2];
-	return *this;
-}
-
-float dot( const vec3 &a, const vec3 &b ) {
-	return a.v[0] * b.v[0] + a.v[1] * b.v[1] + a.v[2] * b.v[2];
-}
-
-vec3 cross( const vec3 &a, const vec3 &b ) {
-	float x = a.v[1] * b.v[2] - a.v[2] * b.v[1];
-	float y = a.v[2] * b.v[0] - a.v[0] * b.v[2];
-	float z = a.v[0] * b.v[1] - a.v[1] * b.v[0];
-	return vec3( x, y, z );
-}
-
-vec4 homogeneous(const vec4 &a) {
-	return vec4(a.v[0] / a.v[3], a.v[1] / a.v[3], a.v[2] / a.v[3], 1.f);
-}
-
-float get_squared_dist( vec3 from, vec3 to ) {
-	float x = ( to.v[0] - from.v[0] ) * ( to.v[0] - from.v[0] );
-	float y = ( to.v[1] - from.v[1] ) * ( to.v[1] - from.v[1] );
-	float z = ( to.v[2] - from.v[2] ) * ( to.v[2] - from.v[2] );
-	return x + y + z;
-}
-
 /* converts an un-normalised direction into a heading in degrees
 NB i suspect that the z is backwards here but i've used in in
 several places like this. d'oh! */
@@ -439,105 +193,6 @@ vec3 heading_to_direction( float degrees ) {
 }
 
 /*-----------------------------MATRIX FUNCTIONS-------------------------------*/
-mat3 zero_mat3() {
-	return mat3( 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f );
-}
-
-mat3 identity_mat3() {
-	return mat3( 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f );
-}
-
-mat4 zero_mat4() {
-	return mat4( 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
-							 0.0f, 0.0f, 0.0f, 0.0f, 0.0f );
-}
-
-mat4 identity_mat4() {
-	return mat4( 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f,
-							 0.0f, 0.0f, 0.0f, 0.0f, 1.0f );
-}
-
-/* mat4 array layout
- 0  4  8 12
- 1  5  9 13
- 2  6 10 14
- 3  7 11 15
-*/
-
-vec4 mat4::operator*( const vec4 &rhs ) {
-	// 0x + 4y + 8z + 12w
-	float x = m[0] * rhs.v[0] + m[4] * rhs.v[1] + m[8] * rhs.v[2] + m[12] * rhs.v[3];
-	// 1x + 5y + 9z + 13w
-	float y = m[1] * rhs.v[0] + m[5] * rhs.v[1] + m[9] * rhs.v[2] + m[13] * rhs.v[3];
-	// 2x + 6y + 10z + 14w
-	float z = m[2] * rhs.v[0] + m[6] * rhs.v[1] + m[10] * rhs.v[2] + m[14] * rhs.v[3];
-	// 3x + 7y + 11z + 15w
-	float w = m[3] * rhs.v[0] + m[7] * rhs.v[1] + m[11] * rhs.v[2] + m[15] * rhs.v[3];
-	return vec4( x, y, z, w );
-}
-
-vec4 vec4::operator*( float rhs ) {
-	vec4 vc;
-	vc.v[0] = v[0] * rhs;
-	vc.v[1] = v[1] * rhs;
-	vc.v[2] = v[2] * rhs;
-	vc.v[3] = v[3] * rhs;
-	return vc;
-}
-
-mat4 mat4::operator*( const mat4 &rhs ) {
-	mat4 r = zero_mat4();
-	int r_index = 0;
-	for ( int col = 0; col < 4; col++ ) {
-		for ( int row = 0; row < 4; row++ ) {
-			float sum = 0.0f;
-			for ( int i = 0; i < 4; i++ ) {
-				sum += rhs.m[i + col * 4] * m[row + i * 4];
-			}
-			r.m[r_index] = sum;
-			r_index++;
-		}
-	}
-	return r;
-}
-
-mat4 &mat4::operator=( const mat4 &rhs ) {
-	for ( int i = 0; i < 16; i++ ) {
-		m[i] = rhs.m[i];
-	}
-	return *this;
-}
-
-// returns a scalar value with the determinant for a 4x4 matrix
-// see
-// http://www.euclideanspace.com/maths/algebra/matrix/functions/determinant/fourD/index.htm
-float determinant( const mat4 &mm ) {
-	return mm.m[12] * mm.m[9] * mm.m[6] * mm.m[3] -
-				 mm.m[8] * mm.m[13] * mm.m[6] * mm.m[3] -
-				 mm.m[12] * mm.m[5] * mm.m[10] * mm.m[3] +
-				 mm.m[4] * mm.m[13] * mm.m[10] * mm.m[3] +
-				 mm.m[8] * mm.m[5] * mm.m[14] * mm.m[3] -
-				 mm.m[4] * mm.m[9] * mm.m[14] * mm.m[3] -
-				 mm.m[12] * mm.m[9] * mm.m[2] * mm.m[7] +
-				 mm.m[8] * mm.m[13] * mm.m[2] * mm.m[7] +
-				 mm.m[12] * mm.m[1] * mm.m[10] * mm.m[7] -
-				 mm.m[0] * mm.m[13] * mm.m[10] * mm.m[7] -
-				 mm.m[8] * mm.m[1] * mm.m[14] * mm.m[7] +
-				 mm.m[0] * mm.m[9] * mm.m[14] * mm.m[7] +
-				 mm.m[12] * mm.m[5] * mm.m[2] * mm.m[11] -
-				 mm.m[4] * mm.m[13] * mm.m[2] * mm.m[11] -
-				 mm.m[12] * mm.m[1] * mm.m[6] * mm.m[11] +
-				 mm.m[0] * mm.m[13] * mm.m[6] * mm.m[11] +
-				 mm.m[4] * mm.m[1] * mm.m[14] * mm.m[11] -
-				 mm.m[0] * mm.m[5] * mm.m[14] * mm.m[11] -
-				 mm.m[8] * mm.m[5] * mm.m[2] * mm.m[15] +
-				 mm.m[4] * mm.m[9] * mm.m[2] * mm.m[15] +
-				 mm.m[8] * mm.m[1] * mm.m[6] * mm.m[15] -
-				 mm.m[0] * mm.m[9] * mm.m[6] * mm.m[15] -
-				 mm.m[4] * mm.m[1] * mm.m[10] * mm.m[15] +
-				 mm.m[0] * mm.m[5] * mm.m[10] * mm.m[15];
-}
-
 /* returns a 16-element array that is the inverse of a 16-element array (4x4
 matrix). see
 http://www.euclideanspace.com/maths/algebra/matrix/functions/inverse/fourD/index.htm
@@ -603,31 +258,67 @@ mat4 inverse( const mat4 &mm ) {
 								mm.m[4] * mm.m[1] * mm.m[10] + mm.m[0] * mm.m[5] * mm.m[10] ) );
 }
 
-// returns a 16-element array flipped on the main diagonal
-mat4 transpose( const mat4 &mm ) {
-	return mat4( mm.m[0], mm.m[4], mm.m[8], mm.m[12], mm.m[1], mm.m[5], mm.m[9],
-							 mm.m[13], mm.m[2], mm.m[6], mm.m[10], mm.m[14], mm.m[3], mm.m[7],
-							 mm.m[11], mm.m[15] );
+/* inverse of [A t; 0 1] is [inv(A) -inv(A)t; 0 1]. the rows of inv(A) are the
+cross products of the columns of A divided by det(A), about a quarter of the
+work of the general cofactor inverse */
+mat4 inverse_affine( const mat4 &mm ) {
+	vec3 c0( mm.m[0], mm.m[1], mm.m[2] );
+	vec3 c1( mm.m[4], mm.m[5], mm.m[6] );
+	vec3 c2( mm.m[8], mm.m[9], mm.m[10] );
+	vec3 t( mm.m[12], mm.m[13], mm.m[14] );
+
+	vec3 r0 = cross( c1, c2 );
+	vec3 r1 = cross( c2, c0 );
+	vec3 r2 = cross( c0, c1 );
+	float det = dot( c0, r0 );
+	if ( 0.0f == det ) {
+		fprintf( stderr, "WARNING. matrix has no determinant. can not invert\n" );
+		return mm;
+	}
+	float inv_det = 1.0f / det;
+	r0 *= inv_det;
+	r1 *= inv_det;
+	r2 *= inv_det;
+
+	return mat4( r0.v[0], r1.v[0], r2.v[0], 0.0f,
+							 r0.v[1], r1.v[1], r2.v[1], 0.0f,
+							 r0.v[2], r1.v[2], r2.v[2], 0.0f,
+							 -dot( r0, t ), -dot( r1, t ), -dot( r2, t ), 1.0f );
 }
 
-mat3 transpose( const mat3 &mm ) {
-	return mat3( 
-		mm.m[0], mm.m[3], mm.m[6], 
-		mm.m[1], mm.m[4], mm.m[7], 
-		mm.m[2], mm.m[5], mm.m[8] );
+// rotation + translation only: the inverse rotation is the transpose
+mat4 inverse_rigid( const mat4 &mm ) {
+	vec3 c0( mm.m[0], mm.m[1], mm.m[2] );
+	vec3 c1( mm.m[4], mm.m[5], mm.m[6] );
+	vec3 c2( mm.m[8], mm.m[9], mm.m[10] );
+	vec3 t( mm.m[12], mm.m[13], mm.m[14] );
+
+	return mat4( mm.m[0], mm.m[4], mm.m[8], 0.0f,
+							 mm.m[1], mm.m[5], mm.m[9], 0.0f,
+							 mm.m[2], mm.m[6], mm.m[10], 0.0f,
+							 -dot( c0, t ), -dot( c1, t ), -dot( c2, t ), 1.0f );
 }
 
-/*--------------------------AFFINE MATRIX FUNCTIONS---------------------------*/
-// translate a 4d matrix with xyz array
-mat4 translate( const mat4 &m, const vec3 &v ) {
-	mat4 ret = identity_mat4();
-	ret.col[3].x = v.x;
-	ret.col[3].y = v.y;
-	ret.col[3].z = v.z;
-	
-	return ret* m;
+/*-------------------------------BATCH FUNCTIONS------------------------------*/
+void mul_mat4_array( const mat4 *a, const mat4 *b, mat4 *out, size_t n ) {
+	for ( size_t i = 0; i < n; i++ ) {
+		mul_mat4_kernel( a[i].m, b[i].m, out[i].m );
+	}
 }
 
+void transform_points( const mat4 &m, const vec3 *in, vec3 *out, size_t n ) {
+	for ( size_t i = 0; i < n; i++ ) {
+		// vec3 is 12 bytes, go through a temporary so the kernel never
+		// writes past the end of out
+		float r[4];
+		mul_vec4_kernel( m.m, in[i].v[0], in[i].v[1], in[i].v[2], 1.0f, r );
+		out[i].v[0] = r[0];
+		out[i].v[1] = r[1];
+		out[i].v[2] = r[2];
+	}
+}
+
+/*--------------------------AFFINE MATRIX FUNCTIONS---------------------------*/
 // rotate around x axis by an angle in degrees
 mat4 rotate_x_deg( const mat4 &m, float deg ) {
 	// convert to radians
@@ -664,15 +355,6 @@ mat4 rotate_z_deg( const mat4 &m, float deg ) {
 	return m_r * m;
 }
 
-// scale a matrix by [x, y, z]
-mat4 scaler( const mat4 &m, const vec3 &v ) {
-	mat4 a = identity_mat4();
-	a.m[0] = v.v[0];
-	a.m[5] = v.v[1];
-	a.m[10] = v.v[2];
-	return a * m;
-}
-
 /*-----------------------VIRTUAL CAMERA MATRIX FUNCTIONS----------------------*/
 // returns a view matrix using the opengl lookAt style. COLUMN ORDER.
 mat4 look_at( const vec3 &cam_pos, vec3 targ_pos, const vec3 &up ) {
@@ -718,13 +400,23 @@ mat4 perspective( float fovy, float aspect, float near, float far ) {
 	return m;
 }
 
-/*----------------------------HAMILTON IN DA HOUSE!---------------------------*/
-versor::versor() {}
-
-versor::versor(float x, float y, float z, float w)
-	:q{w,x,y,z}
-{ ; }
+/* perspective() only fills m[0], m[5], m[10], m[14] and m[11] = -1, so the
+inverse is diagonal in x and y and a 2x2 inverse in z and w:
+ 1/sx 0    0     0
+ 0    1/sy 0     0
+ 0    0    0     -1
+ 0    0    1/pz  sz/pz */
+mat4 inverse_perspective( const mat4 &mm ) {
+	mat4 m = zero_mat4();
+	m.m[0] = 1.0f / mm.m[0];
+	m.m[5] = 1.0f / mm.m[5];
+	m.m[14] = -1.0f;
+	m.m[11] = 1.0f / mm.m[14];
+	m.m[15] = mm.m[10] / mm.m[14];
+	return m;
+}
 
+/*----------------------------HAMILTON IN DA HOUSE!---------------------------*/
 //versor::versor(const mat3& rot) 
 //{
 //	float trace = rot[0][0] + rot[1][1] + rot[2][2]; // I removed + 1.0f; see discussion with Ethan
@@ -802,94 +494,10 @@ versor::versor( const mat3& rot)
 	}
 }
 
-versor versor::operator/( float rhs ) {
-	versor result;
-	result.q[0] = q[0] / rhs;
-	result.q[1] = q[1] / rhs;
-	result.q[2] = q[2] / rhs;
-	result.q[3] = q[3] / rhs;
-	return result;
-}
-
-versor versor::operator*( float rhs ) {
-	versor result;
-	result.q[0] = q[0] * rhs;
-	result.q[1] = q[1] * rhs;
-	result.q[2] = q[2] * rhs;
-	result.q[3] = q[3] * rhs;
-	return result;
-}
-
 void print( const versor &q ) {
 	printf( "[%6f ,%6f, %6f, %6f]\n", q.q[0], q.q[1], q.q[2], q.q[3] );
 }
 
-versor versor::operator*( const versor &rhs ) {
-	versor result;
-	result.q[0] =
-		rhs.q[0] * q[0] - rhs.q[1] * q[1] - rhs.q[2] * q[2] - rhs.q[3] * q[3];
-	result.q[1] =
-		rhs.q[0] * q[1] + rhs.q[1] * q[0] - rhs.q[2] * q[3] + rhs.q[3] * q[2];
-	result.q[2] =
-		rhs.q[0] * q[2] + rhs.q[1] * q[3] + rhs.q[2] * q[0] - rhs.q[3] * q[1];
-	result.q[3] =
-		rhs.q[0] * q[3] - rhs.q[1] * q[2] + rhs.q[2] * q[1] + rhs.q[3] * q[0];
-	// re-normalise in case of mangling
-	return normalise( result );
-}
-
-versor versor::operator+( const versor &rhs ) {
-	versor result;
-	result.q[0] = rhs.q[0] + q[0];
-	result.q[1] = rhs.q[1] + q[1];
-	result.q[2] = rhs.q[2] + q[2];
-	result.q[3] = rhs.q[3] + q[3];
-	// re-normalise in case of mangling
-	return normalise( result );
-}
-
-versor quat_from_axis_rad( float radians, float x, float y, float z ) {
-	versor result;
-	result.q[0] = cosf( radians / 2.0f );
-	result.q[1] = sinf( radians / 2.0f ) * x;
-	result.q[2] = sinf( radians / 2.0f ) * y;
-	result.q[3] = sinf( radians / 2.0f ) * z;
-	return result;
-}
-
-versor quat_from_axis_deg( float degrees, float x, float y, float z ) {
-	return quat_from_axis_rad( ONE_DEG_IN_RAD * degrees, x, y, z );
-}
-
-mat4 quat_to_mat4( const versor &q ) {
-	float w = q.q[0];
-	float x = q.q[1];
-	float y = q.q[2];
-	float z = q.q[3];
-	return mat4( 1.0f - 2.0f * y * y - 2.0f * z * z, 2.0f * x * y + 2.0f * w * z, 2.0f * x * z - 2.0f * w * y, 0.0f,
-				 2.0f * x * y - 2.0f * w * z, 1.0f - 2.0f * x * x - 2.0f * z * z, 2.0f * y * z + 2.0f * w * x, 0.0f, 
-			     2.0f * x * z + 2.0f * w * y, 2.0f * y * z - 2.0f * w * x, 1.0f - 2.0f * x * x - 2.0f * y * y, 0.0f, 
-				 0.0f, 0.0f, 0.0f, 1.0f );
-}
-
-versor normalise( versor &q ) {
-	// norm(q) = q / magnitude (q)
-	// magnitude (q) = sqrt (w*w + x*x...)
-	// only compute sqrt if interior sum != 1.0
-	float sum = q.q[0] * q.q[0] + q.q[1] * q.q[1] + q.q[2] * q.q[2] + q.q[3] * q.q[3];
-	// NB: floats have min 6 digits of precision
-	const float thresh = 0.0001f;
-	if ( fabs( 1.0f - sum ) < thresh ) {
-		return q;
-	}
-	float mag = sqrtf( sum );
-	return q / mag;
-}
-
-float dot( const versor &q, const versor &r ) {
-	return q.q[0] * r.q[0] + q.q[1] * r.q[1] + q.q[2] * r.q[2] + q.q[3] * r.q[3];
-}
-
 versor slerp( versor &q, versor &r, float t ) {
 	// angle between q0-q1
 	float cos_half_theta = dot( q, r );
@@ -3,19 +3,45 @@
 
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <stddef.h>
 // const used to convert degrees into radians
 #define TAU 2.0 * M_PI
 #define ONE_DEG_IN_RAD static_cast<float>(( 2.0f * M_PI ) / 360.0) // 0.017444444
 #define ONE_RAD_IN_DEG static_cast<float>(360.0 / ( 2.0 * M_PI )) // 57.2957795
 
+/* SIMD backend for the mat4 products and the batch kernels, picked at compile
+time. define MATHS_NO_SIMD to force the scalar path. every backend adds the
+partial products in the same order as the scalar code, so results are
+bit-identical across backends as long as the compiler is not allowed to
+contract them into fma (-ffp-contract=off, or no fma in the target isa).
+they also match the scalar loops they replaced, except for the sign of
+zero: the old mat4 * mat4 started each sum from +0, so where the products
+now sum to -0 it gave +0. bench/maths_check.cpp checks all of this */
+#if !defined( MATHS_NO_SIMD ) && ( defined( __SSE__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 ) )
+#define MATHS_SIMD_SSE
+#elif !defined( MATHS_NO_SIMD ) && ( defined( __ARM_NEON ) || defined( _M_ARM64 ) )
+#define MATHS_SIMD_NEON
+#endif
+
+#if defined( MATHS_SIMD_SSE )
+#include <xmmintrin.h>
+#elif defined( MATHS_SIMD_NEON )
+#include <arm_neon.h>
+#endif
+
+/* the small functions are defined in this header, at the bottom, so they
+inline into the loops that call them. the ones that only do arithmetic are
+constexpr and fold when their arguments are constants. the rest lives in
+maths_funcs.cpp */
+
 struct vec2;
 struct vec3;
 struct vec4;
 struct versor;
 
 struct vec2 {
-	vec2();
-	vec2( float x, float y );
+	vec2() = default;
+	constexpr vec2( float x, float y ) : v{ x, y } {}
 	union {
 		float v[2];
 		struct {
@@ -25,33 +51,58 @@ struct vec2 {
 };
 
 struct vec3 {
-	vec3();
+	vec3() = default;
 	// create from 3 scalars
-	vec3( float x, float y, float z );
+	constexpr vec3( float x, float y, float z ) : v{ x, y, z } {}
 	// create from vec2 and a scalar
-	vec3( const vec2 &vv, float z );
+	constexpr vec3( const vec2 &vv, float z ) : v{ vv.v[0], vv.v[1], z } {}
 	// create from truncated vec4
-	vec3( const vec4 &vv );
+	constexpr vec3( const vec4 &vv );
 	// add vector to vector
-	vec3 operator+( const vec3 &rhs ) const;
+	constexpr vec3 operator+( const vec3 &rhs ) const {
+		return vec3( v[0] + rhs.v[0], v[1] + rhs.v[1], v[2] + rhs.v[2] );
+	}
 	// add scalar to vector
-	vec3 operator+( float rhs ) const;
+	constexpr vec3 operator+( float rhs ) const {
+		return vec3( v[0] + rhs, v[1] + rhs, v[2] + rhs );
+	}
 	// because user's expect this too
-	vec3 &operator+=( const vec3 &rhs );
+	vec3 &operator+=( const vec3 &rhs ) {
+		v[0] += rhs.v[0];
+		v[1] += rhs.v[1];
+		v[2] += rhs.v[2];
+		return *this; // return self
+	}
 	// subtract vector from vector
-	vec3 operator-( const vec3 &rhs ) const;
+	constexpr vec3 operator-( const vec3 &rhs ) const {
+		return vec3( v[0] - rhs.v[0], v[1] - rhs.v[1], v[2] - rhs.v[2] );
+	}
 	// add vector to vector
-	vec3 operator-( float rhs ) const ;
+	constexpr vec3 operator-( float rhs ) const {
+		return vec3( v[0] - rhs, v[1] - rhs, v[2] - rhs );
+	}
 	// because users expect this too
-	vec3 &operator-=( const vec3 &rhs );
+	vec3 &operator-=( const vec3 &rhs ) {
+		v[0] -= rhs.v[0];
+		v[1] -= rhs.v[1];
+		v[2] -= rhs.v[2];
+		return *this;
+	}
 	// multiply with scalar
-	vec3 operator*( float rhs );
+	constexpr vec3 operator*( float rhs ) const {
+		return vec3( v[0] * rhs, v[1] * rhs, v[2] * rhs );
+	}
 	// because users expect this too
-	vec3 &operator*=( float rhs );
+	vec3 &operator*=( float rhs ) {
+		v[0] = v[0] * rhs;
+		v[1] = v[1] * rhs;
+		v[2] = v[2] * rhs;
+		return *this;
+	}
 	// divide vector by scalar
-	vec3 operator/( float rhs );
-	// because users expect this too
-	vec3 &operator=( const vec3 &rhs );
+	constexpr vec3 operator/( float rhs ) const {
+		return vec3( v[0] / rhs, v[1] / rhs, v[2] / rhs );
+	}
 
 	// internal data
 	union {
@@ -63,17 +114,17 @@ struct vec3 {
 	inline float & operator[] (size_t Comp) {
 		return v[Comp];
 	}
-	inline const float & operator[] (size_t Comp) const {
+	inline constexpr const float & operator[] (size_t Comp) const {
 		return v[Comp];
 	}
 
 };
 
 struct vec4 {
-	vec4();
-	vec4( float x, float y, float z, float w );
-	vec4( const vec2 &vv, float z, float w );
-	vec4( const vec3 &vv, float w );
+	vec4() = default;
+	constexpr vec4( float x, float y, float z, float w ) : v{ x, y, z, w } {}
+	constexpr vec4( const vec2 &vv, float z, float w ) : v{ vv.v[0], vv.v[1], z, w } {}
+	constexpr vec4( const vec3 &vv, float w ) : v{ vv.v[0], vv.v[1], vv.v[2], w } {}
 
 	union {
 		float v[4];
@@ -82,23 +133,28 @@ struct vec4 {
 		};
 	};
 	// multiply with scalar
-	vec4 operator*( float rhs );
+	constexpr vec4 operator*( float rhs ) const {
+		return vec4( v[0] * rhs, v[1] * rhs, v[2] * rhs, v[3] * rhs );
+	}
 	inline float & operator[] (size_t Comp) {
 		return v[Comp];
 	}
-	inline const float & operator[] (size_t Comp) const {
+	inline constexpr const float & operator[] (size_t Comp) const {
 		return v[Comp];
 	}
 };
 
+constexpr vec3::vec3( const vec4 &vv ) : v{ vv.v[0], vv.v[1], vv.v[2] } {}
+
 /* stored like this:
 a d g
 b e h
 c f i */
 struct mat3 {
-	mat3();
-	mat3( float a, float b, float c, float d, float e, float f, float g, float h,
-				float i );
+	mat3() = default;
+	/* note: entered in COLUMNS */
+	constexpr mat3( float a, float b, float c, float d, float e, float f, float g, float h,
+				float i ) : m{ a, b, c, d, e, f, g, h, i } {}
 	union {
 		float m[9];
 		float c[3][3];
@@ -122,18 +178,18 @@ struct mat3 {
 struct versor;
 
 struct mat4 {
-	mat4();
+	mat4() = default;
 	// note! this is entering components in ROW-major order
-	mat4( float a, float b, float c, float d, float e, float f, float g, float h,
-				float i, float j, float k, float l, float mm, float n, float o, float p );
-	vec4 operator*( const vec4 &rhs );
-	mat4 operator*( const mat4 &rhs );
-	mat4 &operator=( const mat4 &rhs );
-	mat3 getRotation() const;
-	vec4 getColumn(int i) const;
-	vec4 getRow(int i) const;
-	void setColumn(int i, const vec4& v );
-	void setRow(int i, const vec4& v);
+	constexpr mat4( float a, float b, float c, float d, float e, float f, float g, float h,
+				float i, float j, float k, float l, float mm, float n, float o, float p )
+		: m{ a, b, c, d, e, f, g, h, i, j, k, l, mm, n, o, p } {}
+	inline vec4 operator*( const vec4 &rhs ) const;
+	inline mat4 operator*( const mat4 &rhs ) const;
+	inline mat3 getRotation() const;
+	inline vec4 getColumn(int i) const;
+	inline vec4 getRow(int i) const;
+	inline void setColumn(int i, const vec4& v );
+	inline void setRow(int i, const vec4& v);
 	void decompose(versor& q, vec3& pos, vec3& scale) const;
 	//void decompose2(versor& q, vec3& pos, vec3& scale) const;
 
@@ -152,13 +208,17 @@ struct mat4 {
 };
 
 struct versor {
-	versor();
-	versor(float x, float y, float z, float w);
+	versor() = default;
+	constexpr versor(float x, float y, float z, float w) : q{ w, x, y, z } {}
 	versor(const mat3& rot) ;
-	versor operator/( float rhs );
-	versor operator*( float rhs );
-	versor operator*( const versor &rhs );
-	versor operator+( const versor &rhs );
+	constexpr versor operator/( float rhs ) const {
+		return versor( q[1] / rhs, q[2] / rhs, q[3] / rhs, q[0] / rhs );
+	}
+	constexpr versor operator*( float rhs ) const {
+		return versor( q[1] * rhs, q[2] * rhs, q[3] * rhs, q[0] * rhs );
+	}
+	inline versor operator*( const versor &rhs ) const;
+	inline versor operator+( const versor &rhs ) const;
 	union {
 		float q[4];
 		struct {
@@ -173,41 +233,346 @@ void print( const vec4 &v );
 void print( const mat3 &m );
 void print( const mat4 &m );
 // vector functions
-float length( const vec3 &v );
-float length2( const vec3 &v );
-vec3 normalise( const vec3 &v );
-float dot( const vec3 &a, const vec3 &b );
-vec3 cross( const vec3 &a, const vec3 &b );
-vec4 homogeneous( const vec4 &a );
-float get_squared_dist( vec3 from, vec3 to );
+inline float length( const vec3 &v );
+constexpr float length2( const vec3 &v );
+inline vec3 normalise( const vec3 &v );
+constexpr float dot( const vec3 &a, const vec3 &b );
+constexpr vec3 cross( const vec3 &a, const vec3 &b );
+constexpr vec4 homogeneous( const vec4 &a );
+constexpr float get_squared_dist( vec3 from, vec3 to );
 float direction_to_heading( vec3 d );
 vec3 heading_to_direction( float degrees );
 // matrix functions
-mat3 zero_mat3();
-mat3 identity_mat3();
-mat4 zero_mat4();
-mat4 identity_mat4();
-float determinant( const mat4 &mm );
+constexpr mat3 zero_mat3();
+constexpr mat3 identity_mat3();
+constexpr mat4 zero_mat4();
+constexpr mat4 identity_mat4();
+constexpr float determinant( const mat4 &mm );
 mat4 inverse( const mat4 &mm );
-mat4 transpose( const mat4 &mm );
-mat3 transpose( const mat3 &mm );
+// closed-form inverses for the common special cases. inverse_affine expects
+// a bottom row of 0 0 0 1, inverse_rigid only rotation and translation
+mat4 inverse_affine( const mat4 &mm );
+mat4 inverse_rigid( const mat4 &mm );
+constexpr mat4 transpose( const mat4 &mm );
+constexpr mat3 transpose( const mat3 &mm );
+// batch functions
+// out[i] = a[i] * b[i]. out may alias a or b
+void mul_mat4_array( const mat4 *a, const mat4 *b, mat4 *out, size_t n );
+// out[i] = m * vec4( in[i], 1 ) without perspective divide. out may alias in
+void transform_points( const mat4 &m, const vec3 *in, vec3 *out, size_t n );
 // affine functions
-mat4 translate( const mat4 &m, const vec3 &v );
+inline mat4 translate( const mat4 &m, const vec3 &v );
 mat4 rotate_x_deg( const mat4 &m, float deg );
 mat4 rotate_y_deg( const mat4 &m, float deg );
 mat4 rotate_z_deg( const mat4 &m, float deg );
-mat4 scaler( const mat4 &m, const vec3 &v );
+inline mat4 scaler( const mat4 &m, const vec3 &v );
 // camera functions
 mat4 look_at( const vec3 &cam_pos, vec3 targ_pos, const vec3 &up );
 mat4 perspective( float fovy, float aspect, float near, float far );
+// inverse of a matrix built by perspective()
+mat4 inverse_perspective( const mat4 &mm );
 // quaternion functions
-versor quat_from_axis_rad( float radians, float x, float y, float z );
-versor quat_from_axis_deg( float degrees, float x, float y, float z );
-mat4 quat_to_mat4( const versor &q );
-float dot( const versor &q, const versor &r );
+inline versor quat_from_axis_rad( float radians, float x, float y, float z );
+inline versor quat_from_axis_deg( float degrees, float x, float y, float z );
+constexpr mat4 quat_to_mat4( const versor &q );
+constexpr float dot( const versor &q, const versor &r );
 versor slerp( const versor &q, const versor &r );
 // stupid overloading wouldn't let me use const
-versor normalise( versor &q );
+inline versor normalise( versor &q );
 void print( const versor &q );
 versor slerp( versor &q, versor &r, float t );
+
+/*------------------------------VECTOR FUNCTIONS------------------------------*/
+inline float length( const vec3 &v ) {
+	return sqrtf( v.v[0] * v.v[0] + v.v[1] * v.v[1] + v.v[2] * v.v[2] );
+}
+
+// squared length
+constexpr float length2( const vec3 &v ) {
+	return v.v[0] * v.v[0] + v.v[1] * v.v[1] + v.v[2] * v.v[2];
+}
+
+// note: proper spelling (hehe)
+inline vec3 normalise( const vec3 &v ) {
+	float l = length( v );
+	if ( 0.0f == l ) {
+		return vec3( 0.0f, 0.0f, 0.0f );
+	}
+	return vec3( v.v[0] / l, v.v[1] / l, v.v[2] / l );
+}
+
+constexpr float dot( const vec3 &a, const vec3 &b ) {
+	return a.v[0] * b.v[0] + a.v[1] * b.v[1] + a.v[2] * b.v[2];
+}
+
+constexpr vec3 cross( const vec3 &a, const vec3 &b ) {
+	return vec3( a.v[1] * b.v[2] - a.v[2] * b.v[1],
+				 a.v[2] * b.v[0] - a.v[0] * b.v[2],
+				 a.v[0] * b.v[1] - a.v[1] * b.v[0] );
+}
+
+constexpr vec4 homogeneous( const vec4 &a ) {
+	return vec4( a.v[0] / a.v[3], a.v[1] / a.v[3], a.v[2] / a.v[3], 1.f );
+}
+
+constexpr float get_squared_dist( vec3 from, vec3 to ) {
+	return ( to.v[0] - from.v[0] ) * ( to.v[0] - from.v[0] ) +
+		   ( to.v[1] - from.v[1] ) * ( to.v[1] - from.v[1] ) +
+		   ( to.v[2] - from.v[2] ) * ( to.v[2] - from.v[2] );
+}
+
+/*-----------------------------MATRIX FUNCTIONS-------------------------------*/
+constexpr mat3 zero_mat3() {
+	return mat3( 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f );
+}
+
+constexpr mat3 identity_mat3() {
+	return mat3( 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f );
+}
+
+constexpr mat4 zero_mat4() {
+	return mat4( 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+							 0.0f, 0.0f, 0.0f, 0.0f, 0.0f );
+}
+
+constexpr mat4 identity_mat4() {
+	return mat4( 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+							 0.0f, 0.0f, 0.0f, 0.0f, 1.0f );
+}
+
+/* column kernels shared by the products and the batch functions. r = a * b
+for column-major 4x4 a and b; r may alias a or b */
+inline void mul_mat4_kernel( const float *a, const float *b, float *r ) {
+#if defined( MATHS_SIMD_SSE )
+	__m128 c0 = _mm_loadu_ps( a );
+	__m128 c1 = _mm_loadu_ps( a + 4 );
+	__m128 c2 = _mm_loadu_ps( a + 8 );
+	__m128 c3 = _mm_loadu_ps( a + 12 );
+	for ( int col = 0; col < 4; col++ ) {
+		const float *bc = b + col * 4;
+		__m128 s = _mm_mul_ps( c0, _mm_set1_ps( bc[0] ) );
+		s = _mm_add_ps( s, _mm_mul_ps( c1, _mm_set1_ps( bc[1] ) ) );
+		s = _mm_add_ps( s, _mm_mul_ps( c2, _mm_set1_ps( bc[2] ) ) );
+		s = _mm_add_ps( s, _mm_mul_ps( c3, _mm_set1_ps( bc[3] ) ) );
+		_mm_storeu_ps( r + col * 4, s );
+	}
+#elif defined( MATHS_SIMD_NEON )
+	float32x4_t c0 = vld1q_f32( a );
+	float32x4_t c1 = vld1q_f32( a + 4 );
+	float32x4_t c2 = vld1q_f32( a + 8 );
+	float32x4_t c3 = vld1q_f32( a + 12 );
+	for ( int col = 0; col < 4; col++ ) {
+		const float *bc = b + col * 4;
+		// vmlaq may be fused on some targets, keep mul and add apart
+		float32x4_t s = vmulq_n_f32( c0, bc[0] );
+		s = vaddq_f32( s, vmulq_n_f32( c1, bc[1] ) );
+		s = vaddq_f32( s, vmulq_n_f32( c2, bc[2] ) );
+		s = vaddq_f32( s, vmulq_n_f32( c3, bc[3] ) );
+		vst1q_f32( r + col * 4, s );
+	}
+#else
+	float t[16];
+	for ( int col = 0; col < 4; col++ ) {
+		const float *bc = b + col * 4;
+		for ( int row = 0; row < 4; row++ ) {
+			t[col * 4 + row] = a[row] * bc[0] + a[row + 4] * bc[1] + a[row + 8] * bc[2] +
+												 a[row + 12] * bc[3];
+		}
+	}
+	for ( int i = 0; i < 16; i++ ) {
+		r[i] = t[i];
+	}
+#endif
+}
+
+// r = a * (x, y, z, w)
+inline void mul_vec4_kernel( const float *a, float x, float y, float z, float w, float *r ) {
+#if defined( MATHS_SIMD_SSE )
+	__m128 s = _mm_mul_ps( _mm_loadu_ps( a ), _mm_set1_ps( x ) );
+	s = _mm_add_ps( s, _mm_mul_ps( _mm_loadu_ps( a + 4 ), _mm_set1_ps( y ) ) );
+	s = _mm_add_ps( s, _mm_mul_ps( _mm_loadu_ps( a + 8 ), _mm_set1_ps( z ) ) );
+	s = _mm_add_ps( s, _mm_mul_ps( _mm_loadu_ps( a + 12 ), _mm_set1_ps( w ) ) );
+	_mm_storeu_ps( r, s );
+#elif defined( MATHS_SIMD_NEON )
+	float32x4_t s = vmulq_n_f32( vld1q_f32( a ), x );
+	s = vaddq_f32( s, vmulq_n_f32( vld1q_f32( a + 4 ), y ) );
+	s = vaddq_f32( s, vmulq_n_f32( vld1q_f32( a + 8 ), z ) );
+	s = vaddq_f32( s, vmulq_n_f32( vld1q_f32( a + 12 ), w ) );
+	vst1q_f32( r, s );
+#else
+	// 0x + 4y + 8z + 12w
+	float rx = a[0] * x + a[4] * y + a[8] * z + a[12] * w;
+	// 1x + 5y + 9z + 13w
+	float ry = a[1] * x + a[5] * y + a[9] * z + a[13] * w;
+	// 2x + 6y + 10z + 14w
+	float rz = a[2] * x + a[6] * y + a[10] * z + a[14] * w;
+	// 3x + 7y + 11z + 15w
+	float rw = a[3] * x + a[7] * y + a[11] * z + a[15] * w;
+	r[0] = rx;
+	r[1] = ry;
+	r[2] = rz;
+	r[3] = rw;
+#endif
+}
+
+inline vec4 mat4::operator*( const vec4 &rhs ) const {
+	vec4 r;
+	mul_vec4_kernel( m, rhs.v[0], rhs.v[1], rhs.v[2], rhs.v[3], r.v );
+	return r;
+}
+
+inline mat4 mat4::operator*( const mat4 &rhs ) const {
+	mat4 r;
+	mul_mat4_kernel( m, rhs.m, r.m );
+	return r;
+}
+
+inline mat3 mat4::getRotation() const {
+	return mat3( m[0], m[1], m[2], m[4], m[5], m[6], m[8], m[9], m[10] );
+}
+
+inline vec4 mat4::getColumn( int i ) const {
+	return col[i];
+}
+
+inline vec4 mat4::getRow( int i ) const {
+	return vec4( m[i + 0], m[i + 4], m[i + 8], m[i + 12] );
+}
+
+inline void mat4::setRow( int i, const vec4 &v ) {
+	m[0 + i] = v[0];
+	m[4 + i] = v[1];
+	m[8 + i] = v[2];
+	m[12 + i] = v[3];
+}
+
+inline void mat4::setColumn( int i, const vec4 &v ) {
+	col[i] = v;
+}
+
+// returns a scalar value with the determinant for a 4x4 matrix
+// see
+// http://www.euclideanspace.com/maths/algebra/matrix/functions/determinant/fourD/index.htm
+constexpr float determinant( const mat4 &mm ) {
+	return mm.m[12] * mm.m[9] * mm.m[6] * mm.m[3] -
+				 mm.m[8] * mm.m[13] * mm.m[6] * mm.m[3] -
+				 mm.m[12] * mm.m[5] * mm.m[10] * mm.m[3] +
+				 mm.m[4] * mm.m[13] * mm.m[10] * mm.m[3] +
+				 mm.m[8] * mm.m[5] * mm.m[14] * mm.m[3] -
+				 mm.m[4] * mm.m[9] * mm.m[14] * mm.m[3] -
+				 mm.m[12] * mm.m[9] * mm.m[2] * mm.m[7] +
+				 mm.m[8] * mm.m[13] * mm.m[2] * mm.m[7] +
+				 mm.m[12] * mm.m[1] * mm.m[10] * mm.m[7] -
+				 mm.m[0] * mm.m[13] * mm.m[10] * mm.m[7] -
+				 mm.m[8] * mm.m[1] * mm.m[14] * mm.m[7] +
+				 mm.m[0] * mm.m[9] * mm.m[14] * mm.m[7] +
+				 mm.m[12] * mm.m[5] * mm.m[2] * mm.m[11] -
+				 mm.m[4] * mm.m[13] * mm.m[2] * mm.m[11] -
+				 mm.m[12] * mm.m[1] * mm.m[6] * mm.m[11] +
+				 mm.m[0] * mm.m[13] * mm.m[6] * mm.m[11] +
+				 mm.m[4] * mm.m[1] * mm.m[14] * mm.m[11] -
+				 mm.m[0] * mm.m[5] * mm.m[14] * mm.m[11] -
+				 mm.m[8] * mm.m[5] * mm.m[2] * mm.m[15] +
+				 mm.m[4] * mm.m[9] * mm.m[2] * mm.m[15] +
+				 mm.m[8] * mm.m[1] * mm.m[6] * mm.m[15] -
+				 mm.m[0] * mm.m[9] * mm.m[6] * mm.m[15] -
+				 mm.m[4] * mm.m[1] * mm.m[10] * mm.m[15] +
+				 mm.m[0] * mm.m[5] * mm.m[10] * mm.m[15];
+}
+
+// returns a 16-element array flipped on the main diagonal
+constexpr mat4 transpose( const mat4 &mm ) {
+	return mat4( mm.m[0], mm.m[4], mm.m[8], mm.m[12], mm.m[1], mm.m[5], mm.m[9],
+							 mm.m[13], mm.m[2], mm.m[6], mm.m[10], mm.m[14], mm.m[3], mm.m[7],
+							 mm.m[11], mm.m[15] );
+}
+
+constexpr mat3 transpose( const mat3 &mm ) {
+	return mat3(
+		mm.m[0], mm.m[3], mm.m[6],
+		mm.m[1], mm.m[4], mm.m[7],
+		mm.m[2], mm.m[5], mm.m[8] );
+}
+
+/*--------------------------AFFINE MATRIX FUNCTIONS---------------------------*/
+// translate a 4d matrix with xyz array
+inline mat4 translate( const mat4 &m, const vec3 &v ) {
+	mat4 ret = identity_mat4();
+	ret.m[12] = v.v[0];
+	ret.m[13] = v.v[1];
+	ret.m[14] = v.v[2];
+	return ret * m;
+}
+
+// scale a matrix by [x, y, z]
+inline mat4 scaler( const mat4 &m, const vec3 &v ) {
+	mat4 a = identity_mat4();
+	a.m[0] = v.v[0];
+	a.m[5] = v.v[1];
+	a.m[10] = v.v[2];
+	return a * m;
+}
+
+/*----------------------------HAMILTON IN DA HOUSE!---------------------------*/
+inline versor versor::operator*( const versor &rhs ) const {
+	versor result;
+	result.q[0] =
+		rhs.q[0] * q[0] - rhs.q[1] * q[1] - rhs.q[2] * q[2] - rhs.q[3] * q[3];
+	result.q[1] =
+		rhs.q[0] * q[1] + rhs.q[1] * q[0] - rhs.q[2] * q[3] + rhs.q[3] * q[2];
+	result.q[2] =
+		rhs.q[0] * q[2] + rhs.q[1] * q[3] + rhs.q[2] * q[0] - rhs.q[3] * q[1];
+	result.q[3] =
+		rhs.q[0] * q[3] - rhs.q[1] * q[2] + rhs.q[2] * q[1] + rhs.q[3] * q[0];
+	// re-normalise in case of mangling
+	return normalise( result );
+}
+
+inline versor versor::operator+( const versor &rhs ) const {
+	versor result;
+	result.q[0] = rhs.q[0] + q[0];
+	result.q[1] = rhs.q[1] + q[1];
+	result.q[2] = rhs.q[2] + q[2];
+	result.q[3] = rhs.q[3] + q[3];
+	// re-normalise in case of mangling
+	return normalise( result );
+}
+
+inline versor quat_from_axis_rad( float radians, float x, float y, float z ) {
+	float s = sinf( radians / 2.0f );
+	return versor( s * x, s * y, s * z, cosf( radians / 2.0f ) );
+}
+
+inline versor quat_from_axis_deg( float degrees, float x, float y, float z ) {
+	return quat_from_axis_rad( ONE_DEG_IN_RAD * degrees, x, y, z );
+}
+
+constexpr mat4 quat_to_mat4( const versor &q ) {
+	float w = q.q[0];
+	float x = q.q[1];
+	float y = q.q[2];
+	float z = q.q[3];
+	return mat4( 1.0f - 2.0f * y * y - 2.0f * z * z, 2.0f * x * y + 2.0f * w * z, 2.0f * x * z - 2.0f * w * y, 0.0f,
+				 2.0f * x * y - 2.0f * w * z, 1.0f - 2.0f * x * x - 2.0f * z * z, 2.0f * y * z + 2.0f * w * x, 0.0f,
+			     2.0f * x * z + 2.0f * w * y, 2.0f * y * z - 2.0f * w * x, 1.0f - 2.0f * x * x - 2.0f * y * y, 0.0f,
+				 0.0f, 0.0f, 0.0f, 1.0f );
+}
+
+inline versor normalise( versor &q ) {
+	// norm(q) = q / magnitude (q)
+	// magnitude (q) = sqrt (w*w + x*x...)
+	// only compute sqrt if interior sum != 1.0
+	float sum = q.q[0] * q.q[0] + q.q[1] * q.q[1] + q.q[2] * q.q[2] + q.q[3] * q.q[3];
+	// NB: floats have min 6 digits of precision
+	const float thresh = 0.0001f;
+	if ( fabsf( 1.0f - sum ) < thresh ) {
+		return q;
+	}
+	float mag = sqrtf( sum );
+	return q / mag;
+}
+
+constexpr float dot( const versor &q, const versor &r ) {
+	return q.q[0] * r.q[0] + q.q[1] * r.q[1] + q.q[2] * r.q[2] + q.q[3] * r.q[3];
+}
 #endif
@@ -11,14 +11,50 @@
 
 #include "maths_funcs.h"
 #include "gl_utils.h"
+#include "vertex_packing.h"
+#include "thread_pool.h"
+#include "texture_cache.h"
+
+#include <algorithm>
+#include <stddef.h>
+#include <string.h>
 
 #define DMAP_IMG_FILE "DefaultDiffuseMap.png"
 //#define DMAP_IMG_FILE "CheckerDiffuseMap.png"
 #define NMAP_IMG_FILE "DefaultNormalMap.png"
 
 namespace {
-	Meshgroup::Texture default_diffuse;
-	Meshgroup::Texture default_normal;}
+	// TextureCache ids, pinned for the whole run by load_default_textures()
+	size_t default_diffuse = 0;
+	size_t default_normal = 0;
+
+	// the loading thread does not decode, it carries on with the geometry,
+	// so every hardware thread gets a worker
+	ThreadPool& texture_pool() {
+		static ThreadPool pool(std::thread::hardware_concurrency() + 1);
+		return pool;
+	}
+
+	// same attribute locations as the separate buffers, only the formats change
+	template <typename Vertex>
+	void setup_interleaved_attributes(const Meshgroup::Mesh& mesh, GLenum position_type, GLboolean position_normalized) {
+		const GLsizei stride = sizeof(Vertex);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, position_type, position_normalized, stride, (GLvoid*)offsetof(Vertex, position));
+		if (mesh.vn) {
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (GLvoid*)offsetof(Vertex, normal));
+		}
+		for (size_t j = 0; j < 2 && j < mesh.uvs.size(); ++j) {
+			glEnableVertexAttribArray(2 + j);
+			glVertexAttribPointer(2 + j, 2, GL_HALF_FLOAT, GL_FALSE, stride, (GLvoid*)(offsetof(Vertex, uvs) + j * 2 * sizeof(uint16_t)));
+		}
+		if (mesh.vtans) {
+			glEnableVertexAttribArray(4);
+			glVertexAttribPointer(4, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (GLvoid*)offsetof(Vertex, tangent));
+		}
+	}
+}
 
 
 mat4 fromAssimpTransform(const aiMatrix4x4& aiTransform) {
@@ -67,16 +103,16 @@ void getNodeHierarchy(std::vector<Node>& nodes, size_t nodeIndex, size_t& curren
 	//node.position = vec3 (aiposition.x, aiposition.y, aiposition.z);
 	//node.rotation = versor(airotation.x, airotation.y, airotation.z, airotation.w);
 	//node.scale = vec3(aiscale.x,aiscale.y,aiscale.z);
-	node.position = position;
-	node.rotation = rotation;
-	node.scale = scale;
+	node.setPosition(position);
+	node.setRotation(rotation);
+	node.setScale(scale);
 
-	//print(node.position);
-	//print(node.rotation);
-	//print(node.scale);
+	//print(node.position());
+	//print(node.rotation());
+	//print(node.scale());
 
-	mat4 localMatrix2 = quat_to_mat4(node.rotation);
-	localMatrix2.setColumn(3, vec4(node.position, 1));
+	mat4 localMatrix2 = quat_to_mat4(node.rotation());
+	localMatrix2.setColumn(3, vec4(node.position(), 1));
 
 	names[nodeIndex] = ainode->mName.C_Str();
 
@@ -148,15 +184,123 @@ bool getTransform(const aiScene* scene, const aiNode* node, const aiMesh* meshGr
 	return false;
 }
 
+int findNode(const std::vector<std::string>& names, const char* name) {
+	std::vector<std::string>::const_iterator found = std::find(names.begin(), names.end(), name);
+	return found == names.end() ? -1 : (int)(found - names.begin());
+}
+
+// keeps the 4 heaviest bones of every vertex and renormalises their weights
+void importBones(const aiMesh* aimesh, std::vector<Node>& nodes, const std::vector<std::string>& names, Meshgroup::Mesh& mesh) {
+	if (!aimesh->HasBones()) {
+		return;
+	}
+	if (aimesh->mNumBones > (unsigned)Meshgroup::Mesh::MaxBones) {
+		fprintf(stderr, "WARNING: mesh with %u bones, more than %d, drawn unskinned\n", aimesh->mNumBones,
+			Meshgroup::Mesh::MaxBones);
+		return;
+	}
+	std::vector<Meshgroup::Mesh::Bone> bones(aimesh->mNumBones);
+	for (unsigned b = 0; b < aimesh->mNumBones; ++b) {
+		const aiBone* aibone = aimesh->mBones[b];
+		int node = findNode(names, aibone->mName.C_Str());
+		if (node < 0) {
+			fprintf(stderr, "WARNING: bone %s has no node, mesh drawn unskinned\n", aibone->mName.C_Str());
+			return;
+		}
+		bones[b].node = &nodes[node];
+		bones[b].offset = fromAssimpTransform(aibone->mOffsetMatrix);
+	}
+	mesh.bones.swap(bones);
+
+	size_t vertex_count = (size_t)mesh.vertex_count;
+	mesh.bone_ids = (uint8_t*)calloc(vertex_count * 4, sizeof(uint8_t));
+	mesh.bone_weights = (GLfloat*)calloc(vertex_count * 4, sizeof(GLfloat));
+	for (unsigned b = 0; b < aimesh->mNumBones; ++b) {
+		const aiBone* aibone = aimesh->mBones[b];
+		for (unsigned w = 0; w < aibone->mNumWeights; ++w) {
+			const aiVertexWeight& weight = aibone->mWeights[w];
+			GLfloat* weights = &mesh.bone_weights[weight.mVertexId * 4];
+			int lightest = 0;
+			for (int i = 1; i < 4; ++i) {
+				if (weights[i] < weights[lightest]) {
+					lightest = i;
+				}
+			}
+			if (weight.mWeight > weights[lightest]) {
+				weights[lightest] = weight.mWeight;
+				mesh.bone_ids[weight.mVertexId * 4 + lightest] = (uint8_t)b;
+			}
+		}
+	}
+	for (size_t v = 0; v < vertex_count; ++v) {
+		GLfloat* weights = &mesh.bone_weights[v * 4];
+		float total = weights[0] + weights[1] + weights[2] + weights[3];
+		// vertices no bone holds keep all zero weights, the shader leaves them in the bind pose
+		if (total > 0.f) {
+			for (int i = 0; i < 4; ++i) {
+				weights[i] /= total;
+			}
+		}
+	}
+	printf("mesh has %u bones\n", aimesh->mNumBones);
+}
+
+// key times go from ticks to seconds, channels without a node are dropped
+void importAnimation(const aiAnimation* aianimation, const std::vector<std::string>& names, AnimationClip& clip) {
+	// assimp leaves the rate at 0 when the file does not say, 25 is its own fallback
+	double ticks_per_second = aianimation->mTicksPerSecond != 0.0 ? aianimation->mTicksPerSecond : 25.0;
+	clip.name = aianimation->mName.C_Str();
+	clip.duration = (float)(aianimation->mDuration / ticks_per_second);
+	clip.channels.reserve(aianimation->mNumChannels);
+	for (unsigned c = 0; c < aianimation->mNumChannels; ++c) {
+		const aiNodeAnim* aichannel = aianimation->mChannels[c];
+		int node = findNode(names, aichannel->mNodeName.C_Str());
+		if (node < 0) {
+			fprintf(stderr, "WARNING: animation %s drives a missing node %s\n", clip.name.c_str(),
+				aichannel->mNodeName.C_Str());
+			continue;
+		}
+		clip.channels.push_back(AnimationClip::Channel());
+		AnimationClip::Channel& channel = clip.channels.back();
+		channel.node = node;
+		for (unsigned k = 0; k < aichannel->mNumPositionKeys; ++k) {
+			const aiVectorKey& key = aichannel->mPositionKeys[k];
+			channel.position_times.push_back((float)(key.mTime / ticks_per_second));
+			channel.positions.push_back(vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+		}
+		for (unsigned k = 0; k < aichannel->mNumRotationKeys; ++k) {
+			const aiQuatKey& key = aichannel->mRotationKeys[k];
+			channel.rotation_times.push_back((float)(key.mTime / ticks_per_second));
+			channel.rotations.push_back(versor(key.mValue.x, key.mValue.y, key.mValue.z, key.mValue.w));
+		}
+		for (unsigned k = 0; k < aichannel->mNumScalingKeys; ++k) {
+			const aiVectorKey& key = aichannel->mScalingKeys[k];
+			channel.scale_times.push_back((float)(key.mTime / ticks_per_second));
+			channel.scales.push_back(vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+		}
+	}
+	printf("  animation %s: %.2f s, %zu channels\n", clip.name.c_str(), clip.duration, clip.channels.size());
+}
+
 bool Meshgroup::load_from_file(const char* file_name, int index ) {
-	const aiScene* scene = aiImportFile(file_name, aiProcess_Triangulate | aiProcess_CalcTangentSpace| aiProcess_GenSmoothNormals /*| aiProcess_FlipUVs*/);
-	aiNode* aiRootNode = scene->mRootNode;
+	std::string cache_name = std::string(file_name) + MESH_CACHE_EXT;
+	if (load_cache(cache_name.c_str(), file_name)) {
+		for (size_t m = 0; m < meshes.size(); ++m) {
+			meshes[m].compute_bounds();
+			meshes[m].build_triangle_bvh();
+		}
+		print_vertex_cache_stats();
+		start_texture_decoding();
+		return true;
+	}
 
+	const aiScene* scene = aiImportFile(file_name, aiProcess_Triangulate | aiProcess_CalcTangentSpace| aiProcess_GenSmoothNormals /*| aiProcess_FlipUVs*/);
 	if (!scene) {
 		const char* error = aiGetErrorString();
 		fprintf(stderr, "ERROR: reading mesh %s:\n%s\n", file_name, error);
 		return false;
 	}
+	aiNode* aiRootNode = scene->mRootNode;
 	printf("  %i animations\n", scene->mNumAnimations);
 	printf("  %i cameras\n", scene->mNumCameras);
 	printf("  %i lights\n", scene->mNumLights);
@@ -164,8 +308,64 @@ bool Meshgroup::load_from_file(const char* file_name, int index ) {
 	printf("  %i meshes\n", scene->mNumMeshes);
 	printf("  %i textures\n", scene->mNumTextures);
 
-	// get first mesh only
+	// materials first so the textures decode while the geometry is processed
 	meshes.resize(scene->mNumMeshes);
+	for (unsigned m = 0; m < meshes.size(); ++m) {
+		Mesh& mesh = meshes[m];
+		const aiMesh* aimesh = scene->mMeshes[m];
+
+		mesh.MaterialIndex = aimesh->mMaterialIndex;
+		unsigned materialsSize = scene->mNumMaterials;
+		//for (int i = 0; i < materialsSize; ++i) {
+		if (materialsSize > mesh.MaterialIndex) {
+			const aiMaterial* material = scene->mMaterials[mesh.MaterialIndex];
+			{
+				aiString path;
+				aiTextureMapping mapping;
+				unsigned int uvindex;
+				unsigned count = (*material).GetTextureCount(aiTextureType_DIFFUSE);
+				if (count) {
+					(*material).GetTexture(aiTextureType_DIFFUSE, 0, &path, &mapping, &uvindex);
+				}
+
+				if (path.length) {
+					mesh.diffuse_path = path.C_Str();
+				}
+			}
+			{
+				aiString path;
+				unsigned count = (*material).GetTextureCount(aiTextureType_NORMALS);
+				if (count) {
+					(*material).GetTexture(aiTextureType_NORMALS, 0, &path);
+				}
+				if (path.length) {
+					mesh.normal_path = path.C_Str();
+				}
+			}
+			{
+				aiColor3D color(0.f, 0.f, 0.f);
+				(*material).Get(AI_MATKEY_COLOR_DIFFUSE, color);
+				//printf("read color:%f,%f,%f", color.r, color.g, color.b);
+				mesh.diffuse_base_color = vec3(color.r, color.g, color.b);
+			}
+		}
+	}
+	start_texture_decoding();
+
+	// nodes before the geometry, bones are found by node name
+	size_t nodeSize = getNodeHierarchySize(aiRootNode);
+	// a previous load's nodes give their slots up, fresh handles are registered below
+	nodes.clear();
+	nodes.resize(nodeSize);
+	names.resize(nodeSize);
+	for (size_t i = 0; i < nodeSize; ++i) {
+		nodes[i].init();
+	}
+	// TODO: evaluate if this is working (it is not)
+	size_t currentSize = 1;
+	getNodeHierarchy(nodes, 0, currentSize, aiRootNode, meshes, names);
+
+	// get first mesh only
 	for (unsigned m = 0; m < meshes.size(); ++m) {
 		Mesh& mesh = meshes[m]; 
 
@@ -291,93 +491,156 @@ bool Meshgroup::load_from_file(const char* file_name, int index ) {
 			}
 		}
 		mesh.index_count = mesh.face_count*3;
-		
-		mesh.MaterialIndex = aimesh->mMaterialIndex;
-		unsigned materialsSize = scene->mNumMaterials;
-		//for (int i = 0; i < materialsSize; ++i) {
-		if (materialsSize > mesh.MaterialIndex) {
-			const aiMaterial* material = scene->mMaterials[mesh.MaterialIndex];
-			{
-				aiString path;
-				aiTextureMapping mapping;
-				unsigned int uvindex;
-				unsigned count = (*material).GetTextureCount(aiTextureType_DIFFUSE);
-				if (count) {
-					(*material).GetTexture(aiTextureType_DIFFUSE, 0, &path, &mapping, &uvindex);
-				}
+		importBones(aimesh, nodes, names, mesh);
+		mesh.optimize();
+		mesh.compute_bounds();
+		mesh.build_triangle_bvh();
+	}
 
-				Texture& tex= mesh.diffuse;
-				tex.image_data = default_diffuse.image_data;
-				tex.x = default_diffuse.x;
-				tex.y = default_diffuse.y;
-				tex.n = default_diffuse.n;
+	clips.resize(scene->mNumAnimations);
+	for (unsigned a = 0; a < scene->mNumAnimations; ++a) {
+		importAnimation(scene->mAnimations[a], names, clips[a]);
+	}
 
-				if (path.length) {
-					load_image_data(path.C_Str(), &tex.image_data, tex.x, tex.y, tex.n);
-					//load_texture_to_gpu(mesh.diffuse_image_data, &mesh.dmap_tex, x, y, n);
-					//unload_image_data(mesh.diffuse_image_data);
-				}
-				//else {
-					//mesh.diffuse_image_data = default_diffuse_data;
-					//load_texture_to_gpu(default_diffuse_data, &mesh.dmap_tex, default_diffuse_x, default_diffuse_y, default_diffuse_n);
-				//}
-			}
-			{
-				aiString path;
-				unsigned count = (*material).GetTextureCount(aiTextureType_NORMALS);
-				if (count) {
-					(*material).GetTexture(aiTextureType_NORMALS, 0, &path);
-				}
-				Texture& tex= mesh.normal;
-				tex.image_data = default_normal.image_data;
-				tex.x = default_normal.x;
-				tex.y = default_normal.y;
-				tex.n = default_normal.n;
-				
-				if (path.length) {
-					load_image_data(path.C_Str(), &tex.image_data, tex.x, tex.y, tex.n);
-					//load_texture_to_gpu(mesh.normal_image_data, &mesh.nmap_tex, x, y, n);
-					//unload_image_data(mesh.normal_image_data);
-				}
-				//else {
-				//	load_texture_to_gpu(default_normal_data, &mesh.dmap_tex, default_normal_x, default_normal_y, default_normal_n);
-				//}
+	aiReleaseImport(scene);
+
+	printf("mesh loaded\n");
+	print_vertex_cache_stats();
+
+	write_cache(cache_name.c_str(), file_name);
+
+	return true;
+}
+
+void Meshgroup::start_texture_decoding() {
+	TextureCache& textures = TextureCache::main();
+	texture_decoder.reset(new TextureDecoder(texture_pool()));
+	texture_jobs.clear();
+
+	for (size_t m = 0; m < meshes.size(); ++m) {
+		Mesh& mesh = meshes[m];
+		// the defaults by id: they were resolved from load_default_textures()'s
+		// directory, by name they would be looked up in the model's
+		mesh.diffuse_texture = mesh.diffuse_path.empty() ? textures.retain(default_diffuse) : textures.acquire(mesh.diffuse_path);
+		mesh.normal_texture = mesh.normal_path.empty() ? textures.retain(default_normal) : textures.acquire(mesh.normal_path);
+
+		// one job per image, however many meshes share it
+		size_t ids[2] = { mesh.diffuse_texture, mesh.normal_texture };
+		for (int i = 0; i < 2; ++i) {
+			if (textures.needs_decode(ids[i]) && std::find(texture_jobs.begin(), texture_jobs.end(), ids[i]) == texture_jobs.end()) {
+				texture_decoder->push(textures.entries[ids[i]].path);
+				texture_jobs.push_back(ids[i]);
 			}
-			{
-				aiColor3D color(0.f, 0.f, 0.f);
-				(*material).Get(AI_MATKEY_COLOR_DIFFUSE, color);
-				//printf("read color:%f,%f,%f", color.r, color.g, color.b);
-				mesh.diffuse_base_color = vec3(color.r, color.g, color.b);
+		}
+	}
+}
+
+void Meshgroup::load_textures_to_gpu() {
+	TextureCache& textures = TextureCache::main();
+
+	// upload in completion order while the rest keep decoding
+	if (texture_decoder && texture_decoder->size() > 0) {
+		std::vector<size_t> finished;
+		bool pending = true;
+		while (pending) {
+			finished.clear();
+			pending = texture_decoder->poll(finished, true);
+			for (size_t f = 0; f < finished.size(); ++f) {
+				const TextureDecoder::Job& job = texture_decoder->job(finished[f]);
+				size_t id = texture_jobs[finished[f]];
+				textures.set_image(id, job.image_data, job.x, job.y, job.n, job.ok);
+				textures.upload(id);
 			}
 		}
+		texture_decoder->print_timings();
+	}
+	texture_decoder.reset();
+	texture_jobs.clear();
+
+	// anything not decoded here was already in the cache
+	for (size_t m = 0; m < meshes.size(); ++m) {
+		Mesh& mesh = meshes[m];
+		mesh.dmap_tex = textures.upload(mesh.diffuse_texture);
+		if (!mesh.dmap_tex) {
+			mesh.dmap_tex = textures.upload(default_diffuse);
+		}
+		mesh.nmap_tex = textures.upload(mesh.normal_texture);
+		if (!mesh.nmap_tex) {
+			mesh.nmap_tex = textures.upload(default_normal);
+		}
 	}
+	textures.print_report();
+}
 
-	size_t nodeSize = getNodeHierarchySize(aiRootNode);
-	nodes.resize(nodeSize);
-	names.resize(nodeSize);
-	for (size_t i = 0; i < nodeSize; ++i) {
-		nodes[i].init();
+void Meshgroup::unload_textures() {
+	TextureCache& textures = TextureCache::main();
+	for (size_t m = 0; m < meshes.size(); ++m) {
+		Mesh& mesh = meshes[m];
+		textures.release(mesh.diffuse_texture);
+		textures.release(mesh.normal_texture);
+		mesh.dmap_tex = 0;
+		mesh.nmap_tex = 0;
 	}
-	// TODO: evaluate if this is working (it is not)
-	size_t currentSize = 1;
-	getNodeHierarchy(nodes, 0, currentSize, aiRootNode, meshes, names);
-	
-	aiReleaseImport(scene);
+}
 
-	printf("mesh loaded\n");
+void Meshgroup::print_vertex_cache_stats() const {
+	printf("vertex cache (FIFO %d)   ACMR before  after   ATVR before  after\n", VERTEX_CACHE_SIZE);
+	for (size_t m = 0; m < meshes.size(); ++m) {
+		const Mesh& mesh = meshes[m];
+		printf("  mesh %-3zu %8d tris     %6.3f %6.3f        %6.3f %6.3f\n", m, mesh.face_count,
+			mesh.cache_stats_before.acmr, mesh.cache_stats_after.acmr,
+			mesh.cache_stats_before.atvr, mesh.cache_stats_after.atvr);
+	}
+}
 
-	return true;
+void Meshgroup::Mesh::optimize() {
+	if (faces_indices == nullptr || index_count == 0) {
+		return;
+	}
+	size_t count = (size_t)index_count;
+	size_t vertices = (size_t)vertex_count;
+	cache_stats_before = analyze_vertex_cache(faces_indices, count, vertices);
+
+	std::vector<GLuint> reordered(count);
+	optimize_vertex_cache(faces_indices, count, vertices, &reordered[0]);
+	memcpy(faces_indices, &reordered[0], count * sizeof(GLuint));
+
+	std::vector<uint32_t> remap;
+	optimize_vertex_fetch(faces_indices, count, vertices, remap);
+	remap_vertex_stream(vp, 3, remap);
+	remap_vertex_stream(vn, 3, remap);
+	remap_vertex_stream(vtans, 4, remap);
+	for (size_t j = 0; j < uvs.size(); ++j) {
+		remap_vertex_stream(uvs[j], 2, remap);
+	}
+	remap_vertex_stream(bone_ids, 4, remap);
+	remap_vertex_stream(bone_weights, 4, remap);
+
+	cache_stats_after = analyze_vertex_cache(faces_indices, count, vertices);
 }
 
-void Meshgroup::load_default_textures() {
-	load_image_data(DMAP_IMG_FILE, &default_diffuse.image_data, default_diffuse.x, default_diffuse.y, default_diffuse.n);
-	load_image_data(NMAP_IMG_FILE, &default_normal.image_data, default_normal.x, default_normal.y, default_normal.n);
+void Meshgroup::Mesh::compute_bounds() {
+	local_aabb = compute_aabb(vp, vp ? (size_t)vertex_count : 0);
+	local_sphere = compute_bounding_sphere(vp, vp ? (size_t)vertex_count : 0, local_aabb);
 }
 
-void Meshgroup::Mesh::load_geometry_to_gpu() {
+void Meshgroup::Mesh::build_triangle_bvh() {
+	triangle_bvh.build(vp, vp ? (size_t)vertex_count : 0, faces_indices, faces_indices ? (size_t)index_count : 0);
+}
 
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+bool Meshgroup::Mesh::raycast(const mat4& worldInverse, const vec3& origin, const vec3& direction, float max_distance,
+	TriangleHit* hit) const {
+	return raycast_mesh_space(triangle_bvh, worldInverse, origin, direction, max_distance, hit);
+}
+
+void Meshgroup::load_default_textures() {
+	// held for the whole run, decoded and uploaded with the first group that uses them
+	TextureCache& textures = TextureCache::main();
+	default_diffuse = textures.acquire(DMAP_IMG_FILE, true);
+	default_normal = textures.acquire(NMAP_IMG_FILE, true);
+}
+
+void Meshgroup::Mesh::load_separate_buffers() {
 
 	size_t attribIx = 0;
 
@@ -385,6 +648,7 @@ void Meshgroup::Mesh::load_geometry_to_gpu() {
 		glGenBuffers(1, &points_vbo);
 		glBindBuffer(GL_ARRAY_BUFFER, points_vbo);
 		glBufferData(GL_ARRAY_BUFFER, 3 * vertex_count * sizeof(GLfloat), vp, GL_STATIC_DRAW);
+		vertex_bytes += 3 * vertex_count * sizeof(GLfloat);
 		glEnableVertexAttribArray(attribIx);
 		glVertexAttribPointer(attribIx, 3, GL_FLOAT, GL_FALSE, 0, NULL);
 	}
@@ -395,6 +659,7 @@ void Meshgroup::Mesh::load_geometry_to_gpu() {
 		glGenBuffers(1, &normals_vbo);
 		glBindBuffer(GL_ARRAY_BUFFER, normals_vbo);
 		glBufferData(GL_ARRAY_BUFFER, 3 * vertex_count * sizeof(GLfloat), vn, GL_STATIC_DRAW);
+		vertex_bytes += 3 * vertex_count * sizeof(GLfloat);
 		glEnableVertexAttribArray(attribIx);
 		glVertexAttribPointer(attribIx, 3, GL_FLOAT, GL_FALSE, 0, NULL);
 	}
@@ -408,6 +673,7 @@ void Meshgroup::Mesh::load_geometry_to_gpu() {
 			glGenBuffers(1, &uvs_vbos[j]);
 			glBindBuffer(GL_ARRAY_BUFFER, uvs_vbos[j]);
 			glBufferData(GL_ARRAY_BUFFER, 2 * vertex_count * sizeof(GLfloat), uvs[j], GL_STATIC_DRAW);
+			vertex_bytes += 2 * vertex_count * sizeof(GLfloat);
 			glEnableVertexAttribArray(attribIx);
 			glVertexAttribPointer(attribIx, 2, GL_FLOAT, GL_FALSE, 0, NULL);
 		}
@@ -418,39 +684,139 @@ void Meshgroup::Mesh::load_geometry_to_gpu() {
 		glGenBuffers(1, &tangents_vbo);
 		glBindBuffer(GL_ARRAY_BUFFER, tangents_vbo);
 		glBufferData(GL_ARRAY_BUFFER, 4 * vertex_count * sizeof(GLfloat), vtans, GL_STATIC_DRAW);
+		vertex_bytes += 4 * vertex_count * sizeof(GLfloat);
 		glEnableVertexAttribArray(attribIx);
 		glVertexAttribPointer(attribIx, 4, GL_FLOAT, GL_FALSE, 0, NULL);
 	}
 	++attribIx;
+}
+
+// same buffers whatever the layout, after the attributes of load_separate_buffers()
+// and of the instance data InstancedRenderer adds at 5 to 9
+void Meshgroup::Mesh::load_bone_buffers() {
+	glGenBuffers(1, &bone_ids_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, bone_ids_vbo);
+	glBufferData(GL_ARRAY_BUFFER, 4 * vertex_count * sizeof(uint8_t), bone_ids, GL_STATIC_DRAW);
+	vertex_bytes += 4 * vertex_count * sizeof(uint8_t);
+	glEnableVertexAttribArray(10);
+	glVertexAttribIPointer(10, 4, GL_UNSIGNED_BYTE, 0, NULL);
+
+	glGenBuffers(1, &bone_weights_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, bone_weights_vbo);
+	glBufferData(GL_ARRAY_BUFFER, 4 * vertex_count * sizeof(GLfloat), bone_weights, GL_STATIC_DRAW);
+	vertex_bytes += 4 * vertex_count * sizeof(GLfloat);
+	glEnableVertexAttribArray(11);
+	glVertexAttribPointer(11, 4, GL_FLOAT, GL_FALSE, 0, NULL);
+
+	glGenBuffers(1, &bone_palette_ubo);
+	glBindBuffer(GL_UNIFORM_BUFFER, bone_palette_ubo);
+	glBufferData(GL_UNIFORM_BUFFER, MaxBones * sizeof(mat4), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+bool Meshgroup::Mesh::skinned() const {
+	return bone_ids != nullptr && bone_weights != nullptr && !bones.empty();
+}
+
+void Meshgroup::Mesh::compute_bone_palette(std::vector<mat4>& palette) const {
+	assert(node != nullptr);
+	const mat4& mesh_inverse = node->worldInverseMatrix();
+	palette.resize(bones.size());
+	for (size_t b = 0; b < bones.size(); ++b) {
+		palette[b] = mesh_inverse * bones[b].node->worldMatrix() * bones[b].offset;
+	}
+}
+
+void Meshgroup::Mesh::load_bone_palette(const std::vector<mat4>& palette) const {
+	assert(palette.size() <= (size_t)MaxBones);
+	// the whole block stays bound, a fresh store keeps the driver from
+	// waiting on the last draw that read it. Bones past the palette are
+	// never indexed
+	glBindBufferBase(GL_UNIFORM_BUFFER, BonePaletteBinding, bone_palette_ubo);
+	glBufferData(GL_UNIFORM_BUFFER, MaxBones * sizeof(mat4), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, palette.size() * sizeof(mat4), palette.data());
+}
+
+void Meshgroup::Mesh::load_geometry_to_gpu(VertexLayout layout) {
+
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
 
+	position_offset = vec3(0.f, 0.f, 0.f);
+	position_scale = vec3(1.f, 1.f, 1.f);
+	octahedral_normals = false;
+	vertex_bytes = 0;
+
+	VertexStreams streams;
+	streams.positions = vp;
+	streams.normals = vn;
+	streams.tangents = vtans;
+	streams.uvs[0] = uvs.size() > 0 ? uvs[0] : nullptr;
+	streams.uvs[1] = uvs.size() > 1 ? uvs[1] : nullptr;
+	streams.count = (size_t)vertex_count;
+
+	if (layout != SeparateFloat && NULL != vp) {
+		octahedral_normals = true;
+		glGenBuffers(1, &vertices_vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, vertices_vbo);
+		if (layout == InterleavedQuantized) {
+			std::vector<QuantizedVertex> vertices;
+			pack_vertices(streams, vertices, position_offset, position_scale);
+			vertex_bytes = vertices.size() * sizeof(QuantizedVertex);
+			glBufferData(GL_ARRAY_BUFFER, vertex_bytes, vertices.data(), GL_STATIC_DRAW);
+			setup_interleaved_attributes<QuantizedVertex>(*this, GL_UNSIGNED_SHORT, GL_TRUE);
+		}
+		else {
+			std::vector<PackedVertex> vertices;
+			pack_vertices(streams, vertices);
+			vertex_bytes = vertices.size() * sizeof(PackedVertex);
+			glBufferData(GL_ARRAY_BUFFER, vertex_bytes, vertices.data(), GL_STATIC_DRAW);
+			setup_interleaved_attributes<PackedVertex>(*this, GL_FLOAT, GL_FALSE);
+		}
+	}
+	else {
+		load_separate_buffers();
+	}
+	if (skinned()) {
+		load_bone_buffers();
+	}
+
+	index_type = GL_UNSIGNED_INT;
 	if (faces_indices != nullptr) {
 		glGenBuffers(1, &faces_vbo);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, faces_vbo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint)*index_count, &faces_indices[0], GL_STATIC_DRAW);
+		if (vertex_count < 65536) {
+			std::vector<GLushort> short_indices(faces_indices, faces_indices + index_count);
+			index_type = GL_UNSIGNED_SHORT;
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort)*index_count, &short_indices[0], GL_STATIC_DRAW);
+		}
+		else {
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint)*index_count, &faces_indices[0], GL_STATIC_DRAW);
+		}
 	}
 	glBindVertexArray(0);
 }
 
-void Meshgroup::Mesh::load_textures_to_gpu() 
-{
-	load_texture_to_gpu(diffuse.image_data, &dmap_tex, diffuse.x, diffuse.y, diffuse.n);
-	load_texture_to_gpu(normal.image_data, &nmap_tex, normal.x, normal.y, normal.n);
-}
-
-void Meshgroup::load_to_gpu() {
+void Meshgroup::load_to_gpu(VertexLayout layout) {
 
+	size_t vertex_bytes = 0;
+	size_t float_bytes = 0;
 	for (unsigned m = 0; m < meshes.size(); ++m) {
 		Mesh& mesh= meshes[m];
-		mesh.load_geometry_to_gpu();
+		mesh.load_geometry_to_gpu(layout);
+		vertex_bytes += mesh.vertex_bytes;
+		size_t floats = (mesh.vp ? 3 : 0) + (mesh.vn ? 3 : 0) + (mesh.vtans ? 4 : 0) + 2 * std::min<size_t>(mesh.uvs.size(), 2);
+		float_bytes += floats * sizeof(GLfloat) * mesh.vertex_count;
+		if (mesh.skinned()) {
+			float_bytes += 4 * (sizeof(uint8_t) + sizeof(GLfloat)) * mesh.vertex_count;
+		}
 	}
+	printf("vertex data: %zu bytes, %zu as separate floats\n", vertex_bytes, float_bytes);
 
-	for (unsigned m = 0; m < meshes.size(); ++m) {
-		Mesh& mesh= meshes[m];
-		mesh.load_textures_to_gpu();
-	}
+	load_textures_to_gpu();
 }
 
-void Meshgroup::get_shader_uniforms(GLuint shader_programme) 
+void Meshgroup::get_shader_uniforms(const ShaderProgram& shader_programme) 
 {
 	for (size_t i = 0; i < meshes.size(); ++i) {
 		Mesh& mesh= meshes[i];
@@ -458,60 +824,65 @@ void Meshgroup::get_shader_uniforms(GLuint shader_programme)
 	}
 }
 
-void Meshgroup::set_shader_uniforms(GLuint shader_programme /*, const mat4& modelMatrix*/, const vec3& ambient_color) 
-{
-	for (size_t i = 0; i < meshes.size(); ++i) {
-		Mesh& mesh = meshes[i];
-		mesh.set_shader_uniforms(shader_programme, ambient_color);
+void Meshgroup::Mesh::get_shader_uniforms(const ShaderProgram& shader_programme) {
+
+	normal_map_location = shader_programme.uniform_location( "normal_map" );
+	diffuse_map_location = shader_programme.uniform_location( "diffuse_map" );
+	model_matrix_location = shader_programme.uniform_location( "model" );
+	diffuse_base_color_location = shader_programme.uniform_location( "diffuse_base_color" );
+	position_offset_location = shader_programme.uniform_location( "position_offset" );
+	position_scale_location = shader_programme.uniform_location( "position_scale" );
+	octahedral_normals_location = shader_programme.uniform_location( "octahedral_normals" );
+	skinned_location = shader_programme.uniform_location( "skinned" );
+	const ShaderProgram::Block* palette_block = shader_programme.find_block( "BonePalette" );
+	if (palette_block) {
+		assert(palette_block->data_size == (GLint)(MaxBones * sizeof(mat4)));
+		shader_programme.bind_block( "BonePalette", BonePaletteBinding );
 	}
-	//transform = modelMatrix;
-}
-
-void Meshgroup::Mesh::get_shader_uniforms(GLuint shader_programme) {
-
-	normal_map_location = glGetUniformLocation( shader_programme, "normal_map" );
-	diffuse_map_location = glGetUniformLocation( shader_programme, "diffuse_map" );
-	model_matrix_location = glGetUniformLocation( shader_programme, "model" );
-	diffuse_base_color_location = glGetUniformLocation( shader_programme, "diffuse_base_color" );
-	ambient_color_location = glGetUniformLocation( shader_programme, "ambient_color" );
-}
-
-void Meshgroup::Mesh::set_shader_uniforms(GLuint shader_programme, const vec3& ambient_color) {
-	glUniform3fv( ambient_color_location, 1, &ambient_color.v[0] );
 }
 
-void Meshgroup::Mesh::render(GLuint shader_programme) 
+void Meshgroup::Mesh::render(const ShaderProgram& shader_programme) 
 {
 	assert(node != nullptr);
 
-	mat4& modelMat = (*node).worldMatrix;
+	const mat4& modelMat = (*node).worldMatrix();
 	render(shader_programme, modelMat, diffuse_base_color);
 }
 
-void Meshgroup::Mesh::render(GLuint shader_programme, const mat4& worldMatrix, const vec3& diffuseColor) 
+void Meshgroup::Mesh::render(const ShaderProgram& shader_programme, const mat4& worldMatrix, const vec3& diffuseColor) 
 {
 	assert(node != nullptr);
 
-	glUniformMatrix4fv(model_matrix_location, 1, GL_FALSE, worldMatrix.m);
+	shader_programme.set(model_matrix_location, worldMatrix);
 
-	glUniform3fv(diffuse_base_color_location, 1, &diffuseColor.v[0]);
+	shader_programme.set(diffuse_base_color_location, diffuseColor);
+
+	shader_programme.set(position_offset_location, position_offset);
+	shader_programme.set(position_scale_location, position_scale);
+	shader_programme.set(octahedral_normals_location, octahedral_normals ? 1 : 0);
+
+	shader_programme.set(skinned_location, skinned() ? 1 : 0);
+	if (skinned()) {
+		compute_bone_palette(bone_palette);
+		load_bone_palette(bone_palette);
+	}
 
-	glUniform1i( normal_map_location, 0 );
+	shader_programme.set( normal_map_location, 0 );
 	glActiveTexture( GL_TEXTURE0 );
 	glBindTexture( GL_TEXTURE_2D, nmap_tex);
 	
-	glUniform1i( diffuse_map_location, 1 );
+	shader_programme.set( diffuse_map_location, 1 );
 	glActiveTexture( GL_TEXTURE1 );
 	glBindTexture( GL_TEXTURE_2D, dmap_tex);
 
 	glBindVertexArray(vao);
 	//glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.faces_vbo);
 
-	glDrawElements(GL_TRIANGLES, index_count, GL_UNSIGNED_INT, 0);
+	glDrawElements(GL_TRIANGLES, index_count, index_type, 0);
 	glBindVertexArray(0);
 }
 
-void Meshgroup::render(GLuint shader_programme)
+void Meshgroup::render(const ShaderProgram& shader_programme)
 {
 	for (size_t i = 0; i < meshes.size(); ++i) {
 
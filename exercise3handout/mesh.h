@@ -1,32 +1,64 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 #include <string>
+#include "animation.h"
+#include "bounds.h"
 #include "node.h"
 #include "maths_funcs.h"
+#include "mesh_cache.h"
+#include "mesh_optimize.h"
+#include "shader_program.h"
+#include "texture_decoder.h"
+#include "triangle_bvh.h"
 #include <GL/Glew.h>
 
 struct Meshgroup {
 
 	// geometry
 
-	// shader 
-	struct Texture {
-		unsigned char* image_data;
-		int x, y, n;
+	// how load_to_gpu() lays out the vertex data, see vertex_packing.h
+	enum VertexLayout {
+		SeparateFloat,        // one float VBO per attribute
+		Interleaved,          // one VBO: float positions, octahedral normals, 10:10:10:2 tangents, half uvs
+		InterleavedQuantized, // as Interleaved with unorm16 positions inside the mesh bounds
 	};
 
+	// shader 
+
 	struct Mesh {
 
+		// size of the BonePalette block in test_vs.glsl, meshes with more bones are drawn unskinned
+		static const int MaxBones = 64;
+		// binding point of the BonePalette block, Camera::BlockBinding is 0
+		static const GLuint BonePaletteBinding = 1;
+
+		// a bone takes mesh space to the space of the node that moves it
+		struct Bone {
+			Node* node;
+			mat4 offset;
+		};
+
 		GLfloat *vp; // array of vertex points
 		GLfloat *vn; // array of vertex normals
 		GLfloat *vc; // array of vertex colors 
 		GLfloat *vtans;
 		std::vector<GLfloat *> uvs;
 		GLuint *faces_indices;
-
-		Texture diffuse;
-		Texture normal;
+		// up to 4 bones per vertex, the weights sum to 1. null when not skinned
+		uint8_t *bone_ids;
+		GLfloat *bone_weights;
+		std::vector<Bone> bones;
+		// scratch for the palette render() uploads
+		std::vector<mat4> bone_palette;
+
+		// material texture paths, empty when the default texture is used
+		std::string diffuse_path;
+		std::string normal_path;
+		// TextureCache ids, the default maps included
+		size_t diffuse_texture;
+		size_t normal_texture;
 
 		GLuint vao;
 		GLuint points_vbo;
@@ -34,12 +66,34 @@ struct Meshgroup {
 		std::vector<GLuint> uvs_vbos;
 		GLuint tangents_vbo;
 		GLuint faces_vbo;
+		GLuint vertices_vbo; // interleaved layouts only
+		GLuint bone_ids_vbo;
+		GLuint bone_weights_vbo;
+		GLuint bone_palette_ubo; // room for MaxBones matrices
+
+		// vertex decode parameters for the shader
+		vec3 position_offset;
+		vec3 position_scale;
+		bool octahedral_normals;
+		// bytes uploaded for the vertex attributes
+		size_t vertex_bytes;
 
 		int vertex_count;
 		int face_count;
 		int index_count;
+		GLenum index_type; // GL_UNSIGNED_SHORT when every vertex fits in 16 bits
 		unsigned int MaterialIndex;
 
+		// bounds of vp in mesh space, see compute_bounds()
+		AABB local_aabb;
+		BoundingSphere local_sphere;
+		// triangles of vp for picking, see build_triangle_bvh(). both are of
+		// the bind pose when the mesh is skinned
+		TriangleBVH triangle_bvh;
+
+		VertexCacheStats cache_stats_before;
+		VertexCacheStats cache_stats_after;
+
 		GLuint nmap_tex;
 		GLuint dmap_tex;
 
@@ -47,34 +101,70 @@ struct Meshgroup {
 
 		Node* node;
 		
-		void load_geometry_to_gpu() ;
-		void load_textures_to_gpu() ;
-
-		void get_shader_uniforms(GLuint shader_programme);
-		void set_shader_uniforms(GLuint shader_programme /*, const mat4& modelMatrix*/, const vec3& ambient_color);
-		void render(GLuint shader_programme);
-		void render(GLuint shader_programme, const mat4& worldMatrix, const vec3& diffuseColor);
+		// reorders triangles and vertices for the vertex cache and fetch, at import
+		void optimize() ;
+		void compute_bounds() ;
+		void build_triangle_bvh() ;
+		// closest triangle along a world space ray, tested in mesh space:
+		// the ray is moved by the node's world inverse, so with a unit
+		// direction the hit distance stays in world units
+		bool raycast(const mat4& worldInverse, const vec3& origin, const vec3& direction, float max_distance,
+			TriangleHit* hit) const;
+		void load_geometry_to_gpu(VertexLayout layout = SeparateFloat) ;
+		void load_separate_buffers() ;
+		void load_bone_buffers() ;
+
+		bool skinned() const;
+		// bind pose to animated pose of every bone, in mesh space so the
+		// model matrix still applies on top. needs an updated hierarchy
+		void compute_bone_palette(std::vector<mat4>& palette) const;
+		// refills bone_palette_ubo and binds it to BonePaletteBinding for the next draw
+		void load_bone_palette(const std::vector<mat4>& palette) const;
+
+		void get_shader_uniforms(const ShaderProgram& shader_programme);
+		void render(const ShaderProgram& shader_programme);
+		void render(const ShaderProgram& shader_programme, const mat4& worldMatrix, const vec3& diffuseColor);
 
 		int model_matrix_location;
 		int normal_map_location;
 		int diffuse_map_location;
 		int diffuse_base_color_location;
-		int ambient_color_location;
+		int position_offset_location;
+		int position_scale_location;
+		int octahedral_normals_location;
+		int skinned_location;
 	};
 
 	std::vector<Mesh> meshes;
 	std::vector<Node> nodes;
 	std::vector<std::string> names;
+	// channels refer to nodes by index
+	std::vector<AnimationClip> clips;
 
+	// backs the mesh arrays when they were loaded from a cache file
+	MappedFile cache;
+	// textures decoding between load_from_file() and load_to_gpu()
+	std::unique_ptr<TextureDecoder> texture_decoder;
+	// TextureCache id of every decoder job
+	std::vector<size_t> texture_jobs;
 
 	static void load_default_textures() ;
 
+	// uses file_name + MESH_CACHE_EXT when it is up to date, otherwise
+	// imports with assimp and writes that cache for the next run
 	bool load_from_file( const char* file_name, int index = 0) ;
-	void load_to_gpu() ;
-
-	void get_shader_uniforms(GLuint shader_programme);
-	void set_shader_uniforms(GLuint shader_programme /*, const mat4& modelMatrix*/, const vec3& ambient_color);
+	bool load_cache(const char* cache_name, const char* file_name);
+	// skinned and animated groups are not cached, always re-imported
+	bool write_cache(const char* cache_name, const char* file_name) const;
+	void start_texture_decoding();
+	void load_textures_to_gpu();
+	// drops this group's references in the TextureCache, needs the GL context
+	void unload_textures();
+	void print_vertex_cache_stats() const;
+	void load_to_gpu(VertexLayout layout = SeparateFloat) ;
+
+	void get_shader_uniforms(const ShaderProgram& shader_programme);
 	
-	void render(GLuint shader_programme);
+	void render(const ShaderProgram& shader_programme);
 };
 
@@ -0,0 +1,392 @@
+#include "mesh_cache.h"
+#include "mesh.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined(WIN32) || defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/*--------------------------------MAPPED FILE---------------------------------*/
+MappedFile::MappedFile()
+	:data(nullptr)
+	,size(0)
+#if defined(WIN32) || defined(_WIN32)
+	,file(INVALID_HANDLE_VALUE)
+	,mapping(nullptr)
+#endif
+{ ; }
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+#if defined(WIN32) || defined(_WIN32)
+
+bool MappedFile::open(const char* file_name) {
+	close();
+	file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		close();
+		return false;
+	}
+	mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if (!mapping) {
+		close();
+		return false;
+	}
+	data = (unsigned char*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	if (!data) {
+		close();
+		return false;
+	}
+	size = (size_t)file_size.QuadPart;
+	return true;
+}
+
+void MappedFile::close() {
+	if (data) {
+		UnmapViewOfFile(data);
+	}
+	if (mapping) {
+		CloseHandle(mapping);
+	}
+	if (file != INVALID_HANDLE_VALUE) {
+		CloseHandle(file);
+	}
+	data = nullptr;
+	size = 0;
+	mapping = nullptr;
+	file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::open(const char* file_name) {
+	close();
+	int fd = ::open(file_name, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+	void* ptr = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	// the mapping keeps its own reference to the file
+	::close(fd);
+	if (ptr == MAP_FAILED) {
+		return false;
+	}
+	data = (unsigned char*)ptr;
+	size = (size_t)st.st_size;
+	return true;
+}
+
+void MappedFile::close() {
+	if (data) {
+		munmap(data, size);
+	}
+	data = nullptr;
+	size = 0;
+}
+
+#endif
+
+/*-----------------------------------WRITER-----------------------------------*/
+namespace {
+
+	bool get_source_stamp(const char* file_name, uint64_t& size, int64_t& time) {
+		struct stat st;
+		if (stat(file_name, &st) != 0) {
+			return false;
+		}
+		size = (uint64_t)st.st_size;
+		time = (int64_t)st.st_mtime;
+		return true;
+	}
+
+	struct Blob {
+		std::vector<unsigned char> bytes;
+
+		// appends at a 16 byte boundary and returns the offset, 0 for no data
+		uint64_t append(const void* data, size_t size) {
+			if (data == nullptr || size == 0) {
+				return 0;
+			}
+			size_t offset = (bytes.size() + 15) & ~(size_t)15;
+			bytes.resize(offset + size);
+			memcpy(&bytes[offset], data, size);
+			return offset;
+		}
+
+		uint64_t append_string(const std::string& s) {
+			return s.empty() ? 0 : append(s.c_str(), s.size() + 1);
+		}
+	};
+
+	// a zero-terminated string at offset, or "" if it runs out of the file
+	const char* cache_string(const MappedFile& file, uint64_t offset) {
+		if (offset == 0 || offset >= file.size) {
+			return "";
+		}
+		const char* s = (const char*)file.data + offset;
+		if (!memchr(s, 0, file.size - (size_t)offset)) {
+			return "";
+		}
+		return s;
+	}
+
+	// pointer to count Ts at offset, nullptr if absent or out of range
+	template <typename T>
+	T* cache_array(const MappedFile& file, uint64_t offset, size_t count) {
+		if (offset == 0 || offset > file.size || count > (file.size - (size_t)offset) / sizeof(T)) {
+			return nullptr;
+		}
+		return (T*)(file.data + offset);
+	}
+
+	// an array that is present but runs out of the file, as a write cut
+	// short leaves it, makes the whole cache invalid
+	template <typename T>
+	bool cache_array_fits(const MappedFile& file, uint64_t offset, size_t count) {
+		return offset == 0 || count == 0 || cache_array<T>(file, offset, count) != nullptr;
+	}
+
+	bool cache_string_fits(const MappedFile& file, uint64_t offset) {
+		return offset == 0 || (offset < file.size && memchr(file.data + offset, 0, file.size - (size_t)offset));
+	}
+
+	bool cache_mesh_fits(const MappedFile& file, const CacheMesh& cm) {
+		if (cm.vertexCount < 0 || cm.faceCount < 0 || cm.indexCount < 0 || cm.uvCount > MESH_CACHE_MAX_UVS) {
+			return false;
+		}
+		size_t vertex_count = (size_t)cm.vertexCount;
+		bool fits = cache_array_fits<float>(file, cm.positions, vertex_count * 3) &&
+			cache_array_fits<float>(file, cm.normals, vertex_count * 3) &&
+			cache_array_fits<float>(file, cm.tangents, vertex_count * 4) &&
+			cache_array_fits<uint32_t>(file, cm.indices, (size_t)cm.indexCount);
+		fits = fits && cache_string_fits(file, cm.diffusePath) && cache_string_fits(file, cm.normalPath);
+		for (uint32_t j = 0; j < cm.uvCount && fits; ++j) {
+			fits = cache_array_fits<float>(file, cm.uvs[j], vertex_count * 2);
+		}
+		// a mesh with triangles needs the vertices and indices they refer to
+		if (cm.indexCount > 0 && (cm.positions == 0 || cm.indices == 0)) {
+			fits = false;
+		}
+		return fits;
+	}
+
+	// replaces the old file only once the new one is complete, a crash
+	// mid-write leaves the old cache or none, never a truncated one
+	bool replace_file(const char* temp_name, const char* file_name) {
+#if defined(WIN32) || defined(_WIN32)
+		return MoveFileExA(temp_name, file_name, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		return rename(temp_name, file_name) == 0;
+#endif
+	}
+}
+
+bool Meshgroup::write_cache(const char* cache_name, const char* file_name) const {
+	// the layout has no bones or clips, a cache would load back without them
+	bool animated = !clips.empty();
+	for (size_t m = 0; m < meshes.size() && !animated; ++m) {
+		animated = meshes[m].skinned();
+	}
+	if (animated) {
+		printf("mesh %s is skinned or animated, not cached\n", file_name);
+		return false;
+	}
+
+	CacheHeader header;
+	memcpy(header.magic, "MSHC", 4);
+	header.version = MESH_CACHE_VERSION;
+	header.meshCount = (uint32_t)meshes.size();
+	header.nodeCount = (uint32_t)nodes.size();
+	if (!get_source_stamp(file_name, header.sourceSize, header.sourceTime)) {
+		return false;
+	}
+
+	Blob blob;
+	blob.append(&header, sizeof(header));
+	size_t meshes_offset = (size_t)blob.append(std::vector<CacheMesh>(meshes.size()).data(), meshes.size() * sizeof(CacheMesh));
+	size_t nodes_offset = (size_t)blob.append(std::vector<CacheNode>(nodes.size()).data(), nodes.size() * sizeof(CacheNode));
+
+	std::vector<CacheMesh> cache_meshes(meshes.size());
+	for (size_t m = 0; m < meshes.size(); ++m) {
+		const Mesh& mesh = meshes[m];
+		CacheMesh& cm = cache_meshes[m];
+		memset(&cm, 0, sizeof(cm));
+
+		cm.vertexCount = mesh.vertex_count;
+		cm.faceCount = mesh.face_count;
+		cm.indexCount = mesh.index_count;
+		cm.materialIndex = mesh.MaterialIndex;
+		cm.node = mesh.node ? (int32_t)(mesh.node - &nodes[0]) : -1;
+		cm.uvCount = (uint32_t)std::min<size_t>(mesh.uvs.size(), MESH_CACHE_MAX_UVS);
+		memcpy(cm.diffuseBaseColor, mesh.diffuse_base_color.v, sizeof(cm.diffuseBaseColor));
+		cm.acmrBefore = mesh.cache_stats_before.acmr;
+		cm.atvrBefore = mesh.cache_stats_before.atvr;
+		cm.acmrAfter = mesh.cache_stats_after.acmr;
+		cm.atvrAfter = mesh.cache_stats_after.atvr;
+
+		size_t vertex_count = (size_t)mesh.vertex_count;
+		cm.positions = blob.append(mesh.vp, vertex_count * 3 * sizeof(GLfloat));
+		cm.normals = blob.append(mesh.vn, vertex_count * 3 * sizeof(GLfloat));
+		cm.tangents = blob.append(mesh.vtans, vertex_count * 4 * sizeof(GLfloat));
+		for (uint32_t j = 0; j < cm.uvCount; ++j) {
+			cm.uvs[j] = blob.append(mesh.uvs[j], vertex_count * 2 * sizeof(GLfloat));
+		}
+		cm.indices = blob.append(mesh.faces_indices, (size_t)mesh.index_count * sizeof(GLuint));
+
+		cm.diffusePath = blob.append_string(mesh.diffuse_path);
+		cm.normalPath = blob.append_string(mesh.normal_path);
+	}
+
+	std::vector<CacheNode> cache_nodes(nodes.size());
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		const Node& node = nodes[i];
+		CacheNode& cn = cache_nodes[i];
+		memset(&cn, 0, sizeof(cn));
+
+		// right after import the root has no parent and every other parent
+		// is one of our own nodes
+		const Node* parent = node.parent();
+		cn.parent = parent ? (int32_t)(parent - &nodes[0]) : -1;
+		memcpy(cn.position, node.position().v, sizeof(cn.position));
+		memcpy(cn.rotation, node.rotation().q, sizeof(cn.rotation));
+		memcpy(cn.scale, node.scale().v, sizeof(cn.scale));
+		cn.name = blob.append_string(names[i]);
+	}
+
+	if (!cache_meshes.empty()) {
+		memcpy(&blob.bytes[meshes_offset], &cache_meshes[0], cache_meshes.size() * sizeof(CacheMesh));
+	}
+	if (!cache_nodes.empty()) {
+		memcpy(&blob.bytes[nodes_offset], &cache_nodes[0], cache_nodes.size() * sizeof(CacheNode));
+	}
+
+	std::string temp_name = std::string(cache_name) + ".tmp";
+	FILE* file = fopen(temp_name.c_str(), "wb");
+	if (!file) {
+		fprintf(stderr, "WARNING: could not write mesh cache %s\n", cache_name);
+		return false;
+	}
+	size_t written = fwrite(&blob.bytes[0], 1, blob.bytes.size(), file);
+	bool closed = fclose(file) == 0;
+	if (written != blob.bytes.size() || !closed || !replace_file(temp_name.c_str(), cache_name)) {
+		fprintf(stderr, "WARNING: could not write mesh cache %s\n", cache_name);
+		remove(temp_name.c_str());
+		return false;
+	}
+	printf("mesh cache written to %s (%zu bytes)\n", cache_name, blob.bytes.size());
+	return true;
+}
+
+/*-----------------------------------READER-----------------------------------*/
+bool Meshgroup::load_cache(const char* cache_name, const char* file_name) {
+	if (!cache.open(cache_name)) {
+		return false;
+	}
+	const CacheHeader* header = cache.size >= sizeof(CacheHeader) ? (const CacheHeader*)cache.data : nullptr;
+
+	uint64_t source_size = 0;
+	int64_t source_time = 0;
+	bool source_found = get_source_stamp(file_name, source_size, source_time);
+	bool valid = header && memcmp(header->magic, "MSHC", 4) == 0 && header->version == MESH_CACHE_VERSION &&
+		// without the source we trust whatever cache we have
+		(!source_found || (header->sourceSize == source_size && header->sourceTime == source_time));
+
+	const CacheMesh* cache_meshes = nullptr;
+	const CacheNode* cache_nodes = nullptr;
+	if (valid) {
+		size_t meshes_offset = (sizeof(CacheHeader) + 15) & ~(size_t)15;
+		size_t nodes_offset = (meshes_offset + header->meshCount * sizeof(CacheMesh) + 15) & ~(size_t)15;
+		cache_meshes = header->meshCount ? cache_array<CacheMesh>(cache, meshes_offset, header->meshCount) : nullptr;
+		cache_nodes = header->nodeCount ? cache_array<CacheNode>(cache, nodes_offset, header->nodeCount) : nullptr;
+		valid = (cache_meshes || !header->meshCount) && (cache_nodes || !header->nodeCount);
+		for (uint32_t m = 0; m < header->meshCount && valid; ++m) {
+			valid = cache_mesh_fits(cache, cache_meshes[m]);
+		}
+		// the import numbers parents before their children, anything else
+		// could make a parent cycle
+		for (uint32_t n = 0; n < header->nodeCount && valid; ++n) {
+			int32_t parent = cache_nodes[n].parent;
+			valid = cache_string_fits(cache, cache_nodes[n].name) && parent >= -1 && parent < (int64_t)n;
+		}
+	}
+	if (!valid) {
+		printf("mesh cache %s is stale or invalid, re-importing\n", cache_name);
+		cache.close();
+		return false;
+	}
+
+	size_t node_count = header->nodeCount;
+	nodes.clear();
+	nodes.resize(node_count);
+	names.resize(node_count);
+	for (size_t i = 0; i < node_count; ++i) {
+		nodes[i].init();
+	}
+	for (size_t i = 0; i < node_count; ++i) {
+		const CacheNode& cn = cache_nodes[i];
+		Node& node = nodes[i];
+		node.setPosition(vec3(cn.position[0], cn.position[1], cn.position[2]));
+		versor rotation;
+		memcpy(rotation.q, cn.rotation, sizeof(rotation.q));
+		node.setRotation(rotation);
+		node.setScale(vec3(cn.scale[0], cn.scale[1], cn.scale[2]));
+		if (cn.parent >= 0) {
+			nodes[cn.parent].addChild(node);
+		}
+		names[i] = cache_string(cache, cn.name);
+	}
+
+	meshes.resize(header->meshCount);
+	for (size_t m = 0; m < meshes.size(); ++m) {
+		const CacheMesh& cm = cache_meshes[m];
+		Mesh& mesh = meshes[m];
+		size_t vertex_count = (size_t)cm.vertexCount;
+
+		mesh.vertex_count = cm.vertexCount;
+		mesh.face_count = cm.faceCount;
+		mesh.index_count = cm.indexCount;
+		mesh.MaterialIndex = cm.materialIndex;
+		mesh.node = (cm.node >= 0 && (size_t)cm.node < node_count) ? &nodes[cm.node] : nullptr;
+		mesh.diffuse_base_color = vec3(cm.diffuseBaseColor[0], cm.diffuseBaseColor[1], cm.diffuseBaseColor[2]);
+		mesh.cache_stats_before.acmr = cm.acmrBefore;
+		mesh.cache_stats_before.atvr = cm.atvrBefore;
+		mesh.cache_stats_after.acmr = cm.acmrAfter;
+		mesh.cache_stats_after.atvr = cm.atvrAfter;
+
+		// zero copy: the arrays live in the mapping until the group goes away
+		mesh.vp = cache_array<GLfloat>(cache, cm.positions, vertex_count * 3);
+		mesh.vn = cache_array<GLfloat>(cache, cm.normals, vertex_count * 3);
+		mesh.vtans = cache_array<GLfloat>(cache, cm.tangents, vertex_count * 4);
+		mesh.uvs.resize(std::min<uint32_t>(cm.uvCount, MESH_CACHE_MAX_UVS));
+		for (size_t j = 0; j < mesh.uvs.size(); ++j) {
+			mesh.uvs[j] = cache_array<GLfloat>(cache, cm.uvs[j], vertex_count * 2);
+		}
+		mesh.faces_indices = cache_array<GLuint>(cache, cm.indices, (size_t)cm.indexCount);
+
+		mesh.diffuse_path = cache_string(cache, cm.diffusePath);
+		mesh.normal_path = cache_string(cache, cm.normalPath);
+	}
+
+	printf("mesh loaded from cache %s\n", cache_name);
+	return true;
+}
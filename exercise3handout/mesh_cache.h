@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// extension appended to the source file name, "scene.gltf" -> "scene.gltf.meshcache"
+#define MESH_CACHE_EXT ".meshcache"
+// bump whenever the layout below changes, older caches are then re-imported.
+// 3: skinned and animated files are no longer cached, 2 had dropped their bones
+#define MESH_CACHE_VERSION 3
+
+// Read-only view of a whole file through mmap/MapViewOfFile. Pages are
+// copy-on-write, so code that patches a mapped array in place stays safe.
+struct MappedFile {
+	unsigned char* data;
+	size_t size;
+
+	MappedFile();
+	~MappedFile();
+
+	bool open(const char* file_name);
+	void close();
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+#if defined(WIN32) || defined(_WIN32)
+	void* file;
+	void* mapping;
+#endif
+};
+
+/* On-disk layout. Everything is native endian and every array is 16 byte
+aligned so the meshes can point straight into the mapping:
+
+	CacheHeader
+	CacheMesh[meshCount]
+	CacheNode[nodeCount]
+	arrays and zero-terminated strings, referenced by offset from the start
+	of the file. an offset of 0 means "not present"
+*/
+struct CacheHeader {
+	char magic[4]; // "MSHC"
+	uint32_t version;
+	uint32_t meshCount;
+	uint32_t nodeCount;
+	// source file the cache was built from, a mismatch means it is stale
+	uint64_t sourceSize;
+	int64_t sourceTime;
+};
+
+#define MESH_CACHE_MAX_UVS 8
+
+struct CacheMesh {
+	int32_t vertexCount;
+	int32_t faceCount;
+	int32_t indexCount;
+	uint32_t materialIndex;
+	int32_t node; // index into the node table, -1 if none
+	uint32_t uvCount;
+	float diffuseBaseColor[3];
+	uint32_t pad;
+	// vertex cache stats of the source order and of the optimised one
+	float acmrBefore, atvrBefore;
+	float acmrAfter, atvrAfter;
+
+	uint64_t positions; // 3 floats per vertex
+	uint64_t normals;   // 3 floats per vertex
+	uint64_t tangents;  // 4 floats per vertex
+	uint64_t uvs[MESH_CACHE_MAX_UVS]; // 2 floats per vertex
+	uint64_t indices;   // 3 GLuints per face
+
+	uint64_t diffusePath; // material texture paths as found in the source
+	uint64_t normalPath;
+};
+
+struct CacheNode {
+	int32_t parent; // index into the node table, -1 for the root
+	float position[3];
+	float rotation[4]; // w, x, y, z as in versor
+	float scale[3];
+	uint64_t name;
+};
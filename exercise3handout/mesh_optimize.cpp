@@ -0,0 +1,174 @@
+#include "mesh_optimize.h"
+
+#include <string.h>
+
+VertexCacheStats analyze_vertex_cache(const uint32_t* indices, size_t index_count, size_t vertex_count, unsigned cache_size) {
+	// a vertex is cached while fewer than cache_size misses happened since it was loaded
+	std::vector<size_t> loaded_at(vertex_count, 0);
+	std::vector<bool> referenced(vertex_count, false);
+	size_t misses = 0;
+	size_t referenced_count = 0;
+	for (size_t i = 0; i < index_count; ++i) {
+		uint32_t v = indices[i];
+		if (!referenced[v]) {
+			referenced[v] = true;
+			++referenced_count;
+		}
+		if (loaded_at[v] == 0 || misses - loaded_at[v] >= cache_size) {
+			++misses;
+			loaded_at[v] = misses;
+		}
+	}
+
+	VertexCacheStats stats;
+	size_t triangles = index_count / 3;
+	stats.acmr = triangles ? (float)misses / triangles : 0.f;
+	stats.atvr = referenced_count ? (float)misses / referenced_count : 0.f;
+	return stats;
+}
+
+namespace {
+
+	struct Adjacency {
+		std::vector<uint32_t> offsets;   // vertex -> first entry in triangles
+		std::vector<uint32_t> triangles; // triangles around each vertex
+	};
+
+	void build_adjacency(const uint32_t* indices, size_t index_count, size_t vertex_count, Adjacency& adjacency) {
+		adjacency.offsets.assign(vertex_count + 1, 0);
+		for (size_t i = 0; i < index_count; ++i) {
+			++adjacency.offsets[indices[i] + 1];
+		}
+		for (size_t v = 0; v < vertex_count; ++v) {
+			adjacency.offsets[v + 1] += adjacency.offsets[v];
+		}
+		adjacency.triangles.resize(index_count);
+		std::vector<uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+		for (size_t i = 0; i < index_count; ++i) {
+			adjacency.triangles[fill[indices[i]]++] = (uint32_t)(i / 3);
+		}
+	}
+}
+
+void optimize_vertex_cache(const uint32_t* indices, size_t index_count, size_t vertex_count, uint32_t* out, unsigned cache_size) {
+	size_t triangle_count = index_count / 3;
+	if (triangle_count == 0 || vertex_count == 0) {
+		return;
+	}
+
+	Adjacency adjacency;
+	build_adjacency(indices, index_count, vertex_count, adjacency);
+
+	// live triangle count per vertex
+	std::vector<uint32_t> live(vertex_count);
+	for (size_t v = 0; v < vertex_count; ++v) {
+		live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+	}
+
+	std::vector<size_t> cache_time(vertex_count, 0);
+	std::vector<bool> emitted(triangle_count, false);
+	std::vector<uint32_t> dead_end; // recently used vertices, for when a fan runs dry
+	std::vector<uint32_t> candidates;
+
+	size_t timestamp = cache_size + 1;
+	size_t cursor = 0;          // scan position for when the dead end stack is empty too
+	size_t written = 0;
+	int64_t fanning = 0;
+
+	while (fanning >= 0) {
+		candidates.clear();
+
+		uint32_t v = (uint32_t)fanning;
+		for (uint32_t a = adjacency.offsets[v]; a < adjacency.offsets[v + 1]; ++a) {
+			uint32_t t = adjacency.triangles[a];
+			if (emitted[t]) {
+				continue;
+			}
+			for (int k = 0; k < 3; ++k) {
+				uint32_t w = indices[t * 3 + k];
+				out[written++] = w;
+				dead_end.push_back(w);
+				candidates.push_back(w);
+				--live[w];
+				if (timestamp - cache_time[w] > cache_size) {
+					cache_time[w] = timestamp++;
+				}
+			}
+			emitted[t] = true;
+		}
+
+		// the candidate that entered the cache earliest and still stays in it
+		// while its remaining triangles are emitted. one that would drop out
+		// (priority 0) still beats a dead end jump
+		fanning = -1;
+		int64_t best_priority = -1;
+		for (size_t c = 0; c < candidates.size(); ++c) {
+			uint32_t w = candidates[c];
+			if (live[w] == 0) {
+				continue;
+			}
+			int64_t priority = 0;
+			if (timestamp - cache_time[w] + 2 * live[w] <= cache_size) {
+				priority = (int64_t)(timestamp - cache_time[w]);
+			}
+			if (priority > best_priority) {
+				best_priority = priority;
+				fanning = w;
+			}
+		}
+
+		// dead end: most recent vertex with triangles left, else the next one in input order
+		while (fanning < 0 && !dead_end.empty()) {
+			uint32_t w = dead_end.back();
+			dead_end.pop_back();
+			if (live[w] > 0) {
+				fanning = w;
+			}
+		}
+		while (fanning < 0 && cursor < vertex_count) {
+			if (live[cursor] > 0) {
+				fanning = (int64_t)cursor;
+			}
+			++cursor;
+		}
+	}
+}
+
+void optimize_vertex_fetch(uint32_t* indices, size_t index_count, size_t vertex_count, std::vector<uint32_t>& remap) {
+	const uint32_t unused = 0xffffffff;
+	remap.assign(vertex_count, unused);
+	uint32_t next = 0;
+	for (size_t i = 0; i < index_count; ++i) {
+		uint32_t& v = indices[i];
+		if (remap[v] == unused) {
+			remap[v] = next++;
+		}
+		v = remap[v];
+	}
+	for (size_t v = 0; v < vertex_count; ++v) {
+		if (remap[v] == unused) {
+			remap[v] = next++;
+		}
+	}
+}
+
+namespace {
+	template <typename T>
+	void remap_stream(T* data, size_t components, const std::vector<uint32_t>& remap) {
+		if (!data) {
+			return;
+		}
+		std::vector<T> source(data, data + remap.size() * components);
+		for (size_t v = 0; v < remap.size(); ++v) {
+			memcpy(&data[remap[v] * components], &source[v * components], components * sizeof(T));
+		}
+	}
+}
+
+void remap_vertex_stream(float* data, size_t components, const std::vector<uint32_t>& remap) {
+	remap_stream(data, components, remap);
+}
+
+void remap_vertex_stream(uint8_t* data, size_t components, const std::vector<uint32_t>& remap) {
+	remap_stream(data, components, remap);
+}
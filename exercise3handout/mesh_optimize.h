@@ -0,0 +1,32 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Import time index/vertex reordering for the post-transform vertex cache
+// and vertex fetch. GL free, works on plain triangle lists.
+
+// cache size the reordering targets and the stats simulate
+#define VERTEX_CACHE_SIZE 16
+
+struct VertexCacheStats {
+	float acmr; // average cache miss ratio: transformed vertices per triangle, 0.5 is ideal
+	float atvr; // average transform to vertex ratio: transformed per referenced vertex, 1 is ideal
+};
+
+// simulates a FIFO cache of cache_size entries over the index list
+VertexCacheStats analyze_vertex_cache(const uint32_t* indices, size_t index_count, size_t vertex_count, unsigned cache_size = VERTEX_CACHE_SIZE);
+
+// Tipsify (Sander, Nehab, Barczak 2007): fans around a vertex while its
+// triangles are still cached, then jumps to the freshest vertex with
+// triangles left. Linear time, writes index_count indices to out.
+void optimize_vertex_cache(const uint32_t* indices, size_t index_count, size_t vertex_count, uint32_t* out, unsigned cache_size = VERTEX_CACHE_SIZE);
+
+// renumbers vertices in first use order so fetches walk memory forward.
+// rewrites indices in place and fills remap[old] = new, vertices no
+// triangle uses go last
+void optimize_vertex_fetch(uint32_t* indices, size_t index_count, size_t vertex_count, std::vector<uint32_t>& remap);
+
+// moves every vertex of a components-wide stream to remap[vertex]
+void remap_vertex_stream(float* data, size_t components, const std::vector<uint32_t>& remap);
+void remap_vertex_stream(uint8_t* data, size_t components, const std::vector<uint32_t>& remap);
@@ -1,68 +1,111 @@
-#include "Node.h"
+#include "node.h"
 #include "maths_funcs.h"
 
+#include <assert.h>
+
 Node::Node()
-	:parent(0)
+	:hierarchy(nullptr)
+	,index(-1)
 { ; }
 
-void Node::init() { 
-	position = vec3(0, 0, 0);
-	rotation = versor(0,0,0,1);
-	scale = vec3(1,1,1);
+Node::~Node() {
+	release();
+}
 
-	localMatrix = identity_mat4();
-	worldMatrix = identity_mat4();
-	localInverseMatrix = identity_mat4();
-	worldInverseMatrix = identity_mat4();
+Node::Node(Node&& other) noexcept
+	:hierarchy(other.hierarchy)
+	,index(other.index)
+{
+	if (hierarchy != nullptr) {
+		hierarchy->handles[index] = this;
+	}
+	other.hierarchy = nullptr;
+	other.index = -1;
 }
 
-void Node::addChild(Node& node) { 
-	node.parent = this;
-	children.push_back(&node);
+Node& Node::operator=(Node&& other) noexcept {
+	if (this != &other) {
+		release();
+		hierarchy = other.hierarchy;
+		index = other.index;
+		if (hierarchy != nullptr) {
+			hierarchy->handles[index] = this;
+		}
+		other.hierarchy = nullptr;
+		other.index = -1;
+	}
+	return *this;
 }
 
-void Node::removeChild(Node& node) { 
-	auto it = std::find(children.begin(), children.end(), &node);
-	if (it != children.end()) {
-		node.parent = nullptr;
-		children.erase(it);
+void Node::release() {
+	if (hierarchy != nullptr) {
+		assert(hierarchy->handles[index] == this);
+		hierarchy->remove(index);
+		hierarchy = nullptr;
+		index = -1;
 	}
 }
 
-void  Node::updateLocal() 
-{ 
-	mat4 T = translate( identity_mat4(), vec3( position.v[0], position.v[1], position.v[2] ) );
-	mat4 R = quat_to_mat4(rotation); 
-	mat4 S = scaler(identity_mat4(), scale);
-	localMatrix = T*R*S;
+void Node::init(TransformHierarchy& hierarchy) {
+	assert(this->hierarchy == nullptr && "Node already initialised");
+	this->hierarchy = &hierarchy;
+	index = hierarchy.add(this);
+}
 
-	mat4 Tinv = translate( identity_mat4(), vec3( -position.v[0], -position.v[1], -position.v[2] ) );
-	mat4 Sinv = scaler(identity_mat4(), vec3(1.f / scale.v[0], 1.f / scale.v[1], 1.f / scale.v[2]));
-	localInverseMatrix = Sinv*transpose(R)*Tinv; // equivalent to tras(A)b - tras(A)t
+void Node::addChild(Node& node) {
+	assert(hierarchy != nullptr && node.hierarchy == hierarchy);
+	hierarchy->setParent(node.index, index);
+}
 
-	//localMatrix = T*R*S;
-	//localInverseMatrix = Sinv*transpose(R)*Tinv;
+void Node::removeChild(Node& node) {
+	if (node.parent() == this) {
+		hierarchy->setParent(node.index, -1);
+	}
+}
 
-	//localMatrix = T;
-	//localInverseMatrix = Tinv;
+Node* Node::parent() const {
+	int parentIndex = hierarchy->parents[index];
+	return parentIndex < 0 ? nullptr : hierarchy->handles[parentIndex];
 }
 
-void  Node::updateHierarchy()
+const vec3& Node::position() const { return hierarchy->positions[index]; }
+const versor& Node::rotation() const { return hierarchy->rotations[index]; }
+const vec3& Node::scale() const { return hierarchy->scales[index]; }
+
+void Node::setPosition(const vec3& position) {
+	hierarchy->positions[index] = position;
+	hierarchy->markLocalDirty(index);
+}
+
+void Node::setRotation(const versor& rotation) {
+	hierarchy->rotations[index] = rotation;
+	hierarchy->markLocalDirty(index);
+}
+
+void Node::setScale(const vec3& scale) {
+	hierarchy->scales[index] = scale;
+	hierarchy->markLocalDirty(index);
+}
+
+const mat4& Node::localMatrix() const { return hierarchy->localMatrices[index]; }
+const mat4& Node::worldMatrix() const { return hierarchy->worldMatrices[index]; }
+const mat4& Node::localInverseMatrix() const { return hierarchy->localInverse(index); }
+const mat4& Node::worldInverseMatrix() const { return hierarchy->worldInverse(index); }
+
+bool Node::worldChanged() const {
+	return (hierarchy->flags[index] & TransformHierarchy::WorldChanged) != 0;
+}
+
+void Node::setEagerInverse(bool eager) {
+	hierarchy->setEagerInverse(index, eager);
+}
+
+void  Node::updateLocal()
 {
-	updateLocal();
-	mat4 parentMatrix = identity_mat4();
-	mat4 parentInverseMatrix = identity_mat4();
-	if (parent!= nullptr) {
-		parentMatrix = (*parent).worldMatrix;
-		parentInverseMatrix = (*parent).worldInverseMatrix;
-	}
-	worldMatrix = parentMatrix*localMatrix;
-	worldInverseMatrix = parentInverseMatrix*localInverseMatrix;
+	hierarchy->updateLocal(index);
+}
 
-	for (size_t i = 0; i < children.size(); ++i) {
-		Node* child = children[i];
-		if (child != nullptr) {
-			(*child).updateHierarchy();
-		}
-	}
+void  Node::updateHierarchy()
+{
+	hierarchy->update();
 }
@@ -1,28 +1,51 @@
 #pragma once
 #include <vector>
 #include "maths_funcs.h"
+#include "transform_hierarchy.h"
 
+// Thin handle to a slot of a TransformHierarchy. The hierarchy keeps a
+// pointer back to each handle, so a Node cannot be copied; moving it, as a
+// growing std::vector<Node> does, hands the slot over to the new object.
+// A destroyed Node leaves its slot in the hierarchy without a handle, the
+// hierarchy must outlive its Nodes.
 struct Node {
 
-	Node* parent;
-	std::vector<Node*> children;
-
-	vec3 position;
-	versor rotation;
-	vec3 scale;
-
-	mat4 localMatrix;
-	mat4 localInverseMatrix;
-
-	mat4 worldMatrix;
-	mat4 worldInverseMatrix;
+	TransformHierarchy* hierarchy;
+	int index;
 
 	Node();
+	~Node();
+	Node(Node&& other) noexcept;
+	Node& operator=(Node&& other) noexcept;
+	Node(const Node&) = delete;
+	Node& operator=(const Node&) = delete;
 
-	void init();
+	void init(TransformHierarchy& hierarchy = TransformHierarchy::main());
 	void addChild(Node& node) ;
 	void removeChild(Node& node) ;
+	Node* parent() const;
+
+	const vec3& position() const;
+	const versor& rotation() const;
+	const vec3& scale() const;
+	void setPosition(const vec3& position);
+	void setRotation(const versor& rotation);
+	void setScale(const vec3& scale);
+
+	const mat4& localMatrix() const;
+	const mat4& worldMatrix() const;
+	// computed on demand and cached until the node moves
+	const mat4& localInverseMatrix() const;
+	const mat4& worldInverseMatrix() const;
+	void setEagerInverse(bool eager);
+	// true when the last update recomputed worldMatrix()
+	bool worldChanged() const;
+
 	void updateLocal();
+	// updates every dirty node of the hierarchy, not just this subtree
 	void updateHierarchy();
-};
 
+private:
+	// drops the hierarchy's pointer to this handle
+	void release();
+};
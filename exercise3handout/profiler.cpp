@@ -0,0 +1,298 @@
+#include "profiler.h"
+
+#include <assert.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+	int64_t clock_us() {
+		return std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// zone names are literals, but a quote or a backslash would still break the file
+	void write_name(FILE* file, const char* name) {
+		fputc('"', file);
+		for (const char* c = name; *c; ++c) {
+			if (*c == '"' || *c == '\\') {
+				fputc('\\', file);
+			}
+			fputc(*c, file);
+		}
+		fputc('"', file);
+	}
+}
+
+Profiler::Profiler()
+	: enabled(true), head(0), count(0), in_frame(false), cpu_depth(0), gpu_depth(0), queries_created(false),
+	epoch(clock_us()) {
+	for (int s = 0; s < QueryLatency; ++s) {
+		query_sets[s].slot = -1;
+		query_sets[s].number = 0;
+		query_sets[s].zone_count = 0;
+	}
+}
+
+Profiler& Profiler::main() {
+	static Profiler profiler;
+	return profiler;
+}
+
+double Profiler::now() const {
+	return static_cast<double>(clock_us() - epoch);
+}
+
+/*----------------------------------FRAMES------------------------------------*/
+void Profiler::begin_frame() {
+	assert(!in_frame);
+	if (!enabled) {
+		return;
+	}
+	in_frame = true;
+	cpu_depth = 0;
+	gpu_depth = 0;
+
+	Frame& frame = ring[head];
+	frame.number = count == 0 ? 0 : ring[(head + FrameCount - 1) % FrameCount].number + 1;
+	frame.start = now();
+	frame.duration = 0.0;
+	frame.zone_count = 0;
+
+	if (!queries_created) {
+		for (int s = 0; s < QueryLatency; ++s) {
+			glGenQueries(1 + MaxGpuZones * 2, query_sets[s].queries);
+		}
+		queries_created = true;
+	}
+
+	// the set this frame reuses was issued QueryLatency frames ago
+	int set = static_cast<int>(frame.number % QueryLatency);
+	resolve_queries(set);
+	QuerySet& queries = query_sets[set];
+	queries.slot = head;
+	queries.number = frame.number;
+	queries.zone_count = 0;
+	glQueryCounter(queries.queries[0], GL_TIMESTAMP);
+}
+
+void Profiler::end_frame() {
+	if (!in_frame) {
+		return;
+	}
+	assert(cpu_depth == 0 && gpu_depth == 0);
+	Frame& frame = ring[head];
+	frame.duration = now() - frame.start;
+	in_frame = false;
+	head = (head + 1) % FrameCount;
+	count = count < FrameCount ? count + 1 : FrameCount;
+}
+
+void Profiler::resolve_queries(int set) {
+	QuerySet& queries = query_sets[set];
+	if (queries.slot < 0) {
+		return;
+	}
+	Frame& frame = ring[queries.slot];
+	bool same_frame = frame.number == queries.number;
+	queries.slot = -1;
+	if (!same_frame || queries.zone_count == 0) {
+		return;
+	}
+
+	// reading a result that is not there yet would stall until the GPU gets to it
+	for (int q = 0; q <= queries.zone_count * 2; ++q) {
+		GLint available = 0;
+		glGetQueryObjectiv(queries.queries[q], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			return; // the GPU is more than QueryLatency frames behind, these zones stay unresolved
+		}
+	}
+	GLuint64 frame_start = 0;
+	glGetQueryObjectui64v(queries.queries[0], GL_QUERY_RESULT, &frame_start);
+	for (int z = 0; z < queries.zone_count; ++z) {
+		GLuint64 begin = 0;
+		GLuint64 end = 0;
+		glGetQueryObjectui64v(queries.queries[1 + z * 2], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(queries.queries[2 + z * 2], GL_QUERY_RESULT, &end);
+		Zone& zone = frame.zones[queries.zones[z]];
+		zone.start = static_cast<double>(begin - frame_start) / 1000.0;
+		zone.duration = static_cast<double>(end - begin) / 1000.0;
+		zone.resolved = true;
+	}
+}
+
+/*-----------------------------------ZONES------------------------------------*/
+int Profiler::begin_cpu(const char* name) {
+	Frame& frame = ring[head];
+	if (!in_frame || frame.zone_count == MaxZones) {
+		return -1;
+	}
+	int index = frame.zone_count++;
+	Zone& zone = frame.zones[index];
+	zone.name = name;
+	zone.depth = cpu_depth;
+	zone.gpu = false;
+	zone.resolved = true;
+	zone.duration = 0.0;
+	cpu_stack[cpu_depth++] = index;
+	zone.start = now();
+	return index;
+}
+
+void Profiler::end_cpu(int zone) {
+	if (zone < 0 || !in_frame) {
+		return;
+	}
+	double end = now();
+	// zones close in the reverse order they were opened
+	assert(cpu_depth > 0 && cpu_stack[cpu_depth - 1] == zone);
+	--cpu_depth;
+	Zone& timed = ring[head].zones[zone];
+	timed.duration = end - timed.start;
+}
+
+int Profiler::begin_gpu(const char* name) {
+	Frame& frame = ring[head];
+	if (!in_frame || frame.zone_count == MaxZones) {
+		return -1;
+	}
+	QuerySet& queries = query_sets[frame.number % QueryLatency];
+	if (queries.zone_count == MaxGpuZones) {
+		return -1;
+	}
+	int index = frame.zone_count++;
+	Zone& zone = frame.zones[index];
+	zone.name = name;
+	zone.depth = gpu_depth++;
+	zone.gpu = true;
+	zone.resolved = false;
+	zone.start = 0.0;
+	zone.duration = 0.0;
+
+	int query = queries.zone_count++;
+	queries.zones[query] = index;
+	glQueryCounter(queries.queries[1 + query * 2], GL_TIMESTAMP);
+	return query;
+}
+
+void Profiler::end_gpu(int zone) {
+	if (zone < 0 || !in_frame) {
+		return;
+	}
+	assert(gpu_depth > 0);
+	--gpu_depth;
+	QuerySet& queries = query_sets[ring[head].number % QueryLatency];
+	glQueryCounter(queries.queries[2 + zone * 2], GL_TIMESTAMP);
+}
+
+/*----------------------------------READING-----------------------------------*/
+int Profiler::frame_count() const {
+	return count;
+}
+
+const Profiler::Frame& Profiler::frame(int back) const {
+	assert(back >= 0 && back < count);
+	return ring[(head + FrameCount - 1 - back) % FrameCount];
+}
+
+double Profiler::average_ms(int frames) const {
+	frames = frames < count ? frames : count;
+	if (frames <= 0) {
+		return 0.0;
+	}
+	double total = 0.0;
+	for (int f = 0; f < frames; ++f) {
+		total += frame(f).duration;
+	}
+	return total / frames / 1000.0;
+}
+
+double Profiler::average_cpu_ms(const char* name, int frames) const {
+	return average_zone_ms(name, false, frames);
+}
+
+double Profiler::average_gpu_ms(const char* name, int frames) const {
+	return average_zone_ms(name, true, frames);
+}
+
+double Profiler::average_zone_ms(const char* name, bool gpu, int frames) const {
+	frames = frames < count ? frames : count;
+	double total = 0.0;
+	int counted = 0;
+	for (int f = 0; f < frames; ++f) {
+		const Frame& recorded = frame(f);
+		double frame_total = 0.0;
+		bool found = false;
+		for (int z = 0; z < recorded.zone_count; ++z) {
+			const Zone& zone = recorded.zones[z];
+			if (zone.gpu == gpu && zone.resolved && strcmp(zone.name, name) == 0) {
+				frame_total += zone.duration;
+				found = true;
+			}
+		}
+		if (found) {
+			total += frame_total;
+			++counted;
+		}
+	}
+	return counted ? total / counted / 1000.0 : 0.0;
+}
+
+bool Profiler::write_chrome_trace(const char* file_name) const {
+	FILE* file = fopen(file_name, "w");
+	if (!file) {
+		fprintf(stderr, "ERROR: could not write profile to %s\n", file_name);
+		return false;
+	}
+	// complete ("X") events on two tracks, timestamps in microseconds
+	fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	fprintf(file, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"CPU\"}},\n");
+	fprintf(file, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2, \"args\": {\"name\": \"GPU\"}}");
+	for (int f = count - 1; f >= 0; --f) {
+		const Frame& recorded = frame(f);
+		fprintf(file, ",\n{\"name\": \"frame %llu\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": %.1f, \"dur\": %.1f}",
+			(unsigned long long)recorded.number, recorded.start, recorded.duration);
+		for (int z = 0; z < recorded.zone_count; ++z) {
+			const Zone& zone = recorded.zones[z];
+			if (!zone.resolved) {
+				continue;
+			}
+			// gpu time is on another clock, it is drawn from the start of the cpu frame
+			double start = zone.gpu ? recorded.start + zone.start : zone.start;
+			fprintf(file, ",\n{\"name\": ");
+			write_name(file, zone.name);
+			fprintf(file, ", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.1f, \"dur\": %.1f}", zone.gpu ? 2 : 1,
+				start, zone.duration);
+		}
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	return true;
+}
+
+void Profiler::unload_from_gpu() {
+	if (queries_created) {
+		for (int s = 0; s < QueryLatency; ++s) {
+			glDeleteQueries(1 + MaxGpuZones * 2, query_sets[s].queries);
+			query_sets[s].slot = -1;
+		}
+		queries_created = false;
+	}
+}
+
+/*--------------------------------SCOPED ZONES--------------------------------*/
+ProfileZone::ProfileZone(const char* name) : zone(Profiler::main().begin_cpu(name)) {
+}
+
+ProfileZone::~ProfileZone() {
+	Profiler::main().end_cpu(zone);
+}
+
+GpuProfileZone::GpuProfileZone(const char* name) : zone(Profiler::main().begin_gpu(name)) {
+}
+
+GpuProfileZone::~GpuProfileZone() {
+	Profiler::main().end_gpu(zone);
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdint.h>
+#include <GL/Glew.h>
+
+// Frame profiler. CPU zones are timed between begin_cpu() and end_cpu(), or
+// by a ProfileZone on the stack, and nest. GPU zones put a GL_TIMESTAMP
+// query before and after the GL commands between begin_gpu() and end_gpu().
+// Their results are read back QueryLatency frames later, so the CPU never
+// waits for the GPU. The last FrameCount frames are kept in a ring and can
+// be written as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+//
+// Zone names are kept by pointer, pass string literals. Main thread only.
+struct Profiler {
+
+	static const int FrameCount = 120;
+	static const int MaxZones = 64;    // cpu and gpu zones of one frame
+	static const int MaxGpuZones = 16;
+	static const int QueryLatency = 4; // frames before a gpu zone is read back
+
+	struct Zone {
+		const char* name;
+		int depth;       // nesting level among zones of the same kind, 0 outermost
+		bool gpu;
+		bool resolved;   // false while a gpu zone waits for its queries, or if they were lost
+		double start;    // microseconds. cpu: since the profiler started, gpu: since the frame's first command
+		double duration; // microseconds
+	};
+
+	struct Frame {
+		uint64_t number;
+		double start;    // microseconds since the profiler started
+		double duration;
+		int zone_count;
+		Zone zones[MaxZones];
+	};
+
+	// begin_frame() of a disabled profiler records nothing
+	bool enabled;
+
+	Profiler();
+
+	static Profiler& main();
+
+	void begin_frame();
+	void end_frame();
+
+	// handle for the matching end call, -1 outside a frame or when it is full
+	int begin_cpu(const char* name);
+	void end_cpu(int zone);
+	int begin_gpu(const char* name);
+	void end_gpu(int zone);
+
+	// completed frames in the ring. frame(0) is the last one
+	int frame_count() const;
+	const Frame& frame(int back) const;
+
+	// mean over the last frames of the frame time, or of every cpu or gpu
+	// zone called name. a cpu and a gpu zone may share a name, each only
+	// counts its own kind. gpu zones only count once resolved, 0 when there
+	// is nothing yet
+	double average_ms(int frames) const;
+	double average_cpu_ms(const char* name, int frames) const;
+	double average_gpu_ms(const char* name, int frames) const;
+
+	bool write_chrome_trace(const char* file_name) const;
+
+	void unload_from_gpu();
+
+private:
+	double now() const;
+	double average_zone_ms(const char* name, bool gpu, int frames) const;
+	void resolve_queries(int set);
+
+	Frame ring[FrameCount];
+	int head;  // slot of the frame being recorded
+	int count; // completed frames
+	bool in_frame;
+
+	int cpu_stack[MaxZones];
+	int cpu_depth;
+	int gpu_depth;
+
+	// one set of queries per frame in flight: the frame start, then a begin
+	// and an end per gpu zone
+	struct QuerySet {
+		GLuint queries[1 + MaxGpuZones * 2];
+		int slot;        // ring slot of the frame that issued them, -1 when idle
+		uint64_t number; // and its number, the slot may have been reused
+		int zones[MaxGpuZones];
+		int zone_count;
+	};
+	QuerySet query_sets[QueryLatency];
+	bool queries_created;
+
+	int64_t epoch;
+};
+
+// times the enclosing scope as a CPU zone of Profiler::main()
+struct ProfileZone {
+	explicit ProfileZone(const char* name);
+	~ProfileZone();
+
+private:
+	int zone;
+};
+
+// times the GL commands issued in the enclosing scope as a GPU zone of Profiler::main()
+struct GpuProfileZone {
+	explicit GpuProfileZone(const char* name);
+	~GpuProfileZone();
+
+private:
+	int zone;
+};
@@ -0,0 +1,251 @@
+#include "ray_spheres.h"
+
+#include <math.h>
+
+#if defined( MATHS_SIMD_SSE )
+#include <xmmintrin.h>
+#elif defined( MATHS_SIMD_NEON )
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+	// ray_sphere() from the origin relative to the centre, the one formula
+	// every path below follows operation for operation
+	inline float hit_from(float ox, float oy, float oz, float dx, float dy, float dz, float radius) {
+		float b = ox * dx + oy * dy + oz * dz;
+		float c = ox * ox + oy * oy + oz * oz - radius * radius;
+		float discriminant = b * b - c;
+		if (discriminant < 0.f) {
+			return -1.f;
+		}
+		float root = sqrtf(discriminant);
+		float t_far = -b + root;
+		if (t_far < 0.f) {
+			return -1.f; // behind the origin
+		}
+		float t_near = -b - root;
+		return t_near > 0.f ? t_near : 0.f;
+	}
+
+#if defined( MATHS_SIMD_SSE )
+	inline __m128 hit4(__m128 ox, __m128 oy, __m128 oz, __m128 dx, __m128 dy, __m128 dz, __m128 r) {
+		const __m128 zero = _mm_setzero_ps();
+		__m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, dx), _mm_mul_ps(oy, dy)), _mm_mul_ps(oz, dz));
+		__m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, ox), _mm_mul_ps(oy, oy)), _mm_mul_ps(oz, oz)),
+			_mm_mul_ps(r, r));
+		__m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), c);
+		__m128 root = _mm_sqrt_ps(_mm_max_ps(discriminant, zero));
+		__m128 minus_b = _mm_xor_ps(b, _mm_set1_ps(-0.f));
+		__m128 t_far = _mm_add_ps(minus_b, root);
+		__m128 t_near = _mm_max_ps(_mm_sub_ps(minus_b, root), zero);
+		__m128 miss = _mm_or_ps(_mm_cmplt_ps(discriminant, zero), _mm_cmplt_ps(t_far, zero));
+		return _mm_or_ps(_mm_andnot_ps(miss, t_near), _mm_and_ps(miss, _mm_set1_ps(-1.f)));
+	}
+#elif defined( MATHS_SIMD_NEON )
+	inline float32x4_t sqrt4(float32x4_t x) {
+#if defined( __aarch64__ ) || defined( _M_ARM64 )
+		return vsqrtq_f32(x);
+#else
+		float lanes[4];
+		vst1q_f32(lanes, x);
+		for (int lane = 0; lane < 4; ++lane) {
+			lanes[lane] = sqrtf(lanes[lane]);
+		}
+		return vld1q_f32(lanes);
+#endif
+	}
+
+	inline float32x4_t hit4(float32x4_t ox, float32x4_t oy, float32x4_t oz, float32x4_t dx, float32x4_t dy,
+		float32x4_t dz, float32x4_t r) {
+		const float32x4_t zero = vdupq_n_f32(0.f);
+		float32x4_t b = vaddq_f32(vaddq_f32(vmulq_f32(ox, dx), vmulq_f32(oy, dy)), vmulq_f32(oz, dz));
+		float32x4_t c = vsubq_f32(vaddq_f32(vaddq_f32(vmulq_f32(ox, ox), vmulq_f32(oy, oy)), vmulq_f32(oz, oz)),
+			vmulq_f32(r, r));
+		float32x4_t discriminant = vsubq_f32(vmulq_f32(b, b), c);
+		float32x4_t root = sqrt4(vmaxq_f32(discriminant, zero));
+		float32x4_t minus_b = vnegq_f32(b);
+		float32x4_t t_far = vaddq_f32(minus_b, root);
+		float32x4_t t_near = vmaxq_f32(vsubq_f32(minus_b, root), zero);
+		uint32x4_t miss = vorrq_u32(vcltq_f32(discriminant, zero), vcltq_f32(t_far, zero));
+		return vbslq_f32(miss, vdupq_n_f32(-1.f), t_near);
+	}
+#endif
+
+	// keeps the first lane with the smallest non negative distance
+	inline void take_nearest(const float* t, size_t first, size_t count, int* best, float* best_t) {
+		for (size_t lane = 0; lane < count; ++lane) {
+			if (t[lane] >= 0.f && t[lane] < *best_t) {
+				*best_t = t[lane];
+				*best = (int)(first + lane);
+			}
+		}
+	}
+}
+
+float ray_sphere(const vec3& origin, const vec3& direction, const vec3& center, float radius) {
+	return hit_from(origin.x - center.x, origin.y - center.y, origin.z - center.z, direction.x, direction.y,
+		direction.z, radius);
+}
+
+/*------------------------------------BATCHES---------------------------------*/
+void SphereBatch::clear() {
+	center_x.clear();
+	center_y.clear();
+	center_z.clear();
+	radius.clear();
+}
+
+size_t SphereBatch::add(const vec3& center, float sphere_radius) {
+	center_x.push_back(center.x);
+	center_y.push_back(center.y);
+	center_z.push_back(center.z);
+	radius.push_back(sphere_radius);
+	return radius.size() - 1;
+}
+
+size_t SphereBatch::size() const {
+	return radius.size();
+}
+
+void RayBatch::clear() {
+	origin_x.clear();
+	origin_y.clear();
+	origin_z.clear();
+	direction_x.clear();
+	direction_y.clear();
+	direction_z.clear();
+}
+
+size_t RayBatch::add(const vec3& origin, const vec3& direction) {
+	origin_x.push_back(origin.x);
+	origin_y.push_back(origin.y);
+	origin_z.push_back(origin.z);
+	direction_x.push_back(direction.x);
+	direction_y.push_back(direction.y);
+	direction_z.push_back(direction.z);
+	return origin_x.size() - 1;
+}
+
+size_t RayBatch::size() const {
+	return origin_x.size();
+}
+
+/*-------------------------------------KERNELS--------------------------------*/
+// Eight per step, as two four wide halves: SSE and NEON registers hold four
+// floats, and the two halves are independent so they overlap in the pipeline.
+int ray_spheres(const vec3& origin, const vec3& direction, const SphereBatch& spheres, float max_distance,
+	float* distance) {
+	size_t count = spheres.size();
+	size_t i = 0;
+	int best = -1;
+	float best_t = max_distance;
+
+#if defined( MATHS_SIMD_SSE )
+	const __m128 px = _mm_set1_ps(origin.x);
+	const __m128 py = _mm_set1_ps(origin.y);
+	const __m128 pz = _mm_set1_ps(origin.z);
+	const __m128 dx = _mm_set1_ps(direction.x);
+	const __m128 dy = _mm_set1_ps(direction.y);
+	const __m128 dz = _mm_set1_ps(direction.z);
+	for (; i + 8 <= count; i += 8) {
+		__m128 t0 = hit4(_mm_sub_ps(px, _mm_loadu_ps(&spheres.center_x[i])),
+			_mm_sub_ps(py, _mm_loadu_ps(&spheres.center_y[i])), _mm_sub_ps(pz, _mm_loadu_ps(&spheres.center_z[i])),
+			dx, dy, dz, _mm_loadu_ps(&spheres.radius[i]));
+		__m128 t1 = hit4(_mm_sub_ps(px, _mm_loadu_ps(&spheres.center_x[i + 4])),
+			_mm_sub_ps(py, _mm_loadu_ps(&spheres.center_y[i + 4])),
+			_mm_sub_ps(pz, _mm_loadu_ps(&spheres.center_z[i + 4])), dx, dy, dz, _mm_loadu_ps(&spheres.radius[i + 4]));
+		// most steps hit nothing nearer, skip them with one compare
+		__m128 limit = _mm_set1_ps(best_t);
+		__m128 zero = _mm_setzero_ps();
+		__m128 closer = _mm_or_ps(_mm_and_ps(_mm_cmpge_ps(t0, zero), _mm_cmplt_ps(t0, limit)),
+			_mm_and_ps(_mm_cmpge_ps(t1, zero), _mm_cmplt_ps(t1, limit)));
+		if (_mm_movemask_ps(closer) == 0) {
+			continue;
+		}
+		float t[8];
+		_mm_storeu_ps(t, t0);
+		_mm_storeu_ps(t + 4, t1);
+		take_nearest(t, i, 8, &best, &best_t);
+	}
+#elif defined( MATHS_SIMD_NEON )
+	const float32x4_t px = vdupq_n_f32(origin.x);
+	const float32x4_t py = vdupq_n_f32(origin.y);
+	const float32x4_t pz = vdupq_n_f32(origin.z);
+	const float32x4_t dx = vdupq_n_f32(direction.x);
+	const float32x4_t dy = vdupq_n_f32(direction.y);
+	const float32x4_t dz = vdupq_n_f32(direction.z);
+	for (; i + 8 <= count; i += 8) {
+		float t[8];
+		vst1q_f32(t, hit4(vsubq_f32(px, vld1q_f32(&spheres.center_x[i])), vsubq_f32(py, vld1q_f32(&spheres.center_y[i])),
+			vsubq_f32(pz, vld1q_f32(&spheres.center_z[i])), dx, dy, dz, vld1q_f32(&spheres.radius[i])));
+		vst1q_f32(t + 4, hit4(vsubq_f32(px, vld1q_f32(&spheres.center_x[i + 4])),
+			vsubq_f32(py, vld1q_f32(&spheres.center_y[i + 4])), vsubq_f32(pz, vld1q_f32(&spheres.center_z[i + 4])),
+			dx, dy, dz, vld1q_f32(&spheres.radius[i + 4])));
+		take_nearest(t, i, 8, &best, &best_t);
+	}
+#endif
+
+	for (; i < count; ++i) {
+		float t = hit_from(origin.x - spheres.center_x[i], origin.y - spheres.center_y[i],
+			origin.z - spheres.center_z[i], direction.x, direction.y, direction.z, spheres.radius[i]);
+		take_nearest(&t, i, 1, &best, &best_t);
+	}
+
+	if (best >= 0 && distance) {
+		*distance = best_t;
+	}
+	return best;
+}
+
+int rays_sphere(const RayBatch& rays, const vec3& center, float radius, float* distances, float* distance) {
+	size_t count = rays.size();
+	size_t i = 0;
+	int best = -1;
+	float best_t = 1e30f;
+	float t[8];
+
+#if defined( MATHS_SIMD_SSE )
+	const __m128 cx = _mm_set1_ps(center.x);
+	const __m128 cy = _mm_set1_ps(center.y);
+	const __m128 cz = _mm_set1_ps(center.z);
+	const __m128 r = _mm_set1_ps(radius);
+	for (; i + 8 <= count; i += 8) {
+		float* out = distances ? distances + i : t;
+		for (int half = 0; half < 8; half += 4) {
+			_mm_storeu_ps(out + half, hit4(_mm_sub_ps(_mm_loadu_ps(&rays.origin_x[i + half]), cx),
+				_mm_sub_ps(_mm_loadu_ps(&rays.origin_y[i + half]), cy),
+				_mm_sub_ps(_mm_loadu_ps(&rays.origin_z[i + half]), cz), _mm_loadu_ps(&rays.direction_x[i + half]),
+				_mm_loadu_ps(&rays.direction_y[i + half]), _mm_loadu_ps(&rays.direction_z[i + half]), r));
+		}
+		take_nearest(out, i, 8, &best, &best_t);
+	}
+#elif defined( MATHS_SIMD_NEON )
+	const float32x4_t cx = vdupq_n_f32(center.x);
+	const float32x4_t cy = vdupq_n_f32(center.y);
+	const float32x4_t cz = vdupq_n_f32(center.z);
+	const float32x4_t r = vdupq_n_f32(radius);
+	for (; i + 8 <= count; i += 8) {
+		float* out = distances ? distances + i : t;
+		for (int half = 0; half < 8; half += 4) {
+			vst1q_f32(out + half, hit4(vsubq_f32(vld1q_f32(&rays.origin_x[i + half]), cx),
+				vsubq_f32(vld1q_f32(&rays.origin_y[i + half]), cy), vsubq_f32(vld1q_f32(&rays.origin_z[i + half]), cz),
+				vld1q_f32(&rays.direction_x[i + half]), vld1q_f32(&rays.direction_y[i + half]),
+				vld1q_f32(&rays.direction_z[i + half]), r));
+		}
+		take_nearest(out, i, 8, &best, &best_t);
+	}
+#endif
+
+	for (; i < count; ++i) {
+		float* out = distances ? distances + i : t;
+		*out = hit_from(rays.origin_x[i] - center.x, rays.origin_y[i] - center.y, rays.origin_z[i] - center.z,
+			rays.direction_x[i], rays.direction_y[i], rays.direction_z[i], radius);
+		take_nearest(out, i, 1, &best, &best_t);
+	}
+
+	if (best >= 0 && distance) {
+		*distance = best_t;
+	}
+	return best;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include "maths_funcs.h"
+
+// Ray against sphere tests in batches. No GL in here.
+//
+// Every test follows ray_sphere(): the distance to the first point of the
+// sphere in front of the origin, 0 when the origin is inside, negative for
+// a miss (sphere behind the origin or off the ray). A ray grazing the
+// sphere hits it at the tangent point. Directions are unit length.
+
+float ray_sphere(const vec3& origin, const vec3& direction, const vec3& center, float radius);
+
+// Spheres in structure-of-arrays form, so ray_spheres() can test eight of
+// them per loop step with SIMD.
+struct SphereBatch {
+
+	std::vector<float> center_x, center_y, center_z;
+	std::vector<float> radius;
+
+	void clear();
+	// returns the index ray_spheres() reports for this sphere
+	size_t add(const vec3& center, float radius);
+	size_t size() const;
+};
+
+// Rays in structure-of-arrays form, for rays_sphere()
+struct RayBatch {
+
+	std::vector<float> origin_x, origin_y, origin_z;
+	std::vector<float> direction_x, direction_y, direction_z;
+
+	void clear();
+	size_t add(const vec3& origin, const vec3& direction);
+	size_t size() const;
+};
+
+// one ray against every sphere: the index of the nearest one hit within
+// max_distance, -1 when none is. distance is only written on a hit. Ties go
+// to the lowest index
+int ray_spheres(const vec3& origin, const vec3& direction, const SphereBatch& spheres, float max_distance,
+	float* distance);
+
+// every ray against one sphere. distances, when not null, gets ray_sphere()
+// for each ray. Returns the index of the ray hitting nearest and writes its
+// distance, -1 when none does
+int rays_sphere(const RayBatch& rays, const vec3& center, float radius, float* distances, float* distance);
@@ -0,0 +1,15 @@
+#include "render_key.h"
+
+#include <string.h>
+
+uint64_t make_render_key(uint32_t program, uint32_t texture_set, uint32_t vao, float depth) {
+	// the bits of a non-negative float sort like the float itself
+	uint32_t depth_bits = 0;
+	if (depth > 0.f) {
+		memcpy(&depth_bits, &depth, sizeof(depth_bits));
+	}
+	return ((uint64_t)(program & 0xff) << 56)
+		| ((uint64_t)(texture_set & 0xfffff) << 36)
+		| ((uint64_t)(vao & 0xfff) << 24)
+		| (depth_bits >> 8);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+// Sort key of a RenderQueue packet, lowest draws first:
+//
+//   63      56 55                  36 35          24 23                    0
+//   | shader  |     texture set      |     VAO     |         depth         |
+//
+// The fields hold small ids the queue hands out, not the GL names, and are
+// cut to their width. depth is the view distance, negative counts as 0.
+// No GL in here, so the benches can sort with the same keys.
+uint64_t make_render_key(uint32_t program, uint32_t texture_set, uint32_t vao, float depth);
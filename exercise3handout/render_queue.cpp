@@ -0,0 +1,167 @@
+#include "render_queue.h"
+
+#include <algorithm>
+#include <string.h>
+
+/*--------------------------------RENDER STATE--------------------------------*/
+RenderState::RenderState()
+	:issued(0)
+	,skipped(0)
+{
+	invalidate();
+}
+
+void RenderState::invalidate() {
+	// names GL never hands out, so the first call of each kind goes through
+	program = ~0u;
+	vao = ~0u;
+	active_texture = 0;
+	for (int i = 0; i < MaxTextureUnits; ++i) {
+		textures[i] = ~0u;
+	}
+	uniforms.clear();
+}
+
+void RenderState::reset_counters() {
+	issued = 0;
+	skipped = 0;
+}
+
+void RenderState::use_program(GLuint new_program) {
+	if (program == new_program) {
+		++skipped;
+		return;
+	}
+	program = new_program;
+	glUseProgram(program);
+	++issued;
+}
+
+void RenderState::bind_vertex_array(GLuint new_vao) {
+	if (vao == new_vao) {
+		++skipped;
+		return;
+	}
+	vao = new_vao;
+	glBindVertexArray(vao);
+	++issued;
+}
+
+void RenderState::bind_texture(int unit, GLuint texture) {
+	if (textures[unit] == texture) {
+		++skipped;
+		return;
+	}
+	GLenum unit_enum = GL_TEXTURE0 + unit;
+	if (active_texture != unit_enum) {
+		active_texture = unit_enum;
+		glActiveTexture(unit_enum);
+		++issued;
+	}
+	textures[unit] = texture;
+	glBindTexture(GL_TEXTURE_2D, texture);
+	++issued;
+}
+
+bool RenderState::cached(int location, const float* value, int count) {
+	uint64_t key = ((uint64_t)program << 32) | (uint32_t)location;
+	std::unordered_map<uint64_t, UniformValue>::iterator found = uniforms.find(key);
+	if (found != uniforms.end() && memcmp(found->second.v, value, count * sizeof(float)) == 0) {
+		return true;
+	}
+	UniformValue& stored = uniforms[key];
+	memset(stored.v, 0, sizeof(stored.v));
+	memcpy(stored.v, value, count * sizeof(float));
+	return false;
+}
+
+void RenderState::uniform1i(int location, int value) {
+	if (location < 0) {
+		return;
+	}
+	float as_float;
+	memcpy(&as_float, &value, sizeof(as_float));
+	if (cached(location, &as_float, 1)) {
+		++skipped;
+		return;
+	}
+	glUniform1i(location, value);
+	++issued;
+}
+
+void RenderState::uniform3fv(int location, const vec3& value) {
+	if (location < 0) {
+		return;
+	}
+	if (cached(location, value.v, 3)) {
+		++skipped;
+		return;
+	}
+	glUniform3fv(location, 1, value.v);
+	++issued;
+}
+
+/*--------------------------------RENDER QUEUE--------------------------------*/
+uint32_t RenderQueue::id_of(std::unordered_map<uint64_t, uint32_t>& ids, uint64_t name) {
+	std::unordered_map<uint64_t, uint32_t>::iterator found = ids.find(name);
+	if (found != ids.end()) {
+		return found->second;
+	}
+	uint32_t id = (uint32_t)ids.size();
+	ids[name] = id;
+	return id;
+}
+
+void RenderQueue::begin() {
+	packets.clear();
+	state.invalidate();
+	state.reset_counters();
+}
+
+void RenderQueue::submit(const ShaderProgram& program, const Meshgroup::Mesh& mesh, const mat4& world, const vec3& color, float depth) {
+	Packet packet;
+	packet.program = &program;
+	packet.mesh = &mesh;
+	packet.world = world;
+	packet.color = color;
+	packet.key = make_render_key(id_of(program_ids, program.id),
+		id_of(texture_set_ids, ((uint64_t)mesh.nmap_tex << 32) | mesh.dmap_tex),
+		id_of(vao_ids, mesh.vao), depth);
+	packets.push_back(packet);
+}
+
+void RenderQueue::flush() {
+	std::sort(packets.begin(), packets.end(), [](const Packet& a, const Packet& b) { return a.key < b.key; });
+
+	for (size_t i = 0; i < packets.size(); ++i) {
+		const Packet& packet = packets[i];
+		const Meshgroup::Mesh& mesh = *packet.mesh;
+
+		const ShaderProgram& program = *packet.program;
+
+		state.use_program(program.id);
+		state.uniform1i(mesh.normal_map_location, 0);
+		state.uniform1i(mesh.diffuse_map_location, 1);
+		state.bind_texture(0, mesh.nmap_tex);
+		state.bind_texture(1, mesh.dmap_tex);
+		state.bind_vertex_array(mesh.vao);
+
+		state.uniform3fv(mesh.position_offset_location, mesh.position_offset);
+		state.uniform3fv(mesh.position_scale_location, mesh.position_scale);
+		state.uniform1i(mesh.octahedral_normals_location, mesh.octahedral_normals ? 1 : 0);
+		state.uniform3fv(mesh.diffuse_base_color_location, packet.color);
+		state.uniform1i(mesh.skinned_location, mesh.skinned() ? 1 : 0);
+		if (mesh.skinned()) {
+			mesh.compute_bone_palette(palette);
+			mesh.load_bone_palette(palette);
+			state.issued += 3;
+		}
+
+		// different for every packet
+		program.set(mesh.model_matrix_location, packet.world);
+		glDrawElements(GL_TRIANGLES, mesh.index_count, mesh.index_type, 0);
+		state.issued += 2;
+	}
+	state.bind_vertex_array(0);
+	packets.clear();
+}
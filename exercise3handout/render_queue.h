@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+#include <GL/Glew.h>
+#include "maths_funcs.h"
+#include "mesh.h"
+#include "render_key.h"
+#include "shader_program.h"
+
+// Shadow copy of the GL state the mesh draws touch. Every call compares
+// against the last value it set and only reaches GL when something changed.
+// invalidate() at the start of a frame, code outside may have changed GL.
+struct RenderState {
+
+	static const int MaxTextureUnits = 8;
+
+	GLuint program;
+	GLuint vao;
+	GLenum active_texture;
+	GLuint textures[MaxTextureUnits];
+
+	// GL calls made and avoided since the last reset_counters()
+	size_t issued;
+	size_t skipped;
+
+	RenderState();
+
+	void invalidate();
+	void reset_counters();
+
+	void use_program(GLuint program);
+	void bind_vertex_array(GLuint vao);
+	void bind_texture(int unit, GLuint texture);
+	// uniform values are per program, cached by (program, location)
+	void uniform1i(int location, int value);
+	void uniform3fv(int location, const vec3& value);
+
+private:
+	struct UniformValue {
+		float v[3];
+	};
+	bool cached(int location, const float* value, int count);
+
+	std::unordered_map<uint64_t, UniformValue> uniforms;
+};
+
+// Draw packets sorted by a 64-bit key before they are issued, so packets
+// sharing a shader, then textures, then VAO run back to back and the state
+// tracker can skip most of the binds. Opaque meshes go front to back.
+// The key layout is in render_key.h.
+struct RenderQueue {
+
+	struct Packet {
+		uint64_t key;
+		const ShaderProgram* program;
+		const Meshgroup::Mesh* mesh;
+		mat4 world;
+		vec3 color;
+	};
+
+	std::vector<Packet> packets;
+	RenderState state;
+
+	// starts a frame: drops the packets, the cached state and the counters
+	void begin();
+	// program must be the one mesh.get_shader_uniforms() was called with.
+	// depth is the view distance, smaller draws first
+	void submit(const ShaderProgram& program, const Meshgroup::Mesh& mesh, const mat4& world, const vec3& color, float depth);
+	// sorts and issues every packet, the counters then hold the frame's totals
+	void flush();
+
+private:
+	uint32_t id_of(std::unordered_map<uint64_t, uint32_t>& ids, uint64_t name);
+
+	std::unordered_map<uint64_t, uint32_t> program_ids;
+	std::unordered_map<uint64_t, uint32_t> texture_set_ids;
+	std::unordered_map<uint64_t, uint32_t> vao_ids;
+	// bone palette of the skinned packet being issued
+	std::vector<mat4> palette;
+};
@@ -0,0 +1,236 @@
+#include "shader_program.h"
+
+#include "gl_utils.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+	// "lights[0]" -> "lights", GL reports arrays by their first element
+	std::string base_name(const char* name) {
+		size_t length = strlen(name);
+		if (length > 3 && strcmp(name + length - 3, "[0]") == 0) {
+			length -= 3;
+		}
+		return std::string(name, length);
+	}
+
+	bool is_int_type(GLenum type) {
+		switch (type) {
+		case GL_INT:
+		case GL_BOOL:
+		case GL_SAMPLER_2D:
+		case GL_SAMPLER_3D:
+		case GL_SAMPLER_CUBE:
+		case GL_SAMPLER_2D_SHADOW:
+		case GL_SAMPLER_2D_ARRAY:
+		case GL_SAMPLER_BUFFER:
+		case GL_INT_SAMPLER_BUFFER:
+		case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+}
+
+ShaderProgram::ShaderProgram()
+	:id(0)
+{
+}
+
+bool ShaderProgram::load_from_files(const char* vert_file_name, const char* frag_file_name) {
+	return reflect(create_programme_from_files(vert_file_name, frag_file_name));
+}
+
+bool ShaderProgram::reflect(GLuint programme) {
+	id = programme;
+	uniforms.clear();
+	attributes.clear();
+	blocks.clear();
+	uniform_lookup.clear();
+	attribute_lookup.clear();
+	location_types.clear();
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(id, GL_LINK_STATUS, &linked);
+	if (linked != GL_TRUE) {
+		gl_log_err("ERROR: programme %u is not linked, nothing to reflect\n", id);
+		return false;
+	}
+
+	char name[256];
+	GLint count = 0;
+
+	glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+	for (GLint i = 0; i < count; ++i) {
+		Variable uniform;
+		glGetActiveUniform(id, (GLuint)i, sizeof(name), NULL, &uniform.size, &uniform.type, name);
+		uniform.location = glGetUniformLocation(id, name);
+		// members of uniform blocks have no location of their own
+		if (uniform.location < 0) {
+			continue;
+		}
+		uniform.name = base_name(name);
+
+		for (GLint element = 0; element < uniform.size; ++element) {
+			GLint location = uniform.location;
+			if (element > 0) {
+				// element locations are not guaranteed to be consecutive before 4.3
+				char element_name[300];
+				snprintf(element_name, sizeof(element_name), "%s[%d]", uniform.name.c_str(), element);
+				location = glGetUniformLocation(id, element_name);
+			}
+			// the driver may report an array longer than the elements it kept
+			if (location < 0) {
+				continue;
+			}
+			if (location >= (GLint)location_types.size()) {
+				location_types.resize(location + 1, GL_NONE);
+			}
+			location_types[location] = uniform.type;
+		}
+
+		uniform_lookup[uniform.name] = uniforms.size();
+		uniforms.push_back(uniform);
+	}
+
+	glGetProgramiv(id, GL_ACTIVE_ATTRIBUTES, &count);
+	for (GLint i = 0; i < count; ++i) {
+		Variable attribute;
+		glGetActiveAttrib(id, (GLuint)i, sizeof(name), NULL, &attribute.size, &attribute.type, name);
+		attribute.location = glGetAttribLocation(id, name);
+		// gl_VertexID and friends
+		if (attribute.location < 0) {
+			continue;
+		}
+		attribute.name = base_name(name);
+		attribute_lookup[attribute.name] = attributes.size();
+		attributes.push_back(attribute);
+	}
+
+	glGetProgramiv(id, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+	for (GLint i = 0; i < count; ++i) {
+		Block block;
+		block.index = (GLuint)i;
+		glGetActiveUniformBlockName(id, block.index, sizeof(name), NULL, name);
+		glGetActiveUniformBlockiv(id, block.index, GL_UNIFORM_BLOCK_DATA_SIZE, &block.data_size);
+		block.name = name;
+		blocks.push_back(block);
+	}
+	return true;
+}
+
+void ShaderProgram::print() const {
+	printf("programme %u: %zu uniforms, %zu attributes, %zu blocks\n", id, uniforms.size(), attributes.size(), blocks.size());
+	for (size_t i = 0; i < uniforms.size(); ++i) {
+		const Variable& uniform = uniforms[i];
+		printf("  uniform   %-24s location %3i type 0x%04x size %i\n", uniform.name.c_str(), uniform.location, uniform.type, uniform.size);
+	}
+	for (size_t i = 0; i < attributes.size(); ++i) {
+		const Variable& attribute = attributes[i];
+		printf("  attribute %-24s location %3i type 0x%04x size %i\n", attribute.name.c_str(), attribute.location, attribute.type, attribute.size);
+	}
+	for (size_t i = 0; i < blocks.size(); ++i) {
+		const Block& block = blocks[i];
+		printf("  block     %-24s index    %3u bytes %i\n", block.name.c_str(), block.index, block.data_size);
+	}
+}
+
+const ShaderProgram::Variable* ShaderProgram::find_uniform(const char* name) const {
+	std::unordered_map<std::string, size_t>::const_iterator found = uniform_lookup.find(name);
+	if (found == uniform_lookup.end()) {
+		return nullptr;
+	}
+	return &uniforms[found->second];
+}
+
+const ShaderProgram::Block* ShaderProgram::find_block(const char* name) const {
+	// a program has a couple of blocks at most
+	for (size_t i = 0; i < blocks.size(); ++i) {
+		if (blocks[i].name == name) {
+			return &blocks[i];
+		}
+	}
+	return nullptr;
+}
+
+bool ShaderProgram::bind_block(const char* name, GLuint binding) const {
+	const Block* block = find_block(name);
+	if (!block) {
+		return false;
+	}
+	glUniformBlockBinding(id, block->index, binding);
+	return true;
+}
+
+int ShaderProgram::uniform_location(const char* name) const {
+	const Variable* uniform = find_uniform(name);
+	return uniform ? uniform->location : -1;
+}
+
+int ShaderProgram::attribute_location(const char* name) const {
+	std::unordered_map<std::string, size_t>::const_iterator found = attribute_lookup.find(name);
+	if (found == attribute_lookup.end()) {
+		return -1;
+	}
+	return attributes[found->second].location;
+}
+
+GLenum ShaderProgram::type_at(int location) const {
+	if (location >= (int)location_types.size()) {
+		return GL_NONE;
+	}
+	return location_types[location];
+}
+
+void ShaderProgram::set(int location, int value) const {
+	if (location < 0) {
+		return;
+	}
+	assert(is_int_type(type_at(location)));
+	glUniform1i(location, value);
+}
+
+void ShaderProgram::set(int location, float value) const {
+	if (location < 0) {
+		return;
+	}
+	assert(type_at(location) == GL_FLOAT);
+	glUniform1f(location, value);
+}
+
+void ShaderProgram::set(int location, const vec3& value) const {
+	if (location < 0) {
+		return;
+	}
+	assert(type_at(location) == GL_FLOAT_VEC3);
+	glUniform3fv(location, 1, value.v);
+}
+
+void ShaderProgram::set(int location, const vec4& value) const {
+	if (location < 0) {
+		return;
+	}
+	assert(type_at(location) == GL_FLOAT_VEC4);
+	glUniform4fv(location, 1, value.v);
+}
+
+void ShaderProgram::set(int location, const mat4& value) const {
+	if (location < 0) {
+		return;
+	}
+	assert(type_at(location) == GL_FLOAT_MAT4);
+	glUniformMatrix4fv(location, 1, GL_FALSE, value.m);
+}
+
+void ShaderProgram::set(int location, const mat4* values, int count) const {
+	if (location < 0 || count <= 0) {
+		return;
+	}
+	assert(type_at(location) == GL_FLOAT_MAT4);
+	// mat4 is 16 packed floats, an array of them is what GL expects
+	glUniformMatrix4fv(location, count, GL_FALSE, values[0].m);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <GL/Glew.h>
+#include "maths_funcs.h"
+
+// A linked program with its active uniforms and attributes read back once,
+// right after linking. Lookups by name go through the table here instead of
+// glGetUniformLocation, and are meant for setup code: the hot path keeps the
+// int locations and hands them to the typed setters.
+struct ShaderProgram {
+
+	struct Variable {
+		std::string name; // without the "[0]" GL appends to arrays
+		GLint location;
+		GLenum type;      // GL_FLOAT_VEC3, GL_SAMPLER_2D, ...
+		GLint size;       // array length, 1 otherwise
+	};
+
+	struct Block {
+		std::string name;
+		GLuint index;
+		GLint data_size; // bytes the std140 layout takes
+	};
+
+	GLuint id;
+	std::vector<Variable> uniforms;
+	std::vector<Variable> attributes;
+	std::vector<Block> blocks;
+
+	ShaderProgram();
+
+	// compiles, links and reflects; false when linking failed
+	bool load_from_files(const char* vert_file_name, const char* frag_file_name);
+	// reads the active uniforms, attributes and blocks of an already linked program
+	bool reflect(GLuint programme);
+	void print() const;
+
+	// -1 when the program has no such active variable, the setters ignore -1
+	int uniform_location(const char* name) const;
+	int attribute_location(const char* name) const;
+	const Variable* find_uniform(const char* name) const;
+	const Block* find_block(const char* name) const;
+
+	// GLSL 4.1 has no binding layout qualifier, blocks get their binding point
+	// here once after linking. False when the program does not use the block
+	bool bind_block(const char* name, GLuint binding) const;
+
+	// the program must be current. Debug builds check the GLSL type against
+	// the reflected one, samplers and bools are set through the int overload
+	void set(int location, int value) const;
+	void set(int location, float value) const;
+	void set(int location, const vec3& value) const;
+	void set(int location, const vec4& value) const;
+	void set(int location, const mat4& value) const;
+	void set(int location, const mat4* values, int count) const;
+
+private:
+	GLenum type_at(int location) const;
+
+	std::unordered_map<std::string, size_t> uniform_lookup;
+	std::unordered_map<std::string, size_t> attribute_lookup;
+	// GLSL type of every uniform location, array elements included
+	std::vector<GLenum> location_types;
+};
@@ -0,0 +1,48 @@
+#include "shape_geometry.h"
+
+// ---------------------------------------------------------------------------
+// Copied form exercise1
+
+void arrow_vertices(const vec3 &from, const vec3 &to, vec3 *vertices)
+{
+    // Vector with random deep decimals so using cross(one, axis) always yields a valid
+    // result for every arbitrary arrow we'd like to draw
+    vec3 one(0.5054846f, 0.5068565f, 0.5046546f);
+
+    const float sharpness = 0.1f; // edges sharpness: 0 = sharpest, 1 = flattest
+    const float length = 0.15f;   // edges length
+
+    vertices[0] = from;
+    vertices[1] = to;
+
+    // Rotation axis and inverse
+    auto axis_dir = to - from;
+    auto axis_inv = from - to;
+
+    // Point to rotate and angle of rotation
+    auto point = normalise(normalise(cross(one, axis_dir)) * sharpness + normalise(axis_inv) * 0.5f) * length;
+    auto alpha = 360.f / ArrowIterations;
+
+    // Rotate the point and save it's positions
+    for (unsigned int i = 0; i < ArrowIterations; i++)
+    {
+        // b = Ax
+        auto x = vec4(point, 1);
+        auto A = quat_to_mat4(quat_from_axis_deg(alpha * i, axis_dir.x, axis_dir.y, axis_dir.z)) * x;
+        auto b = vec3(A.x, A.y, A.z) + to;
+        vertices[i + 2] = b;
+    }
+}
+
+void arrow_indices(unsigned int *indices)
+{
+    indices[0] = 0; // from
+    indices[1] = 1; // to
+
+    // Make pairs of vertices to draw
+    for (unsigned int i = 0; i < ArrowIterations; i++)
+    {
+        indices[i * 2 + 2] = 1;     // to
+        indices[i * 2 + 3] = i + 2; // point
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "maths_funcs.h"
+
+// Vertex and index generation of the Shapes, without Lines and GL, so the
+// benchmarks time the same code the app runs.
+
+// an arrow is the from-to line plus ArrowIterations edges fanning back from the tip
+const int ArrowIterations = 25;
+const unsigned int ArrowVertexCount = ArrowIterations + 2;
+const unsigned int ArrowIndexCount = ArrowIterations * 2 + 2;
+
+// writes ArrowVertexCount points: from, to, then the tip's edges
+void arrow_vertices(const vec3& from, const vec3& to, vec3* vertices);
+// writes ArrowIndexCount indices, pairs of arrow_vertices() for GL_LINES
+void arrow_indices(unsigned int* indices);
@@ -9,7 +9,15 @@ in vec3 light_dir_tan;
 uniform sampler2D normal_map;
 uniform sampler2D diffuse_map;
 uniform vec3 diffuse_base_color;
-uniform vec3 ambient_color;
+
+// per frame, see Camera::Block
+layout(std140) uniform CameraBlock {
+	mat4 view;
+	mat4 proj;
+	mat4 view_proj;
+	vec4 camera_position;
+	vec4 ambient_color;
+};
 
 // output colour
 out vec4 frag_colour;
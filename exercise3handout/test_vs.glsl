@@ -5,8 +5,35 @@ layout(location = 1) in vec3 vertex_normal;
 layout(location = 2) in vec2 uvs0;
 layout(location = 3) in vec2 uvs1;
 layout(location = 4) in vec4 vtangent;
+// 5 to 9 are InstancedRenderer's
+layout(location = 10) in uvec4 bone_ids;
+layout(location = 11) in vec4 bone_weights;
 
-uniform mat4 model, view, proj;
+uniform mat4 model;
+
+// per frame, see Camera::Block
+layout(std140) uniform CameraBlock {
+	mat4 view;
+	mat4 proj;
+	mat4 view_proj;
+	vec4 camera_position;
+	vec4 ambient_color;
+};
+
+// vertex decode, see Meshgroup::VertexLayout. float layouts use offset 0,
+// scale 1 and plain normals
+uniform vec3 position_offset;
+uniform vec3 position_scale;
+uniform bool octahedral_normals;
+
+// bind pose to animated pose per bone, in mesh space. see
+// Meshgroup::Mesh::compute_bone_palette, 64 is Mesh::MaxBones. A block
+// rather than a plain array: 64 matrices are the whole 1024 components
+// GL 4.1 guarantees for the default block, a block gets 16 KB
+uniform bool skinned;
+layout(std140) uniform BonePalette {
+	mat4 bone_palette[64];
+};
 
 out vec4 test_tan;
 
@@ -15,9 +42,32 @@ out vec3 view_dir_tan;
 out vec3 light_dir_tan;
 out float vertex_distance;
 
+vec3 oct_decode(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
 void main() {
-	gl_Position =  proj * view * model * vec4 (vertex_position, 1.0);
+	vec3 position = position_offset + vertex_position * position_scale;
+	vec3 normal = octahedral_normals ? oct_decode(vertex_normal.xy) : vertex_normal;
+	// packed handedness may read back as -1/3 on GL 4.1, only its sign matters
+	vec4 tangent = vec4(vtangent.xyz, sign(vtangent.w));
+
+	// vertices without weights stay in the bind pose
+	if (skinned && dot(bone_weights, vec4(1.0)) > 0.0) {
+		mat4 skin = bone_palette[bone_ids.x] * bone_weights.x + bone_palette[bone_ids.y] * bone_weights.y +
+			bone_palette[bone_ids.z] * bone_weights.z + bone_palette[bone_ids.w] * bone_weights.w;
+		position = (skin * vec4(position, 1.0)).xyz;
+		normal = normalize(mat3(skin) * normal);
+		tangent.xyz = normalize(mat3(skin) * tangent.xyz);
+	}
+
+	gl_Position = view_proj * model * vec4 (position, 1.0);
 	mat3 modelRot = mat3(model);
-	vertex_distance = (modelRot*vertex_position).z;
+	vertex_distance = (modelRot*position).z;
 	st = uvs0;
+	test_tan = vec4(cross(normal, tangent.xyz) * tangent.w, 0.0);
 }
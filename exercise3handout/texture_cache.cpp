@@ -0,0 +1,140 @@
+#include "texture_cache.h"
+#include "gl_utils.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(WIN32) || defined(_WIN32)
+#define realpath(N, R) _fullpath((R), (N), _MAX_PATH)
+#endif
+
+namespace {
+
+	// "./a/../tex.png" and "tex.png" have to meet in one entry
+	std::string resolve_path(const std::string& file_name) {
+		char* resolved = realpath(file_name.c_str(), NULL);
+		if (!resolved) {
+			return file_name;
+		}
+		std::string ret(resolved);
+		free(resolved);
+		return ret;
+	}
+
+	// RGBA8 as decoded, the full mip chain adds another third on the GPU
+	size_t image_bytes(const TextureCache::Entry& entry) {
+		return (size_t)entry.x * entry.y * 4;
+	}
+}
+
+TextureCache& TextureCache::main() {
+	static TextureCache cache;
+	return cache;
+}
+
+size_t TextureCache::acquire(const std::string& file_name, bool pinned) {
+	std::string path = resolve_path(file_name);
+	std::map<std::string, size_t>::iterator found = lookup.find(path);
+	if (found != lookup.end()) {
+		Entry& entry = entries[found->second];
+		++entry.refs;
+		entry.requests += pinned ? 0 : 1;
+		return found->second;
+	}
+
+	Entry entry;
+	entry.path = path;
+	entry.image_data = nullptr;
+	entry.x = entry.y = entry.n = 0;
+	entry.tex = 0;
+	entry.refs = 1;
+	entry.requests = pinned ? 0 : 1;
+	entry.failed = false;
+	entries.push_back(entry);
+	lookup[path] = entries.size() - 1;
+	return entries.size() - 1;
+}
+
+size_t TextureCache::retain(size_t id) {
+	Entry& entry = entries[id];
+	assert(entry.refs > 0);
+	++entry.refs;
+	++entry.requests;
+	return id;
+}
+
+void TextureCache::release(size_t id) {
+	Entry& entry = entries[id];
+	if (entry.refs <= 0 || --entry.refs > 0) {
+		return;
+	}
+	if (entry.tex) {
+		glDeleteTextures(1, &entry.tex);
+		entry.tex = 0;
+	}
+	if (entry.image_data) {
+		unload_image_data(entry.image_data);
+		entry.image_data = nullptr;
+	}
+	lookup.erase(entry.path);
+	entry.path.clear();
+}
+
+bool TextureCache::needs_decode(size_t id) const {
+	const Entry& entry = entries[id];
+	return !entry.image_data && !entry.tex && !entry.failed;
+}
+
+void TextureCache::set_image(size_t id, unsigned char* image_data, int x, int y, int n, bool ok) {
+	Entry& entry = entries[id];
+	if (!needs_decode(id) || entry.refs <= 0) {
+		if (image_data) {
+			unload_image_data(image_data);
+		}
+		return;
+	}
+	entry.image_data = ok ? image_data : nullptr;
+	entry.x = x;
+	entry.y = y;
+	entry.n = n;
+	entry.failed = !ok;
+}
+
+GLuint TextureCache::upload(size_t id) {
+	Entry& entry = entries[id];
+	if (needs_decode(id)) {
+		unsigned char* image_data = nullptr;
+		int x = 0, y = 0, n = 0;
+		bool ok = load_image_data(entry.path.c_str(), &image_data, x, y, n);
+		set_image(id, image_data, x, y, n, ok);
+	}
+	if (!entry.tex && entry.image_data) {
+		load_texture_to_gpu(entry.image_data, &entry.tex, entry.x, entry.y, entry.n);
+	}
+	return entry.tex;
+}
+
+void TextureCache::print_report() const {
+	size_t unique = 0;
+	size_t requests = 0;
+	size_t bytes = 0;
+	size_t saved_bytes = 0;
+	for (size_t i = 0; i < entries.size(); ++i) {
+		const Entry& entry = entries[i];
+		if (entry.path.empty()) {
+			continue;
+		}
+		++unique;
+		requests += entry.requests;
+		bytes += image_bytes(entry);
+		// every request after the first reused the decode. pinned defaults are
+		// decoded with no request at all and save nothing
+		if (entry.requests > 1) {
+			saved_bytes += image_bytes(entry) * (size_t)(entry.requests - 1);
+		}
+	}
+	printf("texture cache: %zu textures for %zu requests, %.2f MB decoded, sharing saved %.2f MB of decodes and %.2f MB of GPU memory with mips\n",
+		unique, requests, bytes / (1024.0 * 1024.0), saved_bytes / (1024.0 * 1024.0),
+		saved_bytes * 4.0 / 3.0 / (1024.0 * 1024.0));
+}
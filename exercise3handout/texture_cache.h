@@ -0,0 +1,46 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include <GL/Glew.h>
+
+// Reference counted registry of textures keyed by resolved file path, so an
+// image shared by many meshes (an atlas, the default maps) is decoded and
+// uploaded once and every mesh binds the same GL handle. Ids stay valid
+// until the last reference is released. GL thread only.
+struct TextureCache {
+
+	struct Entry {
+		std::string path; // resolved, empty once released
+		unsigned char* image_data;
+		int x, y, n;
+		GLuint tex;       // 0 until uploaded
+		int refs;
+		int requests;     // acquire() calls over the lifetime of the entry
+		bool failed;      // decode failed, users fall back to a default
+	};
+
+	std::vector<Entry> entries;
+	std::map<std::string, size_t> lookup;
+
+	static TextureCache& main();
+
+	// finds or adds the entry for file_name and takes a reference. a pinned
+	// reference keeps the entry alive without counting as a request
+	size_t acquire(const std::string& file_name, bool pinned = false);
+	// another reference on a live entry, counted as a request. returns id
+	size_t retain(size_t id);
+	// deletes the GL texture and the pixels with the last reference
+	void release(size_t id);
+
+	// true while the entry has neither pixels nor a texture nor a failure
+	bool needs_decode(size_t id) const;
+	// hands over decoded pixels, freed straight away if someone got there first
+	void set_image(size_t id, unsigned char* image_data, int x, int y, int n, bool ok);
+	// decodes synchronously if still needed, uploads if needed and returns
+	// the GL texture, 0 when the image could not be loaded
+	GLuint upload(size_t id);
+
+	// unique textures against requests, and the decode/upload bytes sharing saved
+	void print_report() const;
+};
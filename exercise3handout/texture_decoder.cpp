@@ -0,0 +1,92 @@
+#include "texture_decoder.h"
+#include "thread_pool.h"
+#include "gl_utils.h"
+
+#include <stdio.h>
+
+TextureDecoder::TextureDecoder(ThreadPool& pool)
+	:pool(pool)
+	,wall_ms(0.0)
+	,running(0)
+	,unclaimed(0)
+{
+	prepare_image_decoding();
+}
+
+TextureDecoder::~TextureDecoder() {
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return running == 0; });
+}
+
+size_t TextureDecoder::push(const std::string& path) {
+	if (jobs.empty()) {
+		start = Clock::now();
+	}
+	size_t id = jobs.size();
+	jobs.push_back(Job());
+	// workers only ever touch their own job through this pointer, push_back
+	// on a deque does not move existing elements
+	Job* job = &jobs.back();
+	job->path = path;
+	job->image_data = nullptr;
+	job->x = job->y = job->n = 0;
+	job->ok = false;
+	job->decode_ms = job->ready_ms = 0.0;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		++running;
+		++unclaimed;
+	}
+	Clock::time_point start_time = start;
+	pool.submit([this, id, job, start_time] {
+		Clock::time_point begin = Clock::now();
+		job->ok = decode_image_data(job->path.c_str(), &job->image_data, job->x, job->y, job->n);
+		Clock::time_point end = Clock::now();
+		job->decode_ms = std::chrono::duration<double, std::milli>(end - begin).count();
+		job->ready_ms = std::chrono::duration<double, std::milli>(end - start_time).count();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		completed.push_back(id);
+		--running;
+		done.notify_all();
+	});
+	return id;
+}
+
+bool TextureDecoder::poll(std::vector<size_t>& finished, bool wait) {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (wait) {
+		done.wait(lock, [this] { return !completed.empty() || unclaimed == 0; });
+	}
+	finished.insert(finished.end(), completed.begin(), completed.end());
+	unclaimed -= completed.size();
+	completed.clear();
+	if (unclaimed == 0 && !jobs.empty() && wall_ms == 0.0) {
+		wall_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+	return unclaimed > 0;
+}
+
+const TextureDecoder::Job& TextureDecoder::job(size_t id) const {
+	return jobs[id];
+}
+
+size_t TextureDecoder::size() const {
+	return jobs.size();
+}
+
+void TextureDecoder::print_timings() const {
+	double sum_ms = 0.0;
+	double max_ms = 0.0;
+	for (size_t i = 0; i < jobs.size(); ++i) {
+		const Job& job = jobs[i];
+		printf("  texture %-40s %5dx%-5d decode %8.2f ms  ready at %8.2f ms%s\n", job.path.c_str(), job.x, job.y,
+			job.decode_ms, job.ready_ms, job.ok ? "" : "  FAILED");
+		sum_ms += job.decode_ms;
+		max_ms = job.decode_ms > max_ms ? job.decode_ms : max_ms;
+	}
+	// submit() leaves the caller's queue alone
+	size_t workers = pool.size() > 1 ? pool.size() - 1 : 1;
+	printf("  %zu textures on %zu workers: sum of decodes %.2f ms, slowest %.2f ms, all ready after %.2f ms\n",
+		jobs.size(), workers, sum_ms, max_ms, wall_ms);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct ThreadPool;
+
+// Decodes image files on a ThreadPool while the loading thread carries on
+// with geometry. The GL thread collects finished jobs with poll() and
+// uploads them as they come in, so startup costs about the slowest decode
+// rather than the sum of all of them.
+struct TextureDecoder {
+
+	typedef std::chrono::steady_clock Clock;
+
+	struct Job {
+		std::string path;
+		unsigned char* image_data;
+		int x, y, n;
+		bool ok;
+		double decode_ms; // time spent inside stb_image
+		double ready_ms;  // from the first push() until decoded
+	};
+
+	explicit TextureDecoder(ThreadPool& pool);
+	// waits for jobs still running, they write into this object
+	~TextureDecoder();
+
+	// queues a decode and returns its job id
+	size_t push(const std::string& path);
+
+	// appends the ids finished since the last call to finished. with wait it
+	// blocks until at least one is available. false once every job was handed out
+	bool poll(std::vector<size_t>& finished, bool wait);
+
+	// only valid once the id came out of poll()
+	const Job& job(size_t id) const;
+	size_t size() const;
+
+	// one line per texture plus sum-of-decodes against wall time
+	void print_timings() const;
+
+private:
+	TextureDecoder(const TextureDecoder&);
+	TextureDecoder& operator=(const TextureDecoder&);
+
+	ThreadPool& pool;
+	// a deque so pushing never moves a job a worker is writing to
+	std::deque<Job> jobs;
+	Clock::time_point start;
+	double wall_ms;
+
+	std::mutex mutex;
+	std::condition_variable done;
+	std::vector<size_t> completed;
+	size_t running;    // pushed, not finished
+	size_t unclaimed;  // pushed, not yet returned by poll()
+};
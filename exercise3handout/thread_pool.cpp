@@ -0,0 +1,135 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threadCount)
+	:pending(0)
+	,nextQueue(0)
+	,stopping(false)
+{
+	if (threadCount == 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	for (unsigned i = 0; i < threadCount; ++i) {
+		queues.emplace_back(new Queue());
+	}
+	// queue 0 belongs to the caller of parallelFor()
+	for (unsigned i = 1; i < threadCount; ++i) {
+		threads.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < threads.size(); ++i) {
+		threads[i].join();
+	}
+}
+
+size_t ThreadPool::size() const {
+	return queues.size();
+}
+
+void ThreadPool::push(size_t queue, Task task) {
+	{
+		std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+		queues[queue]->tasks.push_back(std::move(task));
+	}
+	++pending;
+}
+
+bool ThreadPool::pop(size_t queue, Task& task) {
+	std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+	std::deque<Task>& tasks = queues[queue]->tasks;
+	if (tasks.empty()) {
+		return false;
+	}
+	task = std::move(tasks.back());
+	tasks.pop_back();
+	--pending;
+	return true;
+}
+
+bool ThreadPool::steal(size_t thief, Task& task) {
+	size_t count = queues.size();
+	for (size_t i = 1; i < count; ++i) {
+		Queue& victim = *queues[(thief + i) % count];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			--pending;
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+	for (;;) {
+		Task task;
+		if (pop(index, task) || steal(index, task)) {
+			task();
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(wakeMutex);
+		wake.wait(lock, [this] { return stopping || pending > 0; });
+		if (stopping) {
+			return;
+		}
+	}
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body) {
+	grain = std::max<size_t>(grain, 1);
+	size_t chunks = (count + grain - 1) / grain;
+	if (chunks <= 1 || queues.size() == 1) {
+		if (count > 0) {
+			body(0, count);
+		}
+		return;
+	}
+
+	std::atomic<size_t> remaining(chunks);
+	// deal the chunks round-robin, stealing evens out the rest
+	for (size_t c = 0; c < chunks; ++c) {
+		size_t begin = c * grain;
+		size_t end = std::min(begin + grain, count);
+		push(c % queues.size(), [&body, &remaining, begin, end] {
+			body(begin, end);
+			--remaining;
+		});
+	}
+	{
+		// lock so no worker can miss the notification between its check and its wait
+		std::lock_guard<std::mutex> lock(wakeMutex);
+	}
+	wake.notify_all();
+
+	while (remaining > 0) {
+		Task task;
+		if (pop(0, task) || steal(0, task)) {
+			task();
+		}
+		else {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void ThreadPool::submit(Task task) {
+	if (queues.size() == 1) {
+		task();
+		return;
+	}
+	// skip queue 0, nobody drains it outside parallelFor()
+	push(1 + nextQueue++ % (queues.size() - 1), std::move(task));
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+	}
+	wake.notify_one();
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool. Every worker owns a deque, pops work from its
+// back and steals from the front of the others when it runs dry. The thread
+// calling parallelFor() owns queue 0 and helps until its batch is done.
+// submit() hands a task to the workers and returns straight away.
+struct ThreadPool {
+
+	typedef std::function<void()> Task;
+
+	// threadCount includes the calling thread, 0 means one per hardware thread
+	explicit ThreadPool(unsigned threadCount = 0);
+	~ThreadPool();
+
+	size_t size() const;
+
+	// runs body(begin, end) over [0, count) in chunks of at most grain items
+	// and returns when all of them are done
+	void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+	// runs task on a worker without waiting for it, inline if there are no
+	// workers. signalling completion is up to the task
+	void submit(Task task);
+
+private:
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	void push(size_t queue, Task task);
+	bool pop(size_t queue, Task& task);
+	bool steal(size_t thief, Task& task);
+	void workerLoop(size_t index);
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> threads;
+
+	std::mutex wakeMutex;
+	std::condition_variable wake;
+	std::atomic<size_t> pending;
+	std::atomic<size_t> nextQueue; // round robin for submit()
+	bool stopping;
+};
@@ -0,0 +1,268 @@
+#include "transform_hierarchy.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <atomic>
+
+#include "node.h"
+#include "thread_pool.h"
+
+namespace {
+	// reorders v so that v[i] = old v[order[i]]
+	template <typename T>
+	void permute(std::vector<T>& v, const std::vector<int>& order) {
+		std::vector<T> tmp(v.size());
+		for (size_t i = 0; i < order.size(); ++i) {
+			tmp[i] = v[order[i]];
+		}
+		v.swap(tmp);
+	}
+}
+
+TransformHierarchy::TransformHierarchy()
+	:sorted(true)
+	,localUpdateCount(0)
+	,worldUpdateCount(0)
+{ ; }
+
+TransformHierarchy& TransformHierarchy::main() {
+	static TransformHierarchy hierarchy;
+	return hierarchy;
+}
+
+int TransformHierarchy::add(Node* handle) {
+	int index = static_cast<int>(handles.size());
+
+	parents.push_back(-1);
+	positions.push_back(vec3(0, 0, 0));
+	rotations.push_back(versor(0, 0, 0, 1));
+	scales.push_back(vec3(1, 1, 1));
+
+	localMatrices.push_back(identity_mat4());
+	worldMatrices.push_back(identity_mat4());
+	localInverseMatrices.push_back(identity_mat4());
+	worldInverseMatrices.push_back(identity_mat4());
+
+	flags.push_back(LocalDirty | WorldDirty);
+	handles.push_back(handle);
+	// a new root lands after the deepest level
+	sorted = false;
+	return index;
+}
+
+void TransformHierarchy::remove(int index) {
+	handles[index] = nullptr;
+	flags[index] = Free;
+}
+
+void TransformHierarchy::setParent(int index, int parent) {
+	assert(index != parent);
+	parents[index] = parent;
+	flags[index] |= WorldDirty;
+	// depths changed for the whole subtree, re-sort before the next update
+	sorted = false;
+}
+
+void TransformHierarchy::markLocalDirty(int index) {
+	flags[index] |= LocalDirty;
+}
+
+void TransformHierarchy::setEagerInverse(int index, bool eager) {
+	if (eager) {
+		flags[index] |= EagerInverse;
+	}
+	else {
+		flags[index] &= ~EagerInverse;
+	}
+}
+
+size_t TransformHierarchy::size() const {
+	return handles.size();
+}
+
+void TransformHierarchy::sort() {
+	size_t count = size();
+
+	// depth of every slot, walking up until we hit a slot with a known depth
+	std::vector<int> depths(count, -1);
+	std::vector<int> chain;
+	for (size_t i = 0; i < count; ++i) {
+		int current = static_cast<int>(i);
+		while (current >= 0 && depths[current] < 0) {
+			chain.push_back(current);
+			current = parents[current];
+		}
+		int depth = current >= 0 ? depths[current] : -1;
+		while (!chain.empty()) {
+			depths[chain.back()] = ++depth;
+			chain.pop_back();
+		}
+	}
+
+	// stable so siblings keep their relative order
+	std::vector<int> order(count);
+	for (size_t i = 0; i < count; ++i) {
+		order[i] = static_cast<int>(i);
+	}
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return depths[a] < depths[b]; });
+
+	std::vector<int> remap(count);
+	for (size_t i = 0; i < count; ++i) {
+		remap[order[i]] = static_cast<int>(i);
+	}
+
+	permute(parents, order);
+	permute(positions, order);
+	permute(rotations, order);
+	permute(scales, order);
+	permute(localMatrices, order);
+	permute(worldMatrices, order);
+	permute(localInverseMatrices, order);
+	permute(worldInverseMatrices, order);
+	permute(flags, order);
+	permute(handles, order);
+
+	levelStarts.clear();
+	for (size_t i = 0; i < count; ++i) {
+		if (parents[i] >= 0) {
+			parents[i] = remap[parents[i]];
+		}
+		if (handles[i] != nullptr) {
+			handles[i]->index = static_cast<int>(i);
+		}
+		if (static_cast<int>(levelStarts.size()) <= depths[order[i]]) {
+			levelStarts.push_back(i);
+		}
+	}
+	levelStarts.push_back(count);
+	sorted = true;
+}
+
+void TransformHierarchy::updateLocal(int index) {
+	const vec3& position = positions[index];
+	float sx = scales[index].v[0], sy = scales[index].v[1], sz = scales[index].v[2];
+
+	// T*R*S without the products: the columns of quat_to_mat4() scaled, then
+	// the position. Spelled out, a mat4 in between gets shuffled through the
+	// stack once quat_to_mat4() is inlined here
+	const versor& q = rotations[index];
+	float w = q.q[0], x = q.q[1], y = q.q[2], z = q.q[3];
+	float* m = localMatrices[index].m;
+	m[0] = (1.0f - 2.0f * y * y - 2.0f * z * z) * sx;
+	m[1] = (2.0f * x * y + 2.0f * w * z) * sx;
+	m[2] = (2.0f * x * z - 2.0f * w * y) * sx;
+	m[3] = 0.f;
+	m[4] = (2.0f * x * y - 2.0f * w * z) * sy;
+	m[5] = (1.0f - 2.0f * x * x - 2.0f * z * z) * sy;
+	m[6] = (2.0f * y * z + 2.0f * w * x) * sy;
+	m[7] = 0.f;
+	m[8] = (2.0f * x * z + 2.0f * w * y) * sz;
+	m[9] = (2.0f * y * z - 2.0f * w * x) * sz;
+	m[10] = (1.0f - 2.0f * x * x - 2.0f * y * y) * sz;
+	m[11] = 0.f;
+	localMatrices[index].setColumn(3, vec4(position, 1.f));
+
+	flags[index] = (flags[index] & ~LocalDirty) | WorldDirty | LocalInverseDirty;
+}
+
+const mat4& TransformHierarchy::localInverse(int index) {
+	if (flags[index] & LocalInverseDirty) {
+		// Sinv*transpose(R)*Tinv: row c of transpose(R) divided by scale c,
+		// then the position taken through it
+		const vec3& position = positions[index];
+		const vec3& scale = scales[index];
+		mat4 R = quat_to_mat4(rotations[index]);
+
+		mat4& inv = localInverseMatrices[index];
+		for (int c = 0; c < 3; ++c) {
+			float s = 1.f / scale.v[c];
+			inv.m[0 * 4 + c] = R.m[c * 4 + 0] * s;
+			inv.m[1 * 4 + c] = R.m[c * 4 + 1] * s;
+			inv.m[2 * 4 + c] = R.m[c * 4 + 2] * s;
+			inv.m[3 * 4 + c] = -(inv.m[0 * 4 + c] * position.v[0] + inv.m[1 * 4 + c] * position.v[1] +
+				inv.m[2 * 4 + c] * position.v[2]);
+		}
+		inv.setRow(3, vec4(0.f, 0.f, 0.f, 1.f));
+
+		flags[index] &= ~LocalInverseDirty;
+	}
+	return localInverseMatrices[index];
+}
+
+const mat4& TransformHierarchy::worldInverse(int index) {
+	if (flags[index] & WorldInverseDirty) {
+		worldInverseMatrices[index] = inverse_affine(worldMatrices[index]);
+		flags[index] &= ~WorldInverseDirty;
+	}
+	return worldInverseMatrices[index];
+}
+
+void TransformHierarchy::update(ThreadPool* pool) {
+	if (!sorted) {
+		sort();
+	}
+
+	if (pool == nullptr) {
+		localUpdateCount = 0;
+		worldUpdateCount = 0;
+		updateRange(0, size(), localUpdateCount, worldUpdateCount);
+		return;
+	}
+
+	std::atomic<size_t> localCount(0);
+	std::atomic<size_t> worldCount(0);
+	for (size_t level = 0; level + 1 < levelStarts.size(); ++level) {
+		size_t start = levelStarts[level];
+		size_t end = levelStarts[level + 1];
+		pool->parallelFor(end - start, ParallelGrain, [&](size_t begin, size_t finish) {
+			size_t locals = 0;
+			size_t worlds = 0;
+			updateRange(start + begin, start + finish, locals, worlds);
+			localCount += locals;
+			worldCount += worlds;
+		});
+	}
+	localUpdateCount = localCount;
+	worldUpdateCount = worldCount;
+}
+
+void TransformHierarchy::updateRange(size_t begin, size_t end, size_t& localCount, size_t& worldCount) {
+	// every node is visited, but only its flag byte is touched unless it or
+	// one of its ancestors changed. WorldChanged is reset when the node itself
+	// is visited, so children (always later in the array) see this pass' value
+	for (size_t i = begin; i < end; ++i) {
+		int parent = parents[i];
+		unsigned char flag = flags[i];
+		if (flag & Free) {
+			continue;
+		}
+
+		if (flag & LocalDirty) {
+			updateLocal(static_cast<int>(i));
+			flag = flags[i];
+			++localCount;
+		}
+		if (parent >= 0 && (flags[parent] & WorldChanged)) {
+			flag |= WorldDirty;
+		}
+		if (!(flag & WorldDirty)) {
+			flags[i] = flag & ~WorldChanged;
+			continue;
+		}
+
+		if (parent < 0) {
+			worldMatrices[i] = localMatrices[i];
+		}
+		else {
+			// parent < i, so its world matrix is already up to date
+			worldMatrices[i] = worldMatrices[parent] * localMatrices[i];
+		}
+		flag = (flag & ~WorldDirty) | WorldChanged | WorldInverseDirty;
+		if (flag & EagerInverse) {
+			worldInverseMatrices[i] = inverse_affine(worldMatrices[i]);
+			flag &= ~WorldInverseDirty;
+		}
+		flags[i] = flag;
+		++worldCount;
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <vector>
+#include "maths_funcs.h"
+
+struct Node;
+struct ThreadPool;
+
+// Flat, structure-of-arrays storage for the transforms of a Node tree.
+// Every Node is a handle to one slot. Slots are kept sorted by depth so a
+// parent always comes before its children and the world pass is one linear
+// loop: world[i] = world[parent[i]] * local[i]
+struct TransformHierarchy {
+
+	enum Flags {
+		LocalDirty = 1 << 0,        // position, rotation or scale changed
+		WorldDirty = 1 << 1,        // parent or local changed, world needs recomputing
+		WorldChanged = 1 << 2,      // world was recomputed in the last update()
+		LocalInverseDirty = 1 << 3, // cached local inverse is stale
+		WorldInverseDirty = 1 << 4, // cached world inverse is stale
+		EagerInverse = 1 << 5,      // recompute the world inverse in update()
+		Free = 1 << 6,              // the Node was destroyed, update() skips the slot
+	};
+
+	std::vector<int> parents; // -1 for roots
+
+	std::vector<vec3> positions;
+	std::vector<versor> rotations;
+	std::vector<vec3> scales;
+
+	std::vector<mat4> localMatrices;
+	std::vector<mat4> worldMatrices;
+
+	// computed on first query after a change, see localInverse/worldInverse
+	std::vector<mat4> localInverseMatrices;
+	std::vector<mat4> worldInverseMatrices;
+
+	std::vector<unsigned char> flags;
+
+	// back pointers so Node::index can be patched when slots are reordered
+	std::vector<Node*> handles;
+
+	// false after a reparent, until the slots are re-sorted by depth
+	bool sorted;
+	// first slot of every depth plus one past the last slot. nodes of one
+	// level only depend on the previous levels so a level can run in parallel
+	std::vector<size_t> levelStarts;
+
+	// nodes recomputed by the last update()
+	size_t localUpdateCount;
+	size_t worldUpdateCount;
+
+	TransformHierarchy();
+
+	// hierarchy used by Node::init() when none is given
+	static TransformHierarchy& main();
+
+	int add(Node* handle);
+	// the slot stays where it is, children keep its last world matrix
+	void remove(int index);
+	void setParent(int index, int parent);
+	void markLocalDirty(int index);
+	// nodes whose inverse is read every frame, or from other threads, can have
+	// it computed during update() instead of on the first query
+	void setEagerInverse(int index, bool eager);
+	size_t size() const;
+
+	void sort();
+	void updateLocal(int index);
+	// lazy, not safe to call for the same node from several threads
+	const mat4& localInverse(int index);
+	const mat4& worldInverse(int index);
+	// only recomputes dirty nodes and the subtrees below them. with a pool,
+	// levels are split across its threads; the result is identical to the
+	// serial update
+	void update(ThreadPool* pool = nullptr);
+	void updateRange(size_t begin, size_t end, size_t& localCount, size_t& worldCount);
+
+	// levels smaller than this are not worth handing to other threads
+	static const size_t ParallelGrain = 512;
+};
@@ -0,0 +1,308 @@
+#include "triangle_bvh.h"
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <utility>
+
+namespace {
+
+	float half_area(const AABB& box) {
+		float x = box.max.x - box.min.x;
+		float y = box.max.y - box.min.y;
+		float z = box.max.z - box.min.z;
+		return x * y + y * z + z * x;
+	}
+
+	AABB empty_box() {
+		AABB box;
+		box.min = vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+		box.max = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		return box;
+	}
+
+	void grow(AABB& box, const AABB& other) {
+		for (int a = 0; a < 3; ++a) {
+			box.min.v[a] = fminf(box.min.v[a], other.min.v[a]);
+			box.max.v[a] = fmaxf(box.max.v[a], other.max.v[a]);
+		}
+	}
+
+	void grow(AABB& box, const float* point) {
+		for (int a = 0; a < 3; ++a) {
+			box.min.v[a] = fminf(box.min.v[a], point[a]);
+			box.max.v[a] = fmaxf(box.max.v[a], point[a]);
+		}
+	}
+
+	struct Bin {
+		AABB box;
+		uint32_t count;
+	};
+
+	// a node still to be split, over order[begin, end)
+	struct Pending {
+		uint32_t node;
+		uint32_t begin;
+		uint32_t end;
+		int depth;
+	};
+}
+
+void TriangleBVH::clear() {
+	nodes.clear();
+	triangles.clear();
+	faces.clear();
+}
+
+bool TriangleBVH::empty() const {
+	return nodes.empty();
+}
+
+void TriangleBVH::build(const float* positions, size_t vertex_count, const uint32_t* indices, size_t index_count) {
+	clear();
+	size_t face_count = index_count / 3;
+	if (positions == nullptr || indices == nullptr || face_count == 0) {
+		return;
+	}
+
+	std::vector<AABB> boxes(face_count);
+	std::vector<vec3> centroids(face_count);
+	std::vector<uint32_t> order(face_count);
+	for (size_t f = 0; f < face_count; ++f) {
+		AABB box = empty_box();
+		for (int k = 0; k < 3; ++k) {
+			uint32_t index = indices[f * 3 + k];
+			assert(index < vertex_count);
+			grow(box, positions + index * 3);
+		}
+		boxes[f] = box;
+		centroids[f] = box.center();
+		order[f] = (uint32_t)f;
+	}
+	(void)vertex_count;
+
+	nodes.reserve(face_count * 2);
+	nodes.push_back(Node());
+	std::vector<Pending> pending;
+	Pending whole = { 0, 0, (uint32_t)face_count, 1 };
+	pending.push_back(whole);
+
+	while (!pending.empty()) {
+		Pending work = pending.back();
+		pending.pop_back();
+
+		AABB box = empty_box();
+		AABB centroid_box = empty_box();
+		for (uint32_t i = work.begin; i < work.end; ++i) {
+			grow(box, boxes[order[i]]);
+			grow(centroid_box, centroids[order[i]].v);
+		}
+		nodes[work.node].box = box;
+		nodes[work.node].first = work.begin;
+		nodes[work.node].count = work.end - work.begin;
+
+		uint32_t count = work.end - work.begin;
+		if (count <= (uint32_t)MaxLeafSize || work.depth >= StackSize - 1) {
+			continue;
+		}
+
+		// bin the centroids along every axis and keep the cheapest plane
+		int best_axis = -1;
+		int best_plane = 0;
+		float best_cost = FLT_MAX;
+		for (int axis = 0; axis < 3; ++axis) {
+			float lo = centroid_box.min.v[axis];
+			float extent = centroid_box.max.v[axis] - lo;
+			if (extent <= 0.f) {
+				continue;
+			}
+			float scale = BinCount / extent;
+			Bin bins[BinCount];
+			for (int b = 0; b < BinCount; ++b) {
+				bins[b].box = empty_box();
+				bins[b].count = 0;
+			}
+			for (uint32_t i = work.begin; i < work.end; ++i) {
+				int b = (int)((centroids[order[i]].v[axis] - lo) * scale);
+				b = b < BinCount ? b : BinCount - 1;
+				bins[b].count++;
+				grow(bins[b].box, boxes[order[i]]);
+			}
+			// sweep from the right to know the area above every plane
+			float right_area[BinCount];
+			uint32_t right_count[BinCount];
+			AABB right = empty_box();
+			uint32_t right_sum = 0;
+			for (int b = BinCount - 1; b > 0; --b) {
+				grow(right, bins[b].box);
+				right_sum += bins[b].count;
+				right_area[b] = right_sum ? half_area(right) : 0.f;
+				right_count[b] = right_sum;
+			}
+			AABB left = empty_box();
+			uint32_t left_sum = 0;
+			for (int plane = 1; plane < BinCount; ++plane) {
+				grow(left, bins[plane - 1].box);
+				left_sum += bins[plane - 1].count;
+				if (left_sum == 0 || right_count[plane] == 0) {
+					continue;
+				}
+				float cost = left_sum * half_area(left) + right_count[plane] * right_area[plane];
+				if (cost < best_cost) {
+					best_cost = cost;
+					best_axis = axis;
+					best_plane = plane;
+				}
+			}
+		}
+		if (best_axis < 0) {
+			continue; // every centroid in one spot, nothing to split
+		}
+
+		float lo = centroid_box.min.v[best_axis];
+		float scale = BinCount / (centroid_box.max.v[best_axis] - lo);
+		uint32_t middle = work.begin;
+		for (uint32_t i = work.begin; i < work.end; ++i) {
+			int b = (int)((centroids[order[i]].v[best_axis] - lo) * scale);
+			b = b < BinCount ? b : BinCount - 1;
+			if (b < best_plane) {
+				uint32_t t = order[i];
+				order[i] = order[middle];
+				order[middle] = t;
+				++middle;
+			}
+		}
+
+		uint32_t left_child = (uint32_t)nodes.size();
+		nodes.push_back(Node());
+		nodes.push_back(Node());
+		nodes[work.node].first = left_child;
+		nodes[work.node].count = 0;
+		Pending left_work = { left_child, work.begin, middle, work.depth + 1 };
+		Pending right_work = { left_child + 1, middle, work.end, work.depth + 1 };
+		pending.push_back(left_work);
+		pending.push_back(right_work);
+	}
+
+	triangles.resize(face_count);
+	faces = order;
+	for (size_t i = 0; i < face_count; ++i) {
+		const uint32_t* corners = indices + order[i] * 3;
+		const float* p0 = positions + corners[0] * 3;
+		const float* p1 = positions + corners[1] * 3;
+		const float* p2 = positions + corners[2] * 3;
+		Triangle& triangle = triangles[i];
+		for (int a = 0; a < 3; ++a) {
+			triangle.v0[a] = p0[a];
+			triangle.e1[a] = p1[a] - p0[a];
+			triangle.e2[a] = p2[a] - p0[a];
+		}
+	}
+}
+
+bool TriangleBVH::raycast(const vec3& origin, const vec3& direction, float max_distance, TriangleHit* hit) const {
+	if (nodes.empty()) {
+		return false;
+	}
+	RaySlabs ray(origin, direction);
+	const float* o = origin.v;
+	const float* d = direction.v;
+
+	float best = max_distance;
+	bool found = false;
+	float t = 0.f;
+	if (!intersect_ray_aabb(ray, nodes[0].box, best, &t)) {
+		return false;
+	}
+
+	uint32_t stack[StackSize];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const Node& node = nodes[stack[--top]];
+		if (node.count > 0) {
+			// Moller-Trumbore, both sides
+			for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+				const Triangle& tri = triangles[i];
+				float p[3] = { d[1] * tri.e2[2] - d[2] * tri.e2[1], d[2] * tri.e2[0] - d[0] * tri.e2[2],
+					d[0] * tri.e2[1] - d[1] * tri.e2[0] };
+				float det = tri.e1[0] * p[0] + tri.e1[1] * p[1] + tri.e1[2] * p[2];
+				if (fabsf(det) < 1e-12f) {
+					continue;
+				}
+				float inverse = 1.f / det;
+				float s[3] = { o[0] - tri.v0[0], o[1] - tri.v0[1], o[2] - tri.v0[2] };
+				float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inverse;
+				if (u < 0.f || u > 1.f) {
+					continue;
+				}
+				float q[3] = { s[1] * tri.e1[2] - s[2] * tri.e1[1], s[2] * tri.e1[0] - s[0] * tri.e1[2],
+					s[0] * tri.e1[1] - s[1] * tri.e1[0] };
+				float v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inverse;
+				if (v < 0.f || u + v > 1.f) {
+					continue;
+				}
+				float distance = (tri.e2[0] * q[0] + tri.e2[1] * q[1] + tri.e2[2] * q[2]) * inverse;
+				if (distance < 0.f || distance >= best) {
+					continue;
+				}
+				best = distance;
+				found = true;
+				hit->distance = distance;
+				hit->triangle = faces[i];
+				hit->u = u;
+				hit->v = v;
+			}
+			continue;
+		}
+
+		// nearer child on top, the farther one is often skipped once best shrinks
+		float t_left = 0.f;
+		float t_right = 0.f;
+		bool hit_left = intersect_ray_aabb(ray, nodes[node.first].box, best, &t_left);
+		bool hit_right = intersect_ray_aabb(ray, nodes[node.first + 1].box, best, &t_right);
+		if (hit_left && hit_right) {
+			assert(top + 2 <= StackSize);
+			bool left_first = t_left <= t_right;
+			stack[top++] = left_first ? node.first + 1 : node.first;
+			stack[top++] = left_first ? node.first : node.first + 1;
+		}
+		else if (hit_left || hit_right) {
+			assert(top + 1 <= StackSize);
+			stack[top++] = hit_left ? node.first : node.first + 1;
+		}
+	}
+	return found;
+}
+
+int TriangleBVH::depth() const {
+	if (nodes.empty()) {
+		return 0;
+	}
+	std::vector<std::pair<uint32_t, int> > stack(1, std::make_pair(0u, 1));
+	int deepest = 0;
+	while (!stack.empty()) {
+		std::pair<uint32_t, int> entry = stack.back();
+		stack.pop_back();
+		deepest = entry.second > deepest ? entry.second : deepest;
+		const Node& node = nodes[entry.first];
+		if (node.count == 0) {
+			stack.push_back(std::make_pair(node.first, entry.second + 1));
+			stack.push_back(std::make_pair(node.first + 1, entry.second + 1));
+		}
+	}
+	return deepest;
+}
+
+bool raycast_mesh_space(const TriangleBVH& bvh, const mat4& worldInverse, const vec3& origin, const vec3& direction,
+	float max_distance, TriangleHit* hit) {
+	const float* m = worldInverse.m;
+	vec3 local_origin;
+	vec3 local_direction;
+	for (int row = 0; row < 3; ++row) {
+		local_origin.v[row] = m[row] * origin.x + m[4 + row] * origin.y + m[8 + row] * origin.z + m[12 + row];
+		local_direction.v[row] = m[row] * direction.x + m[4 + row] * direction.y + m[8 + row] * direction.z;
+	}
+	return bvh.raycast(local_origin, local_direction, max_distance, hit);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "bounds.h"
+
+struct TriangleHit {
+	float distance;    // along the ray, in units of the direction's length
+	uint32_t triangle; // face index, faces_indices[triangle * 3 + k] are its corners
+	float u, v;        // barycentrics: the point is (1 - u - v) * v0 + u * v1 + v * v2
+};
+
+// Static bounding volume hierarchy over the triangles of one mesh, for exact
+// picking. Built once from the mesh's positions and indices, split with a
+// binned surface area heuristic, and stored flat: the two children of a
+// node are next to each other and leaves hold a range of triangles. The
+// triangles are copied in leaf order, so a query never touches the mesh.
+struct TriangleBVH {
+
+	struct Node {
+		AABB box;
+		uint32_t first; // first child for inner nodes, first triangle for leaves
+		uint32_t count; // triangles in a leaf, 0 for inner nodes
+	};
+
+	// a corner and the two edges leaving it, what Moller-Trumbore needs
+	struct Triangle {
+		float v0[3];
+		float e1[3];
+		float e2[3];
+	};
+
+	std::vector<Node> nodes;
+	std::vector<Triangle> triangles;
+	std::vector<uint32_t> faces; // face index of every entry of triangles
+
+	// positions are xyz triplets, indices three per face. Replaces the tree
+	void build(const float* positions, size_t vertex_count, const uint32_t* indices, size_t index_count);
+	void clear();
+	bool empty() const;
+
+	// closest triangle hit in front of the origin within max_distance. Both
+	// sides of a triangle count. direction needs not be normalised
+	bool raycast(const vec3& origin, const vec3& direction, float max_distance, TriangleHit* hit) const;
+
+	int depth() const;
+
+private:
+	static const int MaxLeafSize = 4;
+	static const int BinCount = 12;
+	static const int StackSize = 64;
+};
+
+// raycast with a world space ray: worldInverse takes it into the space the
+// tree was built in. Distances stay in units of the direction's length
+bool raycast_mesh_space(const TriangleBVH& bvh, const mat4& worldInverse, const vec3& origin, const vec3& direction,
+	float max_distance, TriangleHit* hit);
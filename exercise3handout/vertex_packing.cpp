@@ -0,0 +1,198 @@
+#include "vertex_packing.h"
+
+#include <math.h>
+#include <string.h>
+
+/*-----------------------------------HALF-------------------------------------*/
+uint16_t float_to_half(float f) {
+	uint32_t x;
+	memcpy(&x, &f, sizeof(x));
+	uint16_t sign = (uint16_t)((x >> 16) & 0x8000);
+	uint32_t a = x & 0x7fffffff;
+
+	if (a >= 0x7f800000) { // inf, nan stays a (quiet) nan
+		return sign | 0x7c00 | (a > 0x7f800000 ? 0x200 : 0);
+	}
+	if (a >= 0x477ff000) { // rounds to 65520 or more
+		return sign | 0x7c00;
+	}
+	if (a < 0x38800000) { // below 2^-14, denormal half
+		if (a < 0x33000000) { // below 2^-25, rounds to zero
+			return sign;
+		}
+		uint32_t shift = 126 - (a >> 23);
+		uint32_t m = (a & 0x7fffff) | 0x800000;
+		uint32_t h = m >> shift;
+		uint32_t rem = m & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (rem > halfway || (rem == halfway && (h & 1))) {
+			++h;
+		}
+		return sign | (uint16_t)h;
+	}
+	// rebias the exponent from 127 to 15 and drop 13 mantissa bits
+	uint32_t h = (a - 0x38000000) >> 13;
+	uint32_t rem = a & 0x1fff;
+	if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) {
+		++h;
+	}
+	return sign | (uint16_t)h;
+}
+
+float half_to_float(uint16_t h) {
+	uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	uint32_t exponent = (h >> 10) & 0x1f;
+	uint32_t mantissa = h & 0x3ff;
+	if (exponent == 0) {
+		float f = ldexpf((float)mantissa, -24);
+		return sign ? -f : f;
+	}
+	uint32_t x = exponent == 31
+		? sign | 0x7f800000 | (mantissa << 13)
+		: sign | ((exponent + 112) << 23) | (mantissa << 13);
+	float f;
+	memcpy(&f, &x, sizeof(f));
+	return f;
+}
+
+/*---------------------------------NORMALS------------------------------------*/
+namespace {
+
+	float sign_not_zero(float f) {
+		return f >= 0.f ? 1.f : -1.f;
+	}
+
+	float clamp_unit(float f) {
+		return f < -1.f ? -1.f : (f > 1.f ? 1.f : f);
+	}
+
+	int16_t to_snorm16(float f) {
+		return (int16_t)lroundf(clamp_unit(f) * 32767.f);
+	}
+
+	// GL 4.2+ snorm rule, 4.1 drivers differ by less than half a step
+	float from_snorm16(int16_t s) {
+		float f = s / 32767.f;
+		return f < -1.f ? -1.f : f;
+	}
+}
+
+void oct_encode(const vec3& n, int16_t out[2]) {
+	float l1 = fabsf(n.v[0]) + fabsf(n.v[1]) + fabsf(n.v[2]);
+	if (l1 == 0.f) {
+		out[0] = out[1] = 0;
+		return;
+	}
+	float u = n.v[0] / l1;
+	float v = n.v[1] / l1;
+	// fold the lower hemisphere over the diagonals
+	if (n.v[2] < 0.f) {
+		float fu = (1.f - fabsf(v)) * sign_not_zero(u);
+		float fv = (1.f - fabsf(u)) * sign_not_zero(v);
+		u = fu;
+		v = fv;
+	}
+	out[0] = to_snorm16(u);
+	out[1] = to_snorm16(v);
+}
+
+vec3 oct_decode(const int16_t in[2]) {
+	float u = from_snorm16(in[0]);
+	float v = from_snorm16(in[1]);
+	vec3 n(u, v, 1.f - fabsf(u) - fabsf(v));
+	float t = n.v[2] < 0.f ? -n.v[2] : 0.f;
+	n.v[0] += n.v[0] >= 0.f ? -t : t;
+	n.v[1] += n.v[1] >= 0.f ? -t : t;
+	return normalise(n);
+}
+
+/*--------------------------------10:10:10:2----------------------------------*/
+uint32_t pack_snorm_10_10_10_2(const vec4& v) {
+	int32_t x = (int32_t)lroundf(clamp_unit(v.v[0]) * 511.f);
+	int32_t y = (int32_t)lroundf(clamp_unit(v.v[1]) * 511.f);
+	int32_t z = (int32_t)lroundf(clamp_unit(v.v[2]) * 511.f);
+	int32_t w = v.v[3] < 0.f ? -1 : 1;
+	return ((uint32_t)x & 0x3ff) | (((uint32_t)y & 0x3ff) << 10) | (((uint32_t)z & 0x3ff) << 20) | (((uint32_t)w & 0x3) << 30);
+}
+
+vec4 unpack_snorm_10_10_10_2(uint32_t p) {
+	// sign extend each field
+	int32_t x = (int32_t)(p << 22) >> 22;
+	int32_t y = (int32_t)(p << 12) >> 22;
+	int32_t z = (int32_t)(p << 2) >> 22;
+	int32_t w = (int32_t)p >> 30;
+	vec4 v(x / 511.f, y / 511.f, z / 511.f, (float)w);
+	for (int i = 0; i < 4; ++i) {
+		v.v[i] = v.v[i] < -1.f ? -1.f : v.v[i];
+	}
+	return v;
+}
+
+/*---------------------------------VERTICES-----------------------------------*/
+namespace {
+
+	// everything but the position, shared by both vertex types
+	template <typename Vertex>
+	void pack_attributes(const VertexStreams& streams, size_t i, Vertex& out) {
+		if (streams.normals) {
+			const float* n = &streams.normals[i * 3];
+			oct_encode(vec3(n[0], n[1], n[2]), out.normal);
+		}
+		else {
+			out.normal[0] = out.normal[1] = 0;
+		}
+		if (streams.tangents) {
+			const float* t = &streams.tangents[i * 4];
+			out.tangent = pack_snorm_10_10_10_2(vec4(t[0], t[1], t[2], t[3]));
+		}
+		else {
+			out.tangent = 0;
+		}
+		for (int j = 0; j < 2; ++j) {
+			const float* uv = streams.uvs[j] ? &streams.uvs[j][i * 2] : nullptr;
+			out.uvs[j][0] = uv ? float_to_half(uv[0]) : 0;
+			out.uvs[j][1] = uv ? float_to_half(uv[1]) : 0;
+		}
+	}
+}
+
+void pack_vertices(const VertexStreams& streams, std::vector<PackedVertex>& out) {
+	out.resize(streams.count);
+	for (size_t i = 0; i < streams.count; ++i) {
+		PackedVertex& vertex = out[i];
+		memcpy(vertex.position, &streams.positions[i * 3], sizeof(vertex.position));
+		pack_attributes(streams, i, vertex);
+	}
+}
+
+void pack_vertices(const VertexStreams& streams, std::vector<QuantizedVertex>& out, vec3& offset, vec3& scale) {
+	out.resize(streams.count);
+	if (streams.count == 0) {
+		offset = vec3(0.f, 0.f, 0.f);
+		scale = vec3(0.f, 0.f, 0.f);
+		return;
+	}
+
+	vec3 min_bound(streams.positions[0], streams.positions[1], streams.positions[2]);
+	vec3 max_bound = min_bound;
+	for (size_t i = 1; i < streams.count; ++i) {
+		for (int k = 0; k < 3; ++k) {
+			float p = streams.positions[i * 3 + k];
+			min_bound.v[k] = p < min_bound.v[k] ? p : min_bound.v[k];
+			max_bound.v[k] = p > max_bound.v[k] ? p : max_bound.v[k];
+		}
+	}
+	offset = min_bound;
+	scale = max_bound - min_bound;
+
+	for (size_t i = 0; i < streams.count; ++i) {
+		QuantizedVertex& vertex = out[i];
+		for (int k = 0; k < 3; ++k) {
+			float extent = scale.v[k];
+			float t = extent > 0.f ? (streams.positions[i * 3 + k] - offset.v[k]) / extent : 0.f;
+			vertex.position[k] = (uint16_t)lroundf((t < 0.f ? 0.f : (t > 1.f ? 1.f : t)) * 65535.f);
+		}
+		vertex.position[3] = 0;
+		pack_attributes(streams, i, vertex);
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "maths_funcs.h"
+
+// Compact vertex encodings for the interleaved mesh layout. GL free so the
+// packing can be checked and benchmarked without a context. test_vs.glsl
+// has the matching decode.
+
+// IEEE half float, round to nearest even. UVs beyond +-2048 lose sub-texel
+// precision, beyond +-65504 they become inf
+uint16_t float_to_half(float f);
+float half_to_float(uint16_t h);
+
+// unit vector to octahedral coordinates stored as two snorm16
+void oct_encode(const vec3& n, int16_t out[2]);
+vec3 oct_decode(const int16_t in[2]);
+
+// xyz in signed 10 bits, w in signed 2 bits, the GL_INT_2_10_10_10_REV order.
+// w only keeps its sign, which is all the tangent handedness needs
+uint32_t pack_snorm_10_10_10_2(const vec4& v);
+vec4 unpack_snorm_10_10_10_2(uint32_t p);
+
+// 28 bytes, against 56 for the separate float arrays
+struct PackedVertex {
+	float position[3];
+	int16_t normal[2];   // octahedral
+	uint32_t tangent;    // 10:10:10:2, w = handedness
+	uint16_t uvs[2][2];  // half floats
+};
+
+// 24 bytes. positions are unorm16 inside the mesh bounds:
+// position = offset + quantized * scale
+struct QuantizedVertex {
+	uint16_t position[4]; // w unused, keeps the normal 4 byte aligned
+	int16_t normal[2];
+	uint32_t tangent;
+	uint16_t uvs[2][2];
+};
+
+// per vertex source arrays as the importer fills them, any but positions may be null
+struct VertexStreams {
+	const float* positions; // 3 per vertex
+	const float* normals;   // 3 per vertex
+	const float* tangents;  // 4 per vertex
+	const float* uvs[2];    // 2 per vertex
+	size_t count;
+};
+
+void pack_vertices(const VertexStreams& streams, std::vector<PackedVertex>& out);
+// also returns the dequantization offset and scale the shader needs
+void pack_vertices(const VertexStreams& streams, std::vector<QuantizedVertex>& out, vec3& offset, vec3& scale);